@@ -0,0 +1,516 @@
+#!/usr/bin/env python3
+"""Compiles the engine's GLSL shaders to SPIR-V.
+
+Every <name>.<stage>.glsl file in the shader directories is compiled with glslc to <name>.<stage>.spv in the output directory.
+Development and Debug builds keep debug info for RenderDoc and the validation layers; Release builds strip it and run spirv-opt -O.
+
+Outputs are cached by a hash of the source, everything it #includes, the compiler flags and the tool versions, so switching
+configurations or branches only recompiles shaders whose inputs actually changed. Shaders are compiled in parallel.
+
+Next to each .spv a .refl sidecar holds the interface reflected from it (see write_reflection), which loadShaderModule reads instead
+of parsing the SPIR-V itself. The reflection here mirrors reflectShaderModule in source/platform/vulkan/shader_module.cpp and the two
+must be kept in sync; loadShaderModule ignores sidecars with a different REFLECTION_VERSION.
+"""
+
+import argparse
+import concurrent.futures
+import hashlib
+import os
+import re
+import shutil
+import struct
+import subprocess
+import sys
+
+CACHE_VERSION = 1
+REFLECTION_VERSION = "gsrefl1"
+TARGET_ENV = "vulkan1.2"
+STAGES = ("vert", "frag", "comp")
+
+CONFIG_FLAGS = {
+    "Debug": ["-g", "-O0"],
+    "Development": ["-g", "-O0"],
+    "Release": ["-O0"],  # Optimized by spirv-opt afterwards, which does more than glslc -O
+}
+
+INCLUDE_PATTERN = re.compile(r'^\s*#\s*include\s+"([^"]+)"', re.MULTILINE)
+
+
+def find_tool(name):
+    executable = name + ".exe" if os.name == "nt" else name
+    sdk = os.environ.get("VULKAN_SDK")
+
+    if sdk:
+        path = os.path.join(sdk, "Bin", executable)
+
+        if os.path.isfile(path):
+            return path
+
+    path = shutil.which(executable)
+
+    if not path:
+        sys.exit("build_shaders: %s not found, install the Vulkan SDK or add it to PATH" % name)
+
+    return path
+
+
+def tool_version(path):
+    result = subprocess.run([path, "--version"], stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+    return result.stdout
+
+
+def read_bytes(path):
+    with open(path, "rb") as f:
+        return f.read()
+
+
+def collect_includes(path, include_dirs, includes):
+    """Adds the files path includes, recursively, to includes. Unresolved includes are left for glslc to report."""
+    text = read_bytes(path).decode("utf-8", errors="replace")
+
+    for name in INCLUDE_PATTERN.findall(text):
+        for directory in [os.path.dirname(path)] + include_dirs:
+            candidate = os.path.normpath(os.path.join(directory, name))
+
+            if os.path.isfile(candidate):
+                if candidate not in includes:
+                    includes[candidate] = name
+                    collect_includes(candidate, include_dirs, includes)
+
+                break
+
+
+def shader_key(source, stage, flags, tools, include_dirs):
+    """Hash of everything the compiled SPIR-V depends on. Paths are left out so the cache is shared between checkouts."""
+    includes = {}
+    collect_includes(source, include_dirs, includes)
+
+    h = hashlib.sha256()
+    h.update(("%d %s %s %s\n" % (CACHE_VERSION, REFLECTION_VERSION, stage, " ".join(flags))).encode())
+
+    for version in tools:
+        h.update(version)
+
+    h.update(read_bytes(source))
+
+    for path, name in sorted(includes.items(), key=lambda item: item[1]):
+        h.update(name.encode())
+        h.update(read_bytes(path))
+
+    return h.hexdigest()
+
+
+# SPIR-V reflection, see shader_module.cpp
+
+OP_ENTRY_POINT = 15
+OP_TYPE_BOOL = 20
+OP_TYPE_INT = 21
+OP_TYPE_FLOAT = 22
+OP_TYPE_VECTOR = 23
+OP_TYPE_MATRIX = 24
+OP_TYPE_IMAGE = 25
+OP_TYPE_SAMPLER = 26
+OP_TYPE_SAMPLED_IMAGE = 27
+OP_TYPE_ARRAY = 28
+OP_TYPE_RUNTIME_ARRAY = 29
+OP_TYPE_STRUCT = 30
+OP_TYPE_POINTER = 32
+OP_CONSTANT = 43
+OP_SPEC_CONSTANT_TRUE = 48
+OP_SPEC_CONSTANT_FALSE = 49
+OP_SPEC_CONSTANT = 50
+OP_VARIABLE = 59
+OP_DECORATE = 71
+OP_MEMBER_DECORATE = 72
+
+DECORATION_SPEC_ID = 1
+DECORATION_BUFFER_BLOCK = 3
+DECORATION_ARRAY_STRIDE = 6
+DECORATION_MATRIX_STRIDE = 7
+DECORATION_BUILT_IN = 11
+DECORATION_LOCATION = 30
+DECORATION_BINDING = 33
+DECORATION_DESCRIPTOR_SET = 34
+DECORATION_OFFSET = 35
+
+STORAGE_UNIFORM_CONSTANT = 0
+STORAGE_INPUT = 1
+STORAGE_UNIFORM = 2
+STORAGE_PUSH_CONSTANT = 9
+STORAGE_STORAGE_BUFFER = 12
+
+DIM_BUFFER = 5
+DIM_SUBPASS_DATA = 6
+
+# VkShaderStageFlagBits by SPIR-V execution model
+SHADER_STAGES = {0: 0x1, 4: 0x10, 5: 0x20}
+
+# VkDescriptorType
+DESCRIPTOR_SAMPLER = 0
+DESCRIPTOR_COMBINED_IMAGE_SAMPLER = 1
+DESCRIPTOR_SAMPLED_IMAGE = 2
+DESCRIPTOR_STORAGE_IMAGE = 3
+DESCRIPTOR_UNIFORM_TEXEL_BUFFER = 4
+DESCRIPTOR_STORAGE_TEXEL_BUFFER = 5
+DESCRIPTOR_UNIFORM_BUFFER = 6
+DESCRIPTOR_STORAGE_BUFFER = 7
+DESCRIPTOR_INPUT_ATTACHMENT = 10
+
+# VkFormat of 1 to 4 component 32 bit vertex inputs
+FLOAT_FORMATS = (100, 103, 106, 109)
+INT_FORMATS = (99, 102, 105, 108)
+UINT_FORMATS = (98, 101, 104, 107)
+
+NO_VALUE = 0xFFFFFFFF
+
+
+class SpirvId:
+    def __init__(self):
+        self.opcode = 0
+        self.type_id = 0
+        self.storage_class = 0
+        self.width = 0
+        self.component_count = 0
+        self.constant = 0
+        self.dim = 0
+        self.sampled = 0
+        self.set = NO_VALUE
+        self.binding = NO_VALUE
+        self.location = NO_VALUE
+        self.spec_id = NO_VALUE
+        self.array_stride = 0
+        self.built_in = False
+        self.buffer_block = False
+        self.members = []
+        self.member_offsets = {}
+        self.member_matrix_strides = {}
+
+
+def type_size(ids, type_id, matrix_stride=0):
+    t = ids[type_id]
+
+    if t.opcode == OP_TYPE_BOOL:
+        return 4
+
+    if t.opcode in (OP_TYPE_INT, OP_TYPE_FLOAT):
+        return t.width // 8
+
+    if t.opcode == OP_TYPE_VECTOR:
+        return t.component_count * type_size(ids, t.type_id)
+
+    if t.opcode == OP_TYPE_MATRIX:
+        return t.component_count * (matrix_stride or type_size(ids, t.type_id))
+
+    if t.opcode == OP_TYPE_ARRAY:
+        return ids[t.constant].constant * (t.array_stride or type_size(ids, t.type_id))
+
+    if t.opcode == OP_TYPE_STRUCT:
+        size = 0
+
+        for i, member in enumerate(t.members):
+            offset = t.member_offsets.get(i, 0)
+            size = max(size, offset + type_size(ids, member, t.member_matrix_strides.get(i, 0)))
+
+        return size
+
+    return 0
+
+
+def descriptor_type(ids, type_id, storage_class):
+    t = ids[type_id]
+
+    if t.opcode == OP_TYPE_STRUCT:
+        return DESCRIPTOR_STORAGE_BUFFER if storage_class == STORAGE_STORAGE_BUFFER or t.buffer_block else DESCRIPTOR_UNIFORM_BUFFER
+
+    if t.opcode == OP_TYPE_SAMPLER:
+        return DESCRIPTOR_SAMPLER
+
+    if t.opcode == OP_TYPE_SAMPLED_IMAGE:
+        return DESCRIPTOR_UNIFORM_TEXEL_BUFFER if ids[t.type_id].dim == DIM_BUFFER else DESCRIPTOR_COMBINED_IMAGE_SAMPLER
+
+    if t.opcode == OP_TYPE_IMAGE:
+        if t.dim == DIM_SUBPASS_DATA:
+            return DESCRIPTOR_INPUT_ATTACHMENT
+
+        if t.dim == DIM_BUFFER:
+            return DESCRIPTOR_STORAGE_TEXEL_BUFFER if t.sampled == 2 else DESCRIPTOR_UNIFORM_TEXEL_BUFFER
+
+        return DESCRIPTOR_STORAGE_IMAGE if t.sampled == 2 else DESCRIPTOR_SAMPLED_IMAGE
+
+    raise ValueError("unsupported descriptor type")
+
+
+def vertex_input_format(ids, type_id):
+    t = ids[type_id]
+    component_count = 1
+    component = t
+
+    if t.opcode == OP_TYPE_VECTOR:
+        component_count = t.component_count
+        component = ids[t.type_id]
+
+    if component.width != 32:
+        raise ValueError("only 32 bit vertex inputs are supported")
+
+    if component.opcode == OP_TYPE_FLOAT:
+        return FLOAT_FORMATS[component_count - 1]
+
+    # For OpTypeInt the signedness operand was stored in constant
+    return (INT_FORMATS if component.constant else UINT_FORMATS)[component_count - 1]
+
+
+def reflect(code):
+    words = struct.unpack("<%dI" % (len(code) // 4), code)
+
+    if words[0] != 0x07230203:
+        raise ValueError("not a SPIR-V module")
+
+    ids = [SpirvId() for _ in range(words[3])]
+    module = {"stage": 0, "entry": "main", "push": 0, "bindings": [], "inputs": [], "specs": []}
+
+    i = 5
+
+    while i < len(words):
+        opcode = words[i] & 0xFFFF
+        word_count = words[i] >> 16
+        op = words[i:i + word_count]
+
+        if opcode == OP_ENTRY_POINT:
+            module["stage"] = SHADER_STAGES[op[1]]
+            name = struct.pack("<%dI" % (word_count - 3), *op[3:])
+            module["entry"] = name[:name.index(b"\0")].decode()
+        elif opcode == OP_DECORATE:
+            id = ids[op[1]]
+            value = op[3] if word_count > 3 else 0
+
+            if op[2] == DECORATION_DESCRIPTOR_SET:
+                id.set = value
+            elif op[2] == DECORATION_BINDING:
+                id.binding = value
+            elif op[2] == DECORATION_LOCATION:
+                id.location = value
+            elif op[2] == DECORATION_SPEC_ID:
+                id.spec_id = value
+            elif op[2] == DECORATION_ARRAY_STRIDE:
+                id.array_stride = value
+            elif op[2] == DECORATION_BUILT_IN:
+                id.built_in = True
+            elif op[2] == DECORATION_BUFFER_BLOCK:
+                id.buffer_block = True
+        elif opcode == OP_MEMBER_DECORATE:
+            id = ids[op[1]]
+
+            if op[3] == DECORATION_OFFSET:
+                id.member_offsets[op[2]] = op[4]
+            elif op[3] == DECORATION_MATRIX_STRIDE:
+                id.member_matrix_strides[op[2]] = op[4]
+            elif op[3] == DECORATION_BUILT_IN:
+                id.built_in = True
+        elif opcode in (OP_TYPE_BOOL, OP_TYPE_SAMPLER):
+            ids[op[1]].opcode = opcode
+        elif opcode == OP_TYPE_INT:
+            id = ids[op[1]]
+            id.opcode, id.width, id.constant = opcode, op[2], op[3]
+        elif opcode == OP_TYPE_FLOAT:
+            id = ids[op[1]]
+            id.opcode, id.width = opcode, op[2]
+        elif opcode in (OP_TYPE_VECTOR, OP_TYPE_MATRIX):
+            id = ids[op[1]]
+            id.opcode, id.type_id, id.component_count = opcode, op[2], op[3]
+        elif opcode == OP_TYPE_IMAGE:
+            id = ids[op[1]]
+            id.opcode, id.type_id, id.dim, id.sampled = opcode, op[2], op[3], op[7]
+        elif opcode in (OP_TYPE_SAMPLED_IMAGE, OP_TYPE_RUNTIME_ARRAY):
+            id = ids[op[1]]
+            id.opcode, id.type_id = opcode, op[2]
+        elif opcode == OP_TYPE_ARRAY:
+            id = ids[op[1]]
+            id.opcode, id.type_id, id.constant = opcode, op[2], op[3]
+        elif opcode == OP_TYPE_STRUCT:
+            id = ids[op[1]]
+            id.opcode, id.members = opcode, list(op[2:])
+        elif opcode == OP_TYPE_POINTER:
+            id = ids[op[1]]
+            id.opcode, id.storage_class, id.type_id = opcode, op[2], op[3]
+        elif opcode in (OP_CONSTANT, OP_SPEC_CONSTANT, OP_SPEC_CONSTANT_TRUE, OP_SPEC_CONSTANT_FALSE):
+            id = ids[op[2]]
+            id.opcode, id.type_id, id.constant = opcode, op[1], op[3] if word_count > 3 else 0
+        elif opcode == OP_VARIABLE:
+            id = ids[op[2]]
+            id.opcode, id.type_id, id.storage_class = opcode, op[1], op[3]
+
+        i += word_count
+
+    for variable in ids:
+        if variable.opcode != OP_VARIABLE:
+            continue
+
+        # Variables are always pointers; look through to the pointee
+        type_id = ids[variable.type_id].type_id
+
+        if variable.storage_class in (STORAGE_UNIFORM, STORAGE_UNIFORM_CONSTANT, STORAGE_STORAGE_BUFFER):
+            if variable.binding == NO_VALUE:
+                continue
+
+            count = 1
+
+            if ids[type_id].opcode == OP_TYPE_ARRAY:
+                count = ids[ids[type_id].constant].constant
+                type_id = ids[type_id].type_id
+            elif ids[type_id].opcode == OP_TYPE_RUNTIME_ARRAY:
+                count = 0
+                type_id = ids[type_id].type_id
+
+            set = 0 if variable.set == NO_VALUE else variable.set
+            module["bindings"].append((set, variable.binding, descriptor_type(ids, type_id, variable.storage_class), count))
+        elif variable.storage_class == STORAGE_PUSH_CONSTANT:
+            module["push"] = max(module["push"], type_size(ids, type_id))
+        elif variable.storage_class == STORAGE_INPUT:
+            if module["stage"] != SHADER_STAGES[0] or variable.built_in or ids[type_id].built_in or variable.location == NO_VALUE:
+                continue
+
+            module["inputs"].append((variable.location, vertex_input_format(ids, type_id), type_size(ids, type_id)))
+
+    for constant in ids:
+        if constant.spec_id != NO_VALUE:
+            module["specs"].append((constant.spec_id, type_size(ids, constant.type_id)))
+
+    module["bindings"].sort()
+    module["inputs"].sort()
+    module["specs"].sort()
+    return module
+
+
+def fnv1a64(data):
+    h = 0xCBF29CE484222325
+
+    for byte in data:
+        h = ((h ^ byte) * 0x100000001B3) & 0xFFFFFFFFFFFFFFFF
+
+    return h
+
+
+def write_reflection(code, path):
+    """One keyword per line. The header ties the file to the exact SPIR-V it was reflected from."""
+    module = reflect(code)
+    lines = ["%s %d %016x" % (REFLECTION_VERSION, len(code), fnv1a64(code))]
+    lines.append("stage %d" % module["stage"])
+    lines.append("entry %s" % module["entry"])
+    lines.append("push %d" % module["push"])
+    lines += ["binding %d %d %d %d" % binding for binding in module["bindings"]]
+    lines += ["input %d %d %d" % input for input in module["inputs"]]
+    lines += ["spec %d %d" % spec for spec in module["specs"]]
+
+    with open(path, "w", newline="\n") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+def copy_if_changed(source, destination):
+    """Leaves unchanged outputs alone so their timestamps only move when the shader really changed. Changed outputs are written
+    next to the destination and renamed over it, so a running engine watching for them never reads a partial file."""
+    if os.path.isfile(destination) and read_bytes(destination) == read_bytes(source):
+        return False
+
+    temporary = destination + ".tmp"
+    shutil.copyfile(source, temporary)
+    os.replace(temporary, destination)
+    return True
+
+
+def build_shader(source, stage, args, tools, include_dirs):
+    name = os.path.basename(source)[:-len(".glsl")]
+    flags = CONFIG_FLAGS[args.config]
+    key = shader_key(source, stage, flags, tools["versions"], include_dirs)
+    cached = os.path.join(args.cache, "%s-%s" % (name, key[:32]))
+    status = "cached"
+    log = ""
+
+    if not (os.path.isfile(cached + ".spv") and os.path.isfile(cached + ".refl")):
+        command = [tools["glslc"], "-fshader-stage=" + stage, "--target-env=" + TARGET_ENV] + flags
+        command += ["-I" + directory for directory in include_dirs]
+        command += [source, "-o", cached + ".glslc.spv"]
+        result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+        log = result.stdout
+        compiled = cached + ".glslc.spv"
+
+        if result.returncode == 0 and "spirv-opt" in tools:
+            command = [tools["spirv-opt"], "-O", "--target-env=" + TARGET_ENV, compiled, "-o", cached + ".opt.spv"]
+            result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+            log += result.stdout
+            compiled = cached + ".opt.spv"
+
+        if result.returncode != 0:
+            return name, "failed", log
+
+        # The .spv is moved into place last, so an interrupted build never leaves a cache entry without its sidecar
+        write_reflection(read_bytes(compiled), cached + ".refl")
+        os.replace(compiled, cached + ".spv")
+        status = "compiled"
+
+        if os.path.isfile(cached + ".glslc.spv"):
+            os.remove(cached + ".glslc.spv")
+
+    # The sidecar goes first, so a running engine reloading the .spv as soon as it changes finds the matching reflection
+    copied = copy_if_changed(cached + ".refl", os.path.join(args.output, name + ".refl"))
+    copied |= copy_if_changed(cached + ".spv", os.path.join(args.output, name + ".spv"))
+
+    if status == "cached" and copied:
+        status = "restored"
+
+    return name, status, log
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("directories", nargs="+", help="directories holding <name>.<stage>.glsl shaders")
+    parser.add_argument("--config", choices=sorted(CONFIG_FLAGS), default="Development")
+    parser.add_argument("--output", default=".", help="directory the .spv and .refl files are written to")
+    parser.add_argument("--cache", default=None, help="compiled shader cache, defaults to <output>/shader_cache")
+    parser.add_argument("--include", action="append", default=[], help="additional #include directory")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count())
+    args = parser.parse_args()
+
+    args.cache = args.cache or os.path.join(args.output, "shader_cache")
+    os.makedirs(args.output, exist_ok=True)
+    os.makedirs(args.cache, exist_ok=True)
+
+    tools = {"glslc": find_tool("glslc")}
+
+    if args.config == "Release":
+        tools["spirv-opt"] = find_tool("spirv-opt")
+
+    tools["versions"] = [tool_version(tools[tool]) for tool in ("glslc", "spirv-opt") if tool in tools]
+
+    shaders = []
+
+    for directory in args.directories:
+        include_dirs = [os.path.abspath(directory)] + [os.path.abspath(include) for include in args.include]
+
+        for file in sorted(os.listdir(directory)):
+            parts = file.split(".")
+
+            if len(parts) == 3 and parts[2] == "glsl" and parts[1] in STAGES:
+                shaders.append((os.path.join(directory, file), parts[1], include_dirs))
+
+    failed = 0
+
+    with concurrent.futures.ThreadPoolExecutor(max_workers=max(args.jobs, 1)) as executor:
+        jobs = [executor.submit(build_shader, source, stage, args, tools, include_dirs) for source, stage, include_dirs in shaders]
+
+        for job in jobs:
+            name, status, output = job.result()
+            print("%s: %s" % (name, status))
+
+            if output:
+                print(output.rstrip())
+
+            failed += status == "failed"
+
+    if failed:
+        print("build_shaders: %d of %d shaders failed to compile" % (failed, len(shaders)))
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
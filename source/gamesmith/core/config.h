@@ -16,6 +16,14 @@
 #endif
 #endif
 
+#ifndef GS_ENABLE_HOT_RELOAD
+#if defined(GS_DEBUG) || defined(GS_DEVELOPMENT)
+#define GS_ENABLE_HOT_RELOAD 1
+#else
+#define GS_ENABLE_HOT_RELOAD 0
+#endif
+#endif
+
 #if defined(_WIN32)
 #define GS_PLATFORM_WINDOWS
 #endif
@@ -0,0 +1,183 @@
+#include "gspch.h"
+
+#include "gamesmith/core/file_watcher.h"
+
+#include <algorithm>
+
+namespace gs
+{
+
+FileWatcher::FileWatcher(std::chrono::milliseconds pollInterval) : pollInterval_(pollInterval)
+{
+#ifdef GS_PLATFORM_WINDOWS
+    wakeEvent_ = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+#endif
+
+    thread_ = std::thread(&FileWatcher::watcherMain, this);
+}
+
+FileWatcher::~FileWatcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+
+    wake_.notify_all();
+
+#ifdef GS_PLATFORM_WINDOWS
+    SetEvent(wakeEvent_);
+#endif
+
+    thread_.join();
+
+#ifdef GS_PLATFORM_WINDOWS
+    for (const std::unique_ptr<Directory>& directory : directories_)
+    {
+        if (directory->notification != INVALID_HANDLE_VALUE)
+        {
+            FindCloseChangeNotification(directory->notification);
+        }
+    }
+
+    CloseHandle(wakeEvent_);
+#endif
+}
+
+void FileWatcher::watchDirectory(const std::string& directory, const std::string& extension)
+{
+    auto watched = std::make_unique<Directory>();
+    watched->path = std::filesystem::path(directory).lexically_normal();
+    watched->extension = extension;
+
+#ifdef GS_PLATFORM_WINDOWS
+    // Armed before the first scan, so nothing written in between is missed
+    watched->notification = FindFirstChangeNotificationW(watched->path.c_str(), FALSE,
+                                                         FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE);
+#endif
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        scanDirectory(*watched, false);
+        directories_.push_back(std::move(watched));
+    }
+
+#ifdef GS_PLATFORM_WINDOWS
+    SetEvent(wakeEvent_);
+#endif
+}
+
+std::vector<std::string> FileWatcher::takeChanges()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> changes;
+    changes.swap(changes_);
+    return changes;
+}
+
+void FileWatcher::scanDirectory(Directory& directory, bool report)
+{
+    std::error_code ec;
+
+    for (std::filesystem::directory_iterator it(directory.path, ec), end; !ec && it != end; it.increment(ec))
+    {
+        const std::filesystem::path& path = it->path();
+
+        if (!it->is_regular_file(ec) || (!directory.extension.empty() && path.extension() != directory.extension))
+        {
+            continue;
+        }
+
+        std::filesystem::file_time_type writeTime = it->last_write_time(ec);
+
+        if (ec)
+        {
+            ec.clear();
+            continue;
+        }
+
+        std::string name = path.filename().string();
+        auto known = directory.writeTimes.find(name);
+
+        if (!report || (known != directory.writeTimes.end() && known->second == writeTime))
+        {
+            directory.writeTimes[name] = writeTime;
+            directory.pending.erase(name);
+            continue;
+        }
+
+        auto pending = directory.pending.find(name);
+
+        if (pending == directory.pending.end() || pending->second != writeTime)
+        {
+            directory.pending[name] = writeTime;
+            continue;
+        }
+
+        directory.writeTimes[name] = writeTime;
+        directory.pending.erase(pending);
+
+        std::string changed = (directory.path / name).lexically_normal().string();
+
+        if (std::find(changes_.begin(), changes_.end(), changed) == changes_.end())
+        {
+            changes_.push_back(std::move(changed));
+        }
+    }
+}
+
+void FileWatcher::watcherMain()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (!stopping_)
+    {
+        // Files waiting for their write time to settle are rescanned after the poll interval even without another notification
+        bool poll = std::any_of(directories_.begin(), directories_.end(),
+                                [](const std::unique_ptr<Directory>& directory) { return !directory->pending.empty(); });
+
+#ifdef GS_PLATFORM_WINDOWS
+        std::vector<HANDLE> handles{ wakeEvent_ };
+
+        for (const std::unique_ptr<Directory>& directory : directories_)
+        {
+            if (directory->notification != INVALID_HANDLE_VALUE)
+            {
+                handles.push_back(directory->notification);
+            }
+            else
+            {
+                poll = true;
+            }
+        }
+
+        lock.unlock();
+        DWORD timeout = poll ? DWORD(pollInterval_.count()) : INFINITE;
+        DWORD result = WaitForMultipleObjects(DWORD(handles.size()), handles.data(), FALSE, timeout);
+
+        // Re-armed before scanning, so changes made during the scan signal again. Only the first signaled handle is reported, any
+        // others are still signaled on the next wait.
+        if (result > WAIT_OBJECT_0 && result < WAIT_OBJECT_0 + handles.size())
+        {
+            FindNextChangeNotification(handles[result - WAIT_OBJECT_0]);
+        }
+
+        lock.lock();
+#else
+        (void)poll;
+        wake_.wait_for(lock, pollInterval_, [this]() { return stopping_; });
+#endif
+
+        if (stopping_)
+        {
+            break;
+        }
+
+        for (const std::unique_ptr<Directory>& directory : directories_)
+        {
+            scanDirectory(*directory, true);
+        }
+    }
+}
+
+} // namespace GameSmith
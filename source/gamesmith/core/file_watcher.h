@@ -0,0 +1,64 @@
+#pragma once
+
+#include "gspch.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace gs
+{
+
+// Reports files that are modified or created in a set of directories, found on a background thread. On Windows the thread sleeps on
+// directory change notifications, elsewhere it polls. Either way changed files are found by comparing write times, so editors that
+// save by writing a temporary file and renaming it over the original are handled too.
+class FileWatcher
+{
+public:
+    explicit FileWatcher(std::chrono::milliseconds pollInterval = std::chrono::milliseconds(250));
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // Watches the files directly in directory whose extension matches, or all of them if extension is empty. Files that exist now
+    // are only reported once they change.
+    void watchDirectory(const std::string& directory, const std::string& extension = {});
+
+    // Returns the files changed since the last call as lexically normalized paths, each at most once. A file is only reported once
+    // its write time has held for a scan, so files that are still being written aren't picked up half done.
+    std::vector<std::string> takeChanges();
+
+protected:
+    struct Directory
+    {
+        std::filesystem::path path;
+        std::string extension;
+        std::map<std::string, std::filesystem::file_time_type> writeTimes; // By file name, as last reported
+        std::map<std::string, std::filesystem::file_time_type> pending;    // Changed files whose write time hasn't settled yet
+
+#ifdef GS_PLATFORM_WINDOWS
+        HANDLE notification{ INVALID_HANDLE_VALUE };
+#endif
+    };
+
+    void scanDirectory(Directory& directory, bool report);
+    void watcherMain();
+
+    std::chrono::milliseconds pollInterval_{};
+    std::vector<std::unique_ptr<Directory>> directories_{};
+    std::vector<std::string> changes_{};
+    std::mutex mutex_{};
+    std::condition_variable wake_{};
+    bool stopping_{};
+    std::thread thread_{};
+
+#ifdef GS_PLATFORM_WINDOWS
+    HANDLE wakeEvent_{}; // Interrupts the wait on the notifications when stopping or when a directory is added
+#endif
+};
+
+} // namespace GameSmith
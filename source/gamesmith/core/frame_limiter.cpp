@@ -0,0 +1,95 @@
+#include "gspch.h"
+
+#include "gamesmith/core/frame_limiter.h"
+
+#include <thread>
+
+#if defined(GS_PLATFORM_WINDOWS) && !defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+namespace gs
+{
+
+// Sleeps stop this far ahead of the deadline and the rest is spent spinning
+static const std::chrono::microseconds kSpinThreshold{ 1000 };
+
+FrameLimiter::FrameLimiter()
+{
+#ifdef GS_PLATFORM_WINDOWS
+    timer_ = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+#endif
+}
+
+FrameLimiter::~FrameLimiter()
+{
+#ifdef GS_PLATFORM_WINDOWS
+    if (timer_)
+    {
+        CloseHandle(timer_);
+    }
+#endif
+}
+
+void FrameLimiter::setTargetFps(float fps)
+{
+    targetFps_ = std::max(0.f, fps);
+    nextFrame_ = Clock::now();
+}
+
+float FrameLimiter::getTargetFps() const
+{
+    return targetFps_;
+}
+
+void FrameLimiter::sleepUntil(Clock::time_point time)
+{
+#ifdef GS_PLATFORM_WINDOWS
+    if (timer_)
+    {
+        // Negative due times are relative, in 100 ns units
+        LARGE_INTEGER dueTime{};
+        dueTime.QuadPart = -std::chrono::duration_cast<std::chrono::duration<int64_t, std::ratio<1, 10000000>>>(time - Clock::now()).count();
+
+        if (dueTime.QuadPart < 0 && SetWaitableTimerEx(timer_, &dueTime, 0, nullptr, nullptr, nullptr, 0))
+        {
+            WaitForSingleObject(timer_, INFINITE);
+        }
+
+        return;
+    }
+#endif
+
+    std::this_thread::sleep_until(time);
+}
+
+void FrameLimiter::wait()
+{
+    if (targetFps_ <= 0.f)
+    {
+        return;
+    }
+
+    if (nextFrame_ - Clock::now() > kSpinThreshold)
+    {
+        sleepUntil(nextFrame_ - kSpinThreshold);
+    }
+
+    while (Clock::now() < nextFrame_)
+    {
+        std::this_thread::yield();
+    }
+
+    auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFps_));
+    nextFrame_ += interval;
+
+    // Don't catch up after a long frame, that would only produce a burst of unpaced frames
+    Clock::time_point now = Clock::now();
+
+    if (nextFrame_ < now)
+    {
+        nextFrame_ = now + interval;
+    }
+}
+
+} // namespace GameSmith
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "gspch.h"
+
+#include <chrono>
+
+namespace gs
+{
+
+// Paces a loop to a target rate. Sleeps for most of the wait and spins for the remainder, since even high resolution sleeps can
+// overshoot by a fraction of a millisecond.
+class FrameLimiter
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    FrameLimiter();
+    ~FrameLimiter();
+
+    FrameLimiter(const FrameLimiter&) = delete;
+    FrameLimiter& operator=(const FrameLimiter&) = delete;
+
+    // A target of 0 disables the limiter.
+    void setTargetFps(float fps);
+    float getTargetFps() const;
+
+    // Blocks until the next frame is due. Call at the start of the frame, before sampling input, so the wait doesn't add latency.
+    void wait();
+
+protected:
+    void sleepUntil(Clock::time_point time);
+
+    float targetFps_{};
+    Clock::time_point nextFrame_{};
+
+#ifdef GS_PLATFORM_WINDOWS
+    HANDLE timer_{}; // Default Sleep granularity is too coarse for pacing, a high resolution timer is used when available
+#endif
+};
+
+} // namespace GameSmith
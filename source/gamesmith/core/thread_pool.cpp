@@ -0,0 +1,142 @@
+#include "gspch.h"
+
+#include "gamesmith/core/thread_pool.h"
+
+#include "gamesmith/core/debug.h"
+
+#include <atomic>
+
+namespace gs
+{
+
+ThreadPool::ThreadPool(uint32_t workerCount)
+{
+    if (workerCount == 0)
+    {
+        uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+
+    workers_.reserve(workerCount);
+
+    for (uint32_t i = 0; i < workerCount; ++i)
+    {
+        workers_.emplace_back(&ThreadPool::workerMain, this, i + 1);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+
+    taskAvailable_.notify_all();
+
+    for (std::thread& worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+uint32_t ThreadPool::getThreadCount() const
+{
+    return uint32_t(workers_.size()) + 1;
+}
+
+void ThreadPool::parallelFor(uint32_t count, const std::function<void(uint32_t index, uint32_t threadIndex)>& job)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    // Shared so that helper tasks which only get to run after every index has been claimed don't touch this stack frame
+    struct ParallelForState
+    {
+        std::atomic<uint32_t> nextIndex{ 0 };
+        std::atomic<uint32_t> remaining{ 0 };
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+
+    auto state = std::make_shared<ParallelForState>();
+    state->remaining = count;
+    const auto* jobPtr = &job;
+
+    // Indices are handed out dynamically so uneven jobs balance across threads; every participant, including the calling thread,
+    // keeps claiming indices until none are left. job is only dereferenced for a claimed index, i.e. before this function returns.
+    auto runJobs = [state, jobPtr, count](uint32_t threadIndex) {
+        for (uint32_t index = state->nextIndex++; index < count; index = state->nextIndex++)
+        {
+            (*jobPtr)(index, threadIndex);
+
+            if (--state->remaining == 0)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->done.notify_one();
+            }
+        }
+    };
+
+    uint32_t helpers = std::min(uint32_t(workers_.size()), count - 1);
+
+    if (helpers)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            for (uint32_t i = 0; i < helpers; ++i)
+            {
+                tasks_.push_back(runJobs);
+            }
+        }
+
+        taskAvailable_.notify_all();
+    }
+
+    runJobs(0);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&]() { return state->remaining == 0; });
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task)
+{
+    auto packagedTask = std::make_shared<std::packaged_task<void()>>(std::move(task));
+    std::future<void> result = packagedTask->get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back([packagedTask](uint32_t) { (*packagedTask)(); });
+    }
+
+    taskAvailable_.notify_one();
+    return result;
+}
+
+void ThreadPool::workerMain(uint32_t threadIndex)
+{
+    for (;;)
+    {
+        std::function<void(uint32_t)> task;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            taskAvailable_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+
+            if (tasks_.empty())
+            {
+                return;
+            }
+
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+
+        task(threadIndex);
+    }
+}
+
+} // namespace GameSmith
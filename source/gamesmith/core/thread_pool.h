@@ -0,0 +1,47 @@
+#pragma once
+
+#include "gspch.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+namespace gs
+{
+
+// Fixed set of worker threads consuming a shared task queue.
+class ThreadPool
+{
+public:
+    // A workerCount of 0 creates one worker per hardware thread, less one for the calling thread.
+    explicit ThreadPool(uint32_t workerCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of distinct thread indices passed to parallelFor jobs: the workers plus the calling thread, which is always index 0.
+    uint32_t getThreadCount() const;
+
+    // Runs job(index, threadIndex) for every index in [0, count) on the workers and the calling thread and returns once all have
+    // completed. No two concurrently running jobs share a threadIndex, so it can select per-thread resources without locking. Must not
+    // be called from a worker.
+    void parallelFor(uint32_t count, const std::function<void(uint32_t index, uint32_t threadIndex)>& job);
+
+    // Queues a task to run on a worker.
+    std::future<void> submit(std::function<void()> task);
+
+protected:
+    void workerMain(uint32_t threadIndex);
+
+    std::vector<std::thread> workers_{};
+    std::deque<std::function<void(uint32_t threadIndex)>> tasks_{};
+    std::mutex mutex_{};
+    std::condition_variable taskAvailable_{};
+    bool stopping_{};
+};
+
+} // namespace GameSmith
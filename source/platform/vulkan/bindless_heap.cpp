@@ -0,0 +1,201 @@
+#include "gspch.h"
+
+#include "bindless_heap.h"
+
+#include "gamesmith/core/debug.h"
+#include "gamesmith/core/log.h"
+
+namespace gs
+{
+namespace vk
+{
+
+static const VkDescriptorType kBindlessDescriptorTypes[kBindlessBindingCount] = {
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+    VK_DESCRIPTOR_TYPE_SAMPLER,
+};
+
+static BindlessHandle allocateSlot(BindlessHeap& heap, BindlessBinding binding)
+{
+    BindlessHeap::Slots& slots = heap.slots[binding];
+
+    if (!slots.freeSlots.empty())
+    {
+        BindlessHandle handle = slots.freeSlots.back();
+        slots.freeSlots.pop_back();
+        return handle;
+    }
+
+    if (slots.nextSlot < slots.capacity)
+    {
+        return slots.nextSlot++;
+    }
+
+    GS_ERROR("Bindless heap binding %d is full (%u descriptors).", int(binding), slots.capacity);
+    return kInvalidBindlessHandle;
+}
+
+static void writeDescriptor(BindlessHeap& heap, BindlessBinding binding, BindlessHandle handle, const VkDescriptorBufferInfo* bufferInfo,
+                            const VkDescriptorImageInfo* imageInfo)
+{
+    // Update-after-bind lets the set be written while command buffers using it are pending
+    VkWriteDescriptorSet write{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+    write.dstSet = heap.descriptorSet;
+    write.dstBinding = binding;
+    write.dstArrayElement = handle;
+    write.descriptorCount = 1;
+    write.descriptorType = kBindlessDescriptorTypes[binding];
+    write.pBufferInfo = bufferInfo;
+    write.pImageInfo = imageInfo;
+    vkUpdateDescriptorSets(heap.device, 1, &write, 0, nullptr);
+}
+
+void createBindlessHeap(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t framesInFlight, const BindlessHeapLimits& limits,
+                        BindlessHeap& heap)
+{
+    heap.device = device;
+    heap.framesInFlight = framesInFlight;
+    heap.frameNumber = 0;
+
+    VkPhysicalDeviceVulkan12Properties vulkan12Properties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES };
+    VkPhysicalDeviceProperties2 properties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+    properties.pNext = &vulkan12Properties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+    uint32_t capacities[kBindlessBindingCount] = {
+        std::min({ limits.maxStorageBuffers, vulkan12Properties.maxDescriptorSetUpdateAfterBindStorageBuffers,
+                   vulkan12Properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers }),
+        std::min({ limits.maxSampledImages, vulkan12Properties.maxDescriptorSetUpdateAfterBindSampledImages,
+                   vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSampledImages }),
+        std::min({ limits.maxSamplers, vulkan12Properties.maxDescriptorSetUpdateAfterBindSamplers,
+                   vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSamplers }),
+    };
+
+    VkDescriptorSetLayoutBinding bindings[kBindlessBindingCount]{};
+    VkDescriptorBindingFlags bindingFlags[kBindlessBindingCount]{};
+    VkDescriptorPoolSize poolSizes[kBindlessBindingCount]{};
+
+    for (uint32_t b = 0; b < kBindlessBindingCount; ++b)
+    {
+        // Vulkan doesn't allow zero sized pools, an empty array keeps a single unused descriptor
+        heap.slots[b] = {};
+        heap.slots[b].capacity = capacities[b];
+        bindings[b] = { b, kBindlessDescriptorTypes[b], std::max(capacities[b], 1u), VK_SHADER_STAGE_ALL, nullptr };
+        bindingFlags[b] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT |
+                          VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+        poolSizes[b] = { kBindlessDescriptorTypes[b], bindings[b].descriptorCount };
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO };
+    bindingFlagsCreateInfo.bindingCount = kBindlessBindingCount;
+    bindingFlagsCreateInfo.pBindingFlags = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutCreateInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+    layoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+    layoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutCreateInfo.bindingCount = kBindlessBindingCount;
+    layoutCreateInfo.pBindings = bindings;
+    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &heap.setLayout));
+
+    VkDescriptorPoolCreateInfo poolCreateInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+    poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolCreateInfo.maxSets = 1;
+    poolCreateInfo.poolSizeCount = kBindlessBindingCount;
+    poolCreateInfo.pPoolSizes = poolSizes;
+    VK_CHECK_RESULT(vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &heap.descriptorPool));
+
+    VkDescriptorSetAllocateInfo allocateInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+    allocateInfo.descriptorPool = heap.descriptorPool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &heap.setLayout;
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocateInfo, &heap.descriptorSet));
+
+    GS_INFO("Bindless heap: %u storage buffers, %u sampled images, %u samplers", capacities[kBindlessStorageBuffers],
+            capacities[kBindlessSampledImages], capacities[kBindlessSamplers]);
+}
+
+void destroyBindlessHeap(BindlessHeap& heap)
+{
+    vkDestroyDescriptorPool(heap.device, heap.descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(heap.device, heap.setLayout, nullptr);
+    heap.descriptorPool = VK_NULL_HANDLE;
+    heap.setLayout = VK_NULL_HANDLE;
+    heap.descriptorSet = VK_NULL_HANDLE;
+    heap.releases.clear();
+}
+
+void beginBindlessHeapFrame(BindlessHeap& heap, uint64_t frameNumber)
+{
+    std::lock_guard<std::mutex> lock(heap.mutex);
+    GS_ASSERT(frameNumber >= heap.frameNumber);
+    heap.frameNumber = frameNumber;
+
+    while (!heap.releases.empty() && frameNumber >= heap.releases.front().frameNumber + heap.framesInFlight)
+    {
+        const BindlessHeap::Release& release = heap.releases.front();
+        heap.slots[release.binding].freeSlots.push_back(release.handle);
+        heap.releases.pop_front();
+    }
+}
+
+BindlessHandle registerStorageBuffer(BindlessHeap& heap, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    std::lock_guard<std::mutex> lock(heap.mutex);
+    BindlessHandle handle = allocateSlot(heap, kBindlessStorageBuffers);
+
+    if (handle != kInvalidBindlessHandle)
+    {
+        VkDescriptorBufferInfo bufferInfo{ buffer, offset, range };
+        writeDescriptor(heap, kBindlessStorageBuffers, handle, &bufferInfo, nullptr);
+    }
+
+    return handle;
+}
+
+BindlessHandle registerSampledImage(BindlessHeap& heap, VkImageView view, VkImageLayout layout)
+{
+    std::lock_guard<std::mutex> lock(heap.mutex);
+    BindlessHandle handle = allocateSlot(heap, kBindlessSampledImages);
+
+    if (handle != kInvalidBindlessHandle)
+    {
+        VkDescriptorImageInfo imageInfo{ VK_NULL_HANDLE, view, layout };
+        writeDescriptor(heap, kBindlessSampledImages, handle, nullptr, &imageInfo);
+    }
+
+    return handle;
+}
+
+BindlessHandle registerSampler(BindlessHeap& heap, VkSampler sampler)
+{
+    std::lock_guard<std::mutex> lock(heap.mutex);
+    BindlessHandle handle = allocateSlot(heap, kBindlessSamplers);
+
+    if (handle != kInvalidBindlessHandle)
+    {
+        VkDescriptorImageInfo imageInfo{ sampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED };
+        writeDescriptor(heap, kBindlessSamplers, handle, nullptr, &imageInfo);
+    }
+
+    return handle;
+}
+
+void releaseBindlessHandle(BindlessHeap& heap, BindlessBinding binding, BindlessHandle handle)
+{
+    if (handle != kInvalidBindlessHandle)
+    {
+        // The stale descriptor stays in place; partially bound arrays tolerate it as long as no shader reads the slot
+        std::lock_guard<std::mutex> lock(heap.mutex);
+        GS_ASSERT(handle < heap.slots[binding].nextSlot);
+        heap.releases.push_back({ heap.frameNumber, binding, handle });
+    }
+}
+
+void bindBindlessHeap(const BindlessHeap& heap, VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout)
+{
+    vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, kBindlessSet, 1, &heap.descriptorSet, 0, nullptr);
+}
+
+} // namespace Vulkan
+} // namespace GameSmith
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "gsvulkan.h"
+
+#include <deque>
+#include <mutex>
+
+namespace gs
+{
+namespace vk
+{
+
+// Descriptor set the bindless heap is bound to in every pipeline layout
+static constexpr uint32_t kBindlessSet = 1;
+
+enum BindlessBinding
+{
+    kBindlessStorageBuffers, // readonly buffer ... [] at binding 0
+    kBindlessSampledImages,  // texture2D ...[] at binding 1
+    kBindlessSamplers,       // sampler ...[] at binding 2
+    kBindlessBindingCount
+};
+
+// Index into one of the heap's arrays, stable for the lifetime of the resource
+using BindlessHandle = uint32_t;
+static constexpr BindlessHandle kInvalidBindlessHandle = ~0u;
+
+struct BindlessHeapLimits
+{
+    uint32_t maxStorageBuffers;
+    uint32_t maxSampledImages;
+    uint32_t maxSamplers;
+};
+
+// One global descriptor set holding arrays of storage buffers, sampled images and samplers, which shaders index with handles passed
+// in push constants or per-object data. The set is bound once per command buffer, so switching buffers or textures between draws
+// doesn't touch descriptors. Bindings are partially bound and update-after-bind: resources are registered and released while frames
+// using the set are in flight, and slots are only reused framesInFlight frames after their release, once no frame can still read
+// them. Registering and releasing are thread safe.
+struct BindlessHeap
+{
+    struct Slots
+    {
+        uint32_t capacity;
+        uint32_t nextSlot;               // Slots at and above have never been used
+        std::vector<uint32_t> freeSlots; // Released slots whose frames have completed
+    };
+
+    struct Release
+    {
+        uint64_t frameNumber;
+        BindlessBinding binding;
+        BindlessHandle handle;
+    };
+
+    VkDevice device;
+    uint32_t framesInFlight;
+    uint64_t frameNumber;
+    VkDescriptorSetLayout setLayout;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet descriptorSet;
+    Slots slots[kBindlessBindingCount];
+    std::deque<Release> releases; // In release order, so in frame order
+    std::mutex mutex;
+};
+
+// Array sizes are clamped to the device's update-after-bind limits
+void createBindlessHeap(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t framesInFlight, const BindlessHeapLimits& limits,
+                        BindlessHeap& heap);
+void destroyBindlessHeap(BindlessHeap& heap);
+
+// Returns the slots released by frames that have since completed to their free lists. Call after waiting for frameNumber's frame
+// slot, before anything is released during the frame.
+void beginBindlessHeapFrame(BindlessHeap& heap, uint64_t frameNumber);
+
+// Writes the resource into a free slot of its array and returns the slot, or kInvalidBindlessHandle if the array is full
+BindlessHandle registerStorageBuffer(BindlessHeap& heap, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+BindlessHandle registerSampledImage(BindlessHeap& heap, VkImageView view, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+BindlessHandle registerSampler(BindlessHeap& heap, VkSampler sampler);
+
+// The resource must stay alive until the frames in flight have completed, e.g. by releasing it to the deletion queue too
+void releaseBindlessHandle(BindlessHeap& heap, BindlessBinding binding, BindlessHandle handle);
+
+void bindBindlessHeap(const BindlessHeap& heap, VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout);
+
+} // namespace Vulkan
+} // namespace GameSmith
@@ -0,0 +1,95 @@
+#include "gspch.h"
+
+#include "buffer.h"
+
+#include "gamesmith/core/debug.h"
+
+namespace gs
+{
+namespace vk
+{
+
+uint32_t getMemoryTypeIndex(VkPhysicalDevice physicalDevice, VkMemoryRequirements& memoryRequirements, VkMemoryPropertyFlags requiredProperties)
+{
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+    {
+        VkMemoryType& memoryType = memoryProperties.memoryTypes[i];
+
+        if ((memoryRequirements.memoryTypeBits & (1 << i)) && (memoryType.propertyFlags & requiredProperties) == requiredProperties)
+        {
+            return i;
+        }
+    }
+
+    return UINT32_MAX;
+}
+
+Buffer createBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage,
+                    VkMemoryPropertyFlags memoryProperties, QueueFamilyIndices queues)
+{
+    Buffer buffer{};
+
+    std::vector<uint32_t> queueFamilyIndices{};
+
+    for (auto& queueIndex : queues)
+    {
+        if (std::find(queueFamilyIndices.begin(), queueFamilyIndices.end(), queueIndex) == queueFamilyIndices.end())
+        {
+            queueFamilyIndices.push_back(queueIndex);
+        }
+    }
+
+    VkBufferCreateInfo createInfo{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    createInfo.size = size;
+    createInfo.usage = usage;
+
+    if (queueFamilyIndices.size() > 1)
+    {
+        createInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        createInfo.queueFamilyIndexCount = uint32_t(queueFamilyIndices.size());
+        createInfo.pQueueFamilyIndices = queueFamilyIndices.data();
+    }
+    else
+    {
+        createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+
+    VK_CHECK_RESULT(vkCreateBuffer(device, &createInfo, nullptr, &buffer.buffer));
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(device, buffer.buffer, &memoryRequirements);
+    buffer.size = memoryRequirements.size;
+
+    VkMemoryAllocateInfo allocateInfo{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    allocateInfo.allocationSize = memoryRequirements.size;
+    allocateInfo.memoryTypeIndex = getMemoryTypeIndex(physicalDevice, memoryRequirements, memoryProperties);
+    GS_ASSERT(allocateInfo.memoryTypeIndex != UINT32_MAX);
+    VK_CHECK_RESULT(vkAllocateMemory(device, &allocateInfo, nullptr, &buffer.gpuMemory));
+    VK_CHECK_RESULT(vkBindBufferMemory(device, buffer.buffer, buffer.gpuMemory, 0));
+
+    if (memoryProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        VK_CHECK_RESULT(vkMapMemory(device, buffer.gpuMemory, 0, buffer.size, 0, &buffer.mappedMemory));
+    }
+
+    return buffer;
+}
+
+void destroyBuffer(VkDevice device, Buffer& buffer)
+{
+    vkDestroyBuffer(device, buffer.buffer, nullptr);
+
+    if (buffer.mappedMemory)
+    {
+        vkUnmapMemory(device, buffer.gpuMemory);
+    }
+
+    vkFreeMemory(device, buffer.gpuMemory, nullptr);
+    buffer = Buffer{};
+}
+
+} // namespace Vulkan
+} // namespace GameSmith
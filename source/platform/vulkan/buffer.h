@@ -0,0 +1,29 @@
+#pragma once
+
+#include "gsvulkan.h"
+
+namespace gs
+{
+namespace vk
+{
+
+struct Buffer
+{
+    VkBuffer buffer;
+    VkDeviceMemory gpuMemory;
+    VkDeviceSize size;
+    void* mappedMemory;
+};
+
+using QueueFamilyIndices = std::initializer_list<uint32_t>;
+
+uint32_t getMemoryTypeIndex(VkPhysicalDevice physicalDevice, VkMemoryRequirements& memoryRequirements, VkMemoryPropertyFlags requiredProperties);
+
+// Buffers in host visible memory are persistently mapped. When more than one distinct queue family is given the buffer is created with
+// concurrent sharing so it can be used on all of them without ownership transfers.
+Buffer createBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage,
+                    VkMemoryPropertyFlags memoryProperties, QueueFamilyIndices queues);
+void destroyBuffer(VkDevice device, Buffer& buffer);
+
+} // namespace Vulkan
+} // namespace GameSmith
@@ -0,0 +1,134 @@
+#include "gspch.h"
+
+#include "deletion_queue.h"
+
+#include "gamesmith/core/debug.h"
+
+namespace gs
+{
+namespace vk
+{
+
+static void destroyObject(VkDevice device, const DeletionQueue::Entry& entry)
+{
+    switch (entry.type)
+    {
+        case VK_OBJECT_TYPE_BUFFER:
+        {
+            vkDestroyBuffer(device, VkBuffer(entry.handle), nullptr);
+            break;
+        }
+        case VK_OBJECT_TYPE_IMAGE:
+        {
+            vkDestroyImage(device, VkImage(entry.handle), nullptr);
+            break;
+        }
+        case VK_OBJECT_TYPE_IMAGE_VIEW:
+        {
+            vkDestroyImageView(device, VkImageView(entry.handle), nullptr);
+            break;
+        }
+        case VK_OBJECT_TYPE_DEVICE_MEMORY:
+        {
+            vkFreeMemory(device, VkDeviceMemory(entry.handle), nullptr);
+            break;
+        }
+        case VK_OBJECT_TYPE_FRAMEBUFFER:
+        {
+            vkDestroyFramebuffer(device, VkFramebuffer(entry.handle), nullptr);
+            break;
+        }
+        case VK_OBJECT_TYPE_RENDER_PASS:
+        {
+            vkDestroyRenderPass(device, VkRenderPass(entry.handle), nullptr);
+            break;
+        }
+        case VK_OBJECT_TYPE_PIPELINE:
+        {
+            vkDestroyPipeline(device, VkPipeline(entry.handle), nullptr);
+            break;
+        }
+        case VK_OBJECT_TYPE_SAMPLER:
+        {
+            vkDestroySampler(device, VkSampler(entry.handle), nullptr);
+            break;
+        }
+        case VK_OBJECT_TYPE_DESCRIPTOR_POOL:
+        {
+            vkDestroyDescriptorPool(device, VkDescriptorPool(entry.handle), nullptr);
+            break;
+        }
+        case VK_OBJECT_TYPE_QUERY_POOL:
+        {
+            vkDestroyQueryPool(device, VkQueryPool(entry.handle), nullptr);
+            break;
+        }
+        case VK_OBJECT_TYPE_SWAPCHAIN_KHR:
+        {
+            vkDestroySwapchainKHR(device, VkSwapchainKHR(entry.handle), nullptr);
+            break;
+        }
+        case VK_OBJECT_TYPE_SEMAPHORE:
+        {
+            vkDestroySemaphore(device, VkSemaphore(entry.handle), nullptr);
+            break;
+        }
+        default:
+        {
+            GS_ASSERT(!"Unsupported object type");
+            break;
+        }
+    }
+}
+
+void createDeletionQueue(VkDevice device, uint32_t framesInFlight, DeletionQueue& queue)
+{
+    queue.device = device;
+    queue.framesInFlight = framesInFlight;
+    queue.frameNumber = 0;
+}
+
+void destroyDeletionQueue(DeletionQueue& queue)
+{
+    std::lock_guard<std::mutex> lock(queue.mutex);
+
+    for (const DeletionQueue::Entry& entry : queue.entries)
+    {
+        destroyObject(queue.device, entry);
+    }
+
+    queue.entries.clear();
+}
+
+void beginDeletionQueueFrame(DeletionQueue& queue, uint64_t frameNumber)
+{
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    GS_ASSERT(frameNumber >= queue.frameNumber);
+    queue.frameNumber = frameNumber;
+
+    while (!queue.entries.empty() && frameNumber >= queue.entries.front().frameNumber + queue.framesInFlight)
+    {
+        destroyObject(queue.device, queue.entries.front());
+        queue.entries.pop_front();
+    }
+}
+
+void deferDestroy(DeletionQueue& queue, VkObjectType type, uint64_t handle)
+{
+    if (handle)
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.entries.push_back({ queue.frameNumber, type, handle });
+    }
+}
+
+void deferDestroyBuffer(DeletionQueue& queue, Buffer& buffer)
+{
+    // Freeing the memory unmaps it
+    deferDestroy(queue, buffer.buffer);
+    deferDestroy(queue, buffer.gpuMemory);
+    buffer = Buffer{};
+}
+
+} // namespace Vulkan
+} // namespace GameSmith
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "gsvulkan.h"
+
+#include "buffer.h"
+
+#include <deque>
+#include <mutex>
+
+namespace gs
+{
+namespace vk
+{
+
+// Destroys GPU objects once the frames that may use them have completed, so they can be dropped mid-frame without waiting for the
+// device. Objects are tagged with the frame being recorded when they are released and destroyed framesInFlight frames later, after
+// that frame slot's fence has been waited on again. Releasing is thread safe, so streaming code can drop objects from worker threads.
+struct DeletionQueue
+{
+    struct Entry
+    {
+        uint64_t frameNumber;
+        VkObjectType type;
+        uint64_t handle;
+    };
+
+    VkDevice device;
+    uint32_t framesInFlight;
+    uint64_t frameNumber;
+    std::deque<Entry> entries; // In release order, so in frame order
+    std::mutex mutex;
+};
+
+void createDeletionQueue(VkDevice device, uint32_t framesInFlight, DeletionQueue& queue);
+
+// Destroys everything still queued. Call once the device is idle.
+void destroyDeletionQueue(DeletionQueue& queue);
+
+// Destroys the objects released by frames that have since completed and tags later releases with frameNumber. Call after waiting
+// for frameNumber's frame slot, before anything is released during the frame.
+void beginDeletionQueueFrame(DeletionQueue& queue, uint64_t frameNumber);
+
+// Objects of the same frame are destroyed in release order, so release dependent objects first, e.g. views before their images.
+void deferDestroy(DeletionQueue& queue, VkObjectType type, uint64_t handle);
+void deferDestroyBuffer(DeletionQueue& queue, Buffer& buffer);
+
+inline void deferDestroy(DeletionQueue& queue, VkBuffer buffer)
+{
+    deferDestroy(queue, VK_OBJECT_TYPE_BUFFER, uint64_t(buffer));
+}
+
+inline void deferDestroy(DeletionQueue& queue, VkImage image)
+{
+    deferDestroy(queue, VK_OBJECT_TYPE_IMAGE, uint64_t(image));
+}
+
+inline void deferDestroy(DeletionQueue& queue, VkImageView view)
+{
+    deferDestroy(queue, VK_OBJECT_TYPE_IMAGE_VIEW, uint64_t(view));
+}
+
+inline void deferDestroy(DeletionQueue& queue, VkDeviceMemory memory)
+{
+    deferDestroy(queue, VK_OBJECT_TYPE_DEVICE_MEMORY, uint64_t(memory));
+}
+
+inline void deferDestroy(DeletionQueue& queue, VkFramebuffer framebuffer)
+{
+    deferDestroy(queue, VK_OBJECT_TYPE_FRAMEBUFFER, uint64_t(framebuffer));
+}
+
+inline void deferDestroy(DeletionQueue& queue, VkRenderPass renderPass)
+{
+    deferDestroy(queue, VK_OBJECT_TYPE_RENDER_PASS, uint64_t(renderPass));
+}
+
+inline void deferDestroy(DeletionQueue& queue, VkPipeline pipeline)
+{
+    deferDestroy(queue, VK_OBJECT_TYPE_PIPELINE, uint64_t(pipeline));
+}
+
+inline void deferDestroy(DeletionQueue& queue, VkSampler sampler)
+{
+    deferDestroy(queue, VK_OBJECT_TYPE_SAMPLER, uint64_t(sampler));
+}
+
+inline void deferDestroy(DeletionQueue& queue, VkDescriptorPool descriptorPool)
+{
+    deferDestroy(queue, VK_OBJECT_TYPE_DESCRIPTOR_POOL, uint64_t(descriptorPool));
+}
+
+inline void deferDestroy(DeletionQueue& queue, VkQueryPool queryPool)
+{
+    deferDestroy(queue, VK_OBJECT_TYPE_QUERY_POOL, uint64_t(queryPool));
+}
+
+inline void deferDestroy(DeletionQueue& queue, VkSwapchainKHR swapchain)
+{
+    deferDestroy(queue, VK_OBJECT_TYPE_SWAPCHAIN_KHR, uint64_t(swapchain));
+}
+
+inline void deferDestroy(DeletionQueue& queue, VkSemaphore semaphore)
+{
+    deferDestroy(queue, VK_OBJECT_TYPE_SEMAPHORE, uint64_t(semaphore));
+}
+
+} // namespace Vulkan
+} // namespace GameSmith
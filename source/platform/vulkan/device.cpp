@@ -7,12 +7,314 @@
 #include "gamesmith/core/log.h"
 #include "renderer_vk.h"
 
+#include <charconv>
+
 namespace gs
 {
 namespace vk
 {
 
-void choosePhysicalDevice(VkInstance instance, VkSurfaceKHR surface, VkPhysicalDevice& physicalDevice, uint32_t& graphicsQueueIndex)
+// Features createDevice enables unconditionally, so devices without any of them can't run the renderer
+struct RequiredFeature
+{
+    VkBool32 VkPhysicalDeviceVulkan12Features::*feature;
+    const char* name;
+};
+
+static const RequiredFeature kRequiredVulkan12Features[] = {
+    { &VkPhysicalDeviceVulkan12Features::separateDepthStencilLayouts, "separateDepthStencilLayouts" },
+    { &VkPhysicalDeviceVulkan12Features::timelineSemaphore, "timelineSemaphore" },
+
+    // Lets the render graph's framebuffers be keyed by attachment formats and extent rather than by image views
+    { &VkPhysicalDeviceVulkan12Features::imagelessFramebuffer, "imagelessFramebuffer" },
+
+    // Bindless heap: partially bound, update-after-bind arrays indexed dynamically by shaders
+    { &VkPhysicalDeviceVulkan12Features::runtimeDescriptorArray, "runtimeDescriptorArray" },
+    { &VkPhysicalDeviceVulkan12Features::descriptorBindingPartiallyBound, "descriptorBindingPartiallyBound" },
+    { &VkPhysicalDeviceVulkan12Features::descriptorBindingUpdateUnusedWhilePending, "descriptorBindingUpdateUnusedWhilePending" },
+    { &VkPhysicalDeviceVulkan12Features::descriptorBindingStorageBufferUpdateAfterBind, "descriptorBindingStorageBufferUpdateAfterBind" },
+    { &VkPhysicalDeviceVulkan12Features::descriptorBindingSampledImageUpdateAfterBind, "descriptorBindingSampledImageUpdateAfterBind" },
+    { &VkPhysicalDeviceVulkan12Features::shaderStorageBufferArrayNonUniformIndexing, "shaderStorageBufferArrayNonUniformIndexing" },
+    { &VkPhysicalDeviceVulkan12Features::shaderSampledImageArrayNonUniformIndexing, "shaderSampledImageArrayNonUniformIndexing" },
+};
+
+// Each criterion of a device's score gets its own bit field, so it only decides between devices that tie on all the fields above it:
+// the device type comes first, then the number of optional features, which also tells newer hardware generations apart, then device
+// local memory in MiB, then the bindless sampled image limit in units of 4096, and last dedicated compute and transfer queue families.
+static const uint32_t kDeviceTypeScoreShift = 56;
+static const uint32_t kOptionalFeatureScoreShift = 48;
+static const uint32_t kDeviceLocalMemoryScoreShift = 16;
+static const uint32_t kBindlessLimitScoreShift = 2;
+static const uint32_t kDedicatedComputeQueueScoreShift = 1;
+static const uint64_t kMaxDeviceLocalMemoryScore = (1ull << (kOptionalFeatureScoreShift - kDeviceLocalMemoryScoreShift)) - 1;
+static const uint32_t kMaxBindlessSampledImages = 1 << 20; // Scores at most 256, within the 14 bits below the memory field
+
+struct PhysicalDeviceCandidate
+{
+    VkPhysicalDevice physicalDevice;
+    VkPhysicalDeviceProperties properties;
+    uint32_t graphicsQueueIndex;
+    std::string missing; // What the renderer requires but the device lacks, empty if the device is usable
+    uint64_t score;
+};
+
+static const char* deviceTypeName(VkPhysicalDeviceType deviceType)
+{
+    switch (deviceType)
+    {
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        {
+            return "integrated GPU";
+        }
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        {
+            return "discrete GPU";
+        }
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        {
+            return "virtual GPU";
+        }
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        {
+            return "CPU";
+        }
+        default:
+        {
+            return "other";
+        }
+    }
+}
+
+// Software rasterizers such as llvmpipe and SwiftShader report as CPUs and are only chosen when nothing else can run the renderer
+static uint64_t deviceTypeRank(VkPhysicalDeviceType deviceType)
+{
+    switch (deviceType)
+    {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        {
+            return 4;
+        }
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        {
+            return 3;
+        }
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        {
+            return 2;
+        }
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        {
+            return 0;
+        }
+        default:
+        {
+            return 1;
+        }
+    }
+}
+
+static std::vector<VkQueueFamilyProperties> getQueueFamilyProperties(VkPhysicalDevice physicalDevice)
+{
+    uint32_t queueFamilyPropertiesCount{};
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyPropertiesCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyPropertiesCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyPropertiesCount, queueFamilyProperties.data());
+    return queueFamilyProperties;
+}
+
+// First queue family that has all of the required flags and none of the excluded ones
+static std::optional<uint32_t> findQueueFamily(const std::vector<VkQueueFamilyProperties>& queueFamilyProperties, VkQueueFlags required,
+                                               VkQueueFlags excluded)
+{
+    for (uint32_t q = 0; q < uint32_t(queueFamilyProperties.size()); ++q)
+    {
+        VkQueueFlags flags = queueFamilyProperties[q].queueFlags;
+
+        if ((flags & required) == required && !(flags & excluded))
+        {
+            return q;
+        }
+    }
+
+    return {};
+}
+
+static bool hasExtension(const std::vector<VkExtensionProperties>& extensions, const char* name)
+{
+    return std::any_of(extensions.begin(), extensions.end(), [&](const VkExtensionProperties& e) { return strcmp(e.extensionName, name) == 0; });
+}
+
+static const char* yesNo(bool value)
+{
+    return value ? "yes" : "no";
+}
+
+// Checks the device against the renderer's requirements, scores it if it meets them and logs what it can do either way
+static PhysicalDeviceCandidate ratePhysicalDevice(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, uint32_t index)
+{
+    PhysicalDeviceCandidate candidate{};
+    candidate.physicalDevice = physicalDevice;
+    vkGetPhysicalDeviceProperties(physicalDevice, &candidate.properties);
+    const VkPhysicalDeviceProperties& props = candidate.properties;
+
+    GS_INFO("Vulkan device %u: %s (%s, Vulkan %u.%u.%u, vendor 0x%04x, device 0x%04x)", index, props.deviceName,
+            deviceTypeName(props.deviceType), VK_API_VERSION_MAJOR(props.apiVersion), VK_API_VERSION_MINOR(props.apiVersion),
+            VK_API_VERSION_PATCH(props.apiVersion), props.vendorID, props.deviceID);
+
+    // Vulkan 1.2 features can't even be queried from older devices
+    if (props.apiVersion < VK_API_VERSION_1_2)
+    {
+        candidate.missing = "Vulkan 1.2";
+        GS_INFO("    Not usable, missing: %s", candidate.missing.c_str());
+        return candidate;
+    }
+
+    // Need graphics queue with presentation support
+    std::vector<VkQueueFamilyProperties> queueFamilyProperties = getQueueFamilyProperties(physicalDevice);
+    std::optional<uint32_t> graphicsQueueIndex{};
+
+    for (uint32_t q = 0; q < uint32_t(queueFamilyProperties.size()) && !graphicsQueueIndex; ++q)
+    {
+        if (queueFamilyProperties[q].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+        {
+            VkBool32 supported{};
+            VK_CHECK_RESULT(vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, q, surface, &supported));
+
+            if (supported)
+            {
+                graphicsQueueIndex = q;
+            }
+        }
+    }
+
+    std::vector<std::string> missing;
+
+    if (graphicsQueueIndex)
+    {
+        candidate.graphicsQueueIndex = graphicsQueueIndex.value();
+    }
+    else
+    {
+        missing.push_back("graphics queue with presentation support");
+    }
+
+    uint32_t extensionCount{};
+    VK_CHECK_RESULT(vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr));
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    VK_CHECK_RESULT(vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data()));
+
+    if (!hasExtension(extensions, VK_KHR_SWAPCHAIN_EXTENSION_NAME))
+    {
+        missing.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
+
+    VkPhysicalDeviceVulkan12Features vulkan12Features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+    VkPhysicalDeviceFeatures2 features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+    features.pNext = &vulkan12Features;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+    for (const RequiredFeature& required : kRequiredVulkan12Features)
+    {
+        if (vulkan12Features.*required.feature != VK_TRUE)
+        {
+            missing.push_back(required.name);
+        }
+    }
+
+    VkPhysicalDeviceDescriptorIndexingProperties descriptorIndexingProperties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES };
+    VkPhysicalDeviceProperties2 properties2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+    properties2.pNext = &descriptorIndexingProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    VkDeviceSize deviceLocalMemory = 0;
+
+    // Integrated GPUs report shared system memory as device local, which the device type score already outweighs
+    for (uint32_t h = 0; h < memoryProperties.memoryHeapCount; ++h)
+    {
+        if (memoryProperties.memoryHeaps[h].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+        {
+            deviceLocalMemory = std::max(deviceLocalMemory, memoryProperties.memoryHeaps[h].size);
+        }
+    }
+
+    std::optional<uint32_t> computeQueueIndex = findQueueFamily(queueFamilyProperties, VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT);
+    std::optional<uint32_t> transferQueueIndex =
+        findQueueFamily(queueFamilyProperties, VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+
+    // Mesh shaders aren't used by the renderer yet, but like the other optional features they mark a newer generation of hardware
+    bool dynamicRendering = isDynamicRenderingSupported(physicalDevice);
+    bool meshShaders = hasExtension(extensions, "VK_EXT_mesh_shader") || hasExtension(extensions, "VK_NV_mesh_shader");
+    bool drawIndirectCount = vulkan12Features.drawIndirectCount == VK_TRUE;
+    bool multiDrawIndirect = features.features.multiDrawIndirect == VK_TRUE;
+    bool pipelineStatistics = features.features.pipelineStatisticsQuery == VK_TRUE;
+
+    uint32_t bindlessSampledImages = descriptorIndexingProperties.maxDescriptorSetUpdateAfterBindSampledImages;
+    uint32_t bindlessStorageBuffers = descriptorIndexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers;
+
+    GS_INFO("    %llu MiB device local memory, dedicated compute queue: %s, dedicated transfer queue: %s",
+            (unsigned long long)(deviceLocalMemory >> 20), yesNo(computeQueueIndex.has_value()), yesNo(transferQueueIndex.has_value()));
+    GS_INFO("    Dynamic rendering: %s, mesh shaders: %s, draw indirect count: %s, multi-draw indirect: %s, pipeline statistics: %s",
+            yesNo(dynamicRendering), yesNo(meshShaders), yesNo(drawIndirectCount), yesNo(multiDrawIndirect), yesNo(pipelineStatistics));
+    GS_INFO("    Max 2D image size: %u, bindless sampled images: %u, bindless storage buffers: %u", props.limits.maxImageDimension2D,
+            bindlessSampledImages, bindlessStorageBuffers);
+
+    if (!missing.empty())
+    {
+        for (const std::string& requirement : missing)
+        {
+            candidate.missing += (candidate.missing.empty() ? "" : ", ") + requirement;
+        }
+
+        GS_INFO("    Not usable, missing: %s", candidate.missing.c_str());
+        return candidate;
+    }
+
+    uint64_t optionalFeatureCount = 0;
+
+    for (bool optionalFeature : { dynamicRendering, meshShaders, drawIndirectCount, multiDrawIndirect, pipelineStatistics })
+    {
+        optionalFeatureCount += optionalFeature ? 1 : 0;
+    }
+
+    uint64_t score = deviceTypeRank(props.deviceType) << kDeviceTypeScoreShift;
+    score |= optionalFeatureCount << kOptionalFeatureScoreShift;
+    score |= std::min(uint64_t(deviceLocalMemory >> 20), kMaxDeviceLocalMemoryScore) << kDeviceLocalMemoryScoreShift;
+    score |= uint64_t(std::min(bindlessSampledImages, kMaxBindlessSampledImages) >> 12) << kBindlessLimitScoreShift;
+    score |= uint64_t(computeQueueIndex ? 1 : 0) << kDedicatedComputeQueueScoreShift;
+    score |= transferQueueIndex ? 1 : 0;
+
+    candidate.score = score;
+    GS_INFO("    Score: %llu", (unsigned long long)score);
+    return candidate;
+}
+
+// An index into the enumerated devices, or otherwise a case-insensitive part of the device name. Numbers too long to be an index
+// match no device.
+static bool matchesDeviceOverride(const PhysicalDeviceCandidate& candidate, uint32_t index, const std::string& deviceOverride)
+{
+    auto isDigit = [](char c) { return c >= '0' && c <= '9'; };
+
+    if (std::all_of(deviceOverride.begin(), deviceOverride.end(), isDigit))
+    {
+        const char* end = deviceOverride.data() + deviceOverride.size();
+        uint32_t requested{};
+        std::from_chars_result result = std::from_chars(deviceOverride.data(), end, requested);
+        return result.ec == std::errc() && result.ptr == end && requested == index;
+    }
+
+    auto toLower = [](std::string s)
+    {
+        std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+        return s;
+    };
+
+    return toLower(candidate.properties.deviceName).find(toLower(deviceOverride)) != std::string::npos;
+}
+
+void choosePhysicalDevice(VkInstance instance, VkSurfaceKHR surface, const std::string& deviceOverride, VkPhysicalDevice& physicalDevice,
+                          uint32_t& graphicsQueueIndex)
 {
     physicalDevice = VK_NULL_HANDLE;
 
@@ -22,97 +324,234 @@ void choosePhysicalDevice(VkInstance instance, VkSurfaceKHR surface, VkPhysicalD
     std::vector<VkPhysicalDevice> physicalDevices(physicalDeviceCount);
     VK_CHECK_RESULT(vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, physicalDevices.data()));
 
-    std::vector<VkPhysicalDevice> suitableDevices;
-    suitableDevices.reserve(physicalDeviceCount);
+    std::vector<PhysicalDeviceCandidate> candidates;
+    candidates.reserve(physicalDeviceCount);
 
-    std::vector<uint32_t> graphicsQueueIndices;
-    graphicsQueueIndices.reserve(physicalDeviceCount);
-
-    for (VkPhysicalDevice& device : physicalDevices)
+    for (uint32_t i = 0; i < physicalDeviceCount; ++i)
     {
-        uint32_t queueFamilyPropertiesCount{};
-        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyPropertiesCount, nullptr);
-        std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyPropertiesCount);
-        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyPropertiesCount, queueFamilyProperties.data());
+        candidates.push_back(ratePhysicalDevice(physicalDevices[i], surface, i));
+    }
 
-        // Need graphics queue with presentation support
-        std::optional<uint32_t> graphicsQueueIndex{};
+    const PhysicalDeviceCandidate* chosen = nullptr;
+    const char* reason = "highest score";
 
-        for (uint32_t q = 0; q < queueFamilyPropertiesCount; ++q)
+    if (!deviceOverride.empty())
+    {
+        for (uint32_t i = 0; i < physicalDeviceCount && !chosen; ++i)
         {
-            if (!graphicsQueueIndex && (queueFamilyProperties[q].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+            if (matchesDeviceOverride(candidates[i], i, deviceOverride))
             {
-                VkBool32 supported{};
-                VK_CHECK_RESULT(vkGetPhysicalDeviceSurfaceSupportKHR(device, q, surface, &supported));
-
-                if (supported)
+                if (candidates[i].missing.empty())
+                {
+                    chosen = &candidates[i];
+                    reason = "requested";
+                }
+                else
                 {
-                    graphicsQueueIndex = q;
+                    GS_WARN("Requested Vulkan device %s is missing: %s.", candidates[i].properties.deviceName, candidates[i].missing.c_str());
                 }
             }
         }
 
-        if (graphicsQueueIndex)
+        if (!chosen)
         {
-            suitableDevices.push_back(device);
-            graphicsQueueIndices.push_back(graphicsQueueIndex.value());
+            GS_WARN("No usable Vulkan device matches '%s', choosing by score instead.", deviceOverride.c_str());
         }
     }
 
-    if (suitableDevices.size() > 0)
+    if (!chosen)
     {
-        for (size_t i = 0; i < suitableDevices.size(); ++i)
+        // Ties go to the first enumerated device, so the choice is the same on every run
+        for (const PhysicalDeviceCandidate& candidate : candidates)
         {
-            VkPhysicalDevice& device = suitableDevices[i];
-            VkPhysicalDeviceProperties props{};
-            vkGetPhysicalDeviceProperties(device, &props);
-
-            if (props.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
+            if (candidate.missing.empty() && (!chosen || candidate.score > chosen->score))
             {
-                physicalDevice = device;
-                graphicsQueueIndex = graphicsQueueIndices[i];
-                GS_INFO("Choosing discrete GPU: %s, graphics/presentation queue index: %u", props.deviceName, graphicsQueueIndex);
-                break;
+                chosen = &candidate;
             }
         }
+    }
 
-        if (!physicalDevice)
-        {
-            VkPhysicalDeviceProperties props{};
-            vkGetPhysicalDeviceProperties(suitableDevices[0], &props);
-            physicalDevice = suitableDevices[0];
-            graphicsQueueIndex = graphicsQueueIndices[0];
-            GS_INFO("Choosing fallback device: %s, graphics/presentation queue index: %u", props.deviceName, graphicsQueueIndex);
-        }
+    if (chosen)
+    {
+        physicalDevice = chosen->physicalDevice;
+        graphicsQueueIndex = chosen->graphicsQueueIndex;
+        GS_INFO("Choosing %s (%s): %s, graphics/presentation queue index: %u", deviceTypeName(chosen->properties.deviceType), reason,
+                chosen->properties.deviceName, graphicsQueueIndex);
     }
     else
     {
-        GS_INFO("No suitable Vulkan device found.");
+        GS_ERROR("No suitable Vulkan device found.");
+    }
+}
+
+uint32_t chooseTransferQueueFamily(VkPhysicalDevice physicalDevice, uint32_t graphicsQueueIndex)
+{
+    std::vector<VkQueueFamilyProperties> queueFamilyProperties = getQueueFamilyProperties(physicalDevice);
+    std::optional<uint32_t> q = findQueueFamily(queueFamilyProperties, VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+
+    if (q)
+    {
+        GS_INFO("Using dedicated transfer queue index: %u", q.value());
+        return q.value();
     }
+
+    return graphicsQueueIndex;
 }
 
-VkDevice createDevice(VkPhysicalDevice physicalDevice, uint32_t graphicsQueueIndex)
+uint32_t chooseComputeQueueFamily(VkPhysicalDevice physicalDevice, uint32_t graphicsQueueIndex)
+{
+    std::vector<VkQueueFamilyProperties> queueFamilyProperties = getQueueFamilyProperties(physicalDevice);
+    std::optional<uint32_t> q = findQueueFamily(queueFamilyProperties, VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT);
+
+    if (q)
+    {
+        GS_INFO("Using dedicated compute queue index: %u", q.value());
+        return q.value();
+    }
+
+    return graphicsQueueIndex;
+}
+
+bool isDynamicRenderingSupported(VkPhysicalDevice physicalDevice)
+{
+    uint32_t extensionCount{};
+    VK_CHECK_RESULT(vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr));
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    VK_CHECK_RESULT(vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data()));
+
+    auto isDynamicRendering = [](const VkExtensionProperties& e) { return strcmp(e.extensionName, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) == 0; };
+
+    if (std::none_of(extensions.begin(), extensions.end(), isDynamicRendering))
+    {
+        return false;
+    }
+
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR };
+    VkPhysicalDeviceFeatures2 features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+    features.pNext = &dynamicRenderingFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+    return dynamicRenderingFeatures.dynamicRendering == VK_TRUE;
+}
+
+bool isPresentWaitSupported(VkPhysicalDevice physicalDevice)
+{
+    uint32_t extensionCount{};
+    VK_CHECK_RESULT(vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr));
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    VK_CHECK_RESULT(vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data()));
+
+    if (!hasExtension(extensions, VK_KHR_PRESENT_ID_EXTENSION_NAME) || !hasExtension(extensions, VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+    {
+        return false;
+    }
+
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR };
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR };
+    presentIdFeatures.pNext = &presentWaitFeatures;
+    VkPhysicalDeviceFeatures2 features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+    features.pNext = &presentIdFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+    return presentIdFeatures.presentId == VK_TRUE && presentWaitFeatures.presentWait == VK_TRUE;
+}
+
+bool isCalibratedTimestampsSupported(VkPhysicalDevice physicalDevice)
+{
+    uint32_t extensionCount{};
+    VK_CHECK_RESULT(vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr));
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    VK_CHECK_RESULT(vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data()));
+    return hasExtension(extensions, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+}
+
+VkDevice createDevice(VkPhysicalDevice physicalDevice, uint32_t graphicsQueueIndex, uint32_t computeQueueIndex, uint32_t transferQueueIndex)
 {
     float queuePriority = 1.0f;
-    VkDeviceQueueCreateInfo queueCreateInfo{ VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO };
-    queueCreateInfo.queueFamilyIndex = graphicsQueueIndex;
-    queueCreateInfo.queueCount = 1;
-    queueCreateInfo.pQueuePriorities = &queuePriority;
+    VkDeviceQueueCreateInfo queueCreateInfos[3]{};
+    uint32_t queueCreateInfoCount = 0;
 
-    static const char* extensions[] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+    for (uint32_t queueIndex : { graphicsQueueIndex, computeQueueIndex, transferQueueIndex })
+    {
+        auto isQueueFamily = [&](const VkDeviceQueueCreateInfo& createInfo) { return createInfo.queueFamilyIndex == queueIndex; };
+
+        if (std::none_of(queueCreateInfos, queueCreateInfos + queueCreateInfoCount, isQueueFamily))
+        {
+            VkDeviceQueueCreateInfo& queueCreateInfo = queueCreateInfos[queueCreateInfoCount++];
+            queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+            queueCreateInfo.queueFamilyIndex = queueIndex;
+            queueCreateInfo.queueCount = 1;
+            queueCreateInfo.pQueuePriorities = &queuePriority;
+        }
+    }
+
+    std::vector<const char*> extensions{ VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 
     VkPhysicalDeviceFeatures2 enabledFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
 
-    VkPhysicalDeviceSeparateDepthStencilLayoutsFeatures separateDepthStencilLayoutsFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SEPARATE_DEPTH_STENCIL_LAYOUTS_FEATURES };
-    enabledFeatures.pNext = &separateDepthStencilLayoutsFeatures;
-    separateDepthStencilLayoutsFeatures.separateDepthStencilLayouts = VK_TRUE;
+    // Optional features used for instrumentation
+    VkPhysicalDeviceFeatures supportedFeatures{};
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+    enabledFeatures.features.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+    enabledFeatures.features.inheritedQueries = supportedFeatures.inheritedQueries;
+
+    // Optional features used by GPU driven drawing
+    enabledFeatures.features.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    enabledFeatures.features.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+
+    VkPhysicalDeviceVulkan12Features supportedVulkan12Features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+    VkPhysicalDeviceFeatures2 supportedFeatures2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+    supportedFeatures2.pNext = &supportedVulkan12Features;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures2);
+
+    VkPhysicalDeviceVulkan12Features vulkan12Features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+    enabledFeatures.pNext = &vulkan12Features;
+
+    for (const RequiredFeature& required : kRequiredVulkan12Features)
+    {
+        vulkan12Features.*required.feature = VK_TRUE;
+    }
+
+    // GPU culling writes its own draw count
+    vulkan12Features.drawIndirectCount = supportedVulkan12Features.drawIndirectCount;
+
+    // Optional feature structures are appended here
+    void** featureChain = &vulkan12Features.pNext;
+
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR };
+
+    if (isDynamicRenderingSupported(physicalDevice))
+    {
+        extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+        dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+        *featureChain = &dynamicRenderingFeatures;
+        featureChain = &dynamicRenderingFeatures.pNext;
+    }
+
+    // Optional extensions used to measure input to present latency
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR };
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR };
+
+    if (isPresentWaitSupported(physicalDevice))
+    {
+        extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        presentIdFeatures.presentId = VK_TRUE;
+        presentWaitFeatures.presentWait = VK_TRUE;
+        presentIdFeatures.pNext = &presentWaitFeatures;
+        *featureChain = &presentIdFeatures;
+        featureChain = &presentWaitFeatures.pNext;
+    }
+
+    if (isCalibratedTimestampsSupported(physicalDevice))
+    {
+        extensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+    }
 
     VkDeviceCreateInfo createInfo{ VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
     createInfo.pNext = &enabledFeatures;
-    createInfo.queueCreateInfoCount = 1;
-    createInfo.pQueueCreateInfos = &queueCreateInfo;
-    createInfo.ppEnabledExtensionNames = extensions;
-    createInfo.enabledExtensionCount = GS_ARRAY_COUNT(extensions);
+    createInfo.queueCreateInfoCount = queueCreateInfoCount;
+    createInfo.pQueueCreateInfos = queueCreateInfos;
+    createInfo.ppEnabledExtensionNames = extensions.data();
+    createInfo.enabledExtensionCount = uint32_t(extensions.size());
 
     VkDevice device{};
     VK_CHECK_RESULT(vkCreateDevice(physicalDevice, &createInfo, nullptr, &device));
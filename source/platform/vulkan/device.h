@@ -7,8 +7,33 @@ namespace gs
 namespace vk
 {
 
-void choosePhysicalDevice(VkInstance instance, VkSurfaceKHR surface, VkPhysicalDevice& physicalDevice, uint32_t& graphicsQueueIndex);
-VkDevice createDevice(VkPhysicalDevice physicalDevice, uint32_t graphicsQueueIndex);
+// Rates every device and returns the best one that can present to the surface and has the API version, extensions and Vulkan 1.2
+// features the renderer requires, logging a capability report for each device on the way. Discrete GPUs rate above integrated ones,
+// which rate above virtual and software devices. Between devices of a type the number of optional features decides, and only on a
+// tie device local memory, then the bindless limits and last dedicated compute and transfer queue families. deviceOverride picks a
+// device by its index in the report or by part of its name instead, unless that device isn't usable.
+void choosePhysicalDevice(VkInstance instance, VkSurfaceKHR surface, const std::string& deviceOverride, VkPhysicalDevice& physicalDevice,
+                          uint32_t& graphicsQueueIndex);
+
+// Prefers a transfer-only queue family (usually a DMA engine), falls back to the graphics queue family when there is none.
+uint32_t chooseTransferQueueFamily(VkPhysicalDevice physicalDevice, uint32_t graphicsQueueIndex);
+
+// Prefers a compute queue family without graphics support, which runs alongside the graphics queue as async compute, and falls back to
+// the graphics queue family when there is none.
+uint32_t chooseComputeQueueFamily(VkPhysicalDevice physicalDevice, uint32_t graphicsQueueIndex);
+
+// VK_KHR_dynamic_rendering (core in Vulkan 1.3) lets passes render without render pass and framebuffer objects.
+bool isDynamicRenderingSupported(VkPhysicalDevice physicalDevice);
+
+// VK_KHR_present_id and VK_KHR_present_wait let the CPU wait for a present to be displayed
+bool isPresentWaitSupported(VkPhysicalDevice physicalDevice);
+
+// VK_EXT_calibrated_timestamps samples the device's timestamp clock together with a host clock
+bool isCalibratedTimestampsSupported(VkPhysicalDevice physicalDevice);
+
+// Optional features and extensions are enabled whenever they are supported. One queue is created per distinct queue family, so queue
+// index 0 of each of the three families is valid.
+VkDevice createDevice(VkPhysicalDevice physicalDevice, uint32_t graphicsQueueIndex, uint32_t computeQueueIndex, uint32_t transferQueueIndex);
 
 }
 } // namespace GameSmith
\ No newline at end of file
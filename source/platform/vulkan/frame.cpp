@@ -0,0 +1,105 @@
+#include "gspch.h"
+
+#include "frame.h"
+
+#include "gamesmith/core/debug.h"
+
+namespace gs
+{
+namespace vk
+{
+
+void createFrames(VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount, uint32_t recordingThreadCount, std::vector<Frame>& frames)
+{
+    GS_ASSERT(frameCount > 0);
+    frames.resize(frameCount);
+
+    for (Frame& frame : frames)
+    {
+        VkCommandPoolCreateInfo commandPoolCreateInfo{ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+        commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+        VK_CHECK_RESULT(vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &frame.commandPool));
+
+        VkCommandBufferAllocateInfo allocInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+        allocInfo.commandPool = frame.commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &allocInfo, &frame.commandBuffer));
+
+        frame.threadCommandPools.resize(recordingThreadCount);
+
+        for (ThreadCommandPool& threadCommandPool : frame.threadCommandPools)
+        {
+            VK_CHECK_RESULT(vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &threadCommandPool.commandPool));
+            threadCommandPool.usedCount = 0;
+        }
+
+        VkFenceCreateInfo fenceCreateInfo{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+        fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &frame.fence));
+
+        VkSemaphoreCreateInfo semaphoreCreateInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+        VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frame.acquireCompleteSemaphore));
+    }
+}
+
+void destroyFrames(VkDevice device, std::vector<Frame>& frames)
+{
+    for (Frame& frame : frames)
+    {
+        vkDestroySemaphore(device, frame.acquireCompleteSemaphore, nullptr);
+        vkDestroyFence(device, frame.fence, nullptr);
+        vkDestroyCommandPool(device, frame.commandPool, nullptr);
+
+        for (ThreadCommandPool& threadCommandPool : frame.threadCommandPools)
+        {
+            vkDestroyCommandPool(device, threadCommandPool.commandPool, nullptr);
+        }
+    }
+
+    frames.clear();
+}
+
+void waitForFrame(VkDevice device, Frame& frame)
+{
+    VK_CHECK_RESULT(vkWaitForFences(device, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+}
+
+void resetFrame(VkDevice device, Frame& frame)
+{
+    VK_CHECK_RESULT(vkResetFences(device, 1, &frame.fence));
+    VK_CHECK_RESULT(vkResetCommandPool(device, frame.commandPool, 0));
+
+    for (ThreadCommandPool& threadCommandPool : frame.threadCommandPools)
+    {
+        if (threadCommandPool.usedCount)
+        {
+            VK_CHECK_RESULT(vkResetCommandPool(device, threadCommandPool.commandPool, 0));
+            threadCommandPool.usedCount = 0;
+        }
+    }
+}
+
+VkCommandBuffer getSecondaryCommandBuffer(VkDevice device, Frame& frame, uint32_t threadIndex)
+{
+    GS_ASSERT(threadIndex < frame.threadCommandPools.size());
+    ThreadCommandPool& threadCommandPool = frame.threadCommandPools[threadIndex];
+
+    if (threadCommandPool.usedCount == threadCommandPool.secondaryCommandBuffers.size())
+    {
+        VkCommandBufferAllocateInfo allocInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+        allocInfo.commandPool = threadCommandPool.commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer{};
+        VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer));
+        threadCommandPool.secondaryCommandBuffers.push_back(commandBuffer);
+    }
+
+    return threadCommandPool.secondaryCommandBuffers[threadCommandPool.usedCount++];
+}
+
+} // namespace Vulkan
+} // namespace GameSmith
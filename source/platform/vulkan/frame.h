@@ -0,0 +1,43 @@
+#pragma once
+
+#include "gsvulkan.h"
+
+namespace gs
+{
+namespace vk
+{
+
+// Command pool owned by one recording thread for one frame. Secondary command buffers are allocated on demand and recycled when the
+// frame is reset.
+struct ThreadCommandPool
+{
+    VkCommandPool commandPool;
+    std::vector<VkCommandBuffer> secondaryCommandBuffers;
+    uint32_t usedCount;
+};
+
+// Per frame-in-flight resources. Frames are used round-robin and are independent of the swapchain image count, so the CPU can record
+// frame N+1 while the GPU is still executing frame N.
+struct Frame
+{
+    VkCommandPool commandPool;
+    VkCommandBuffer commandBuffer;
+    VkFence fence;
+    VkSemaphore acquireCompleteSemaphore; // Rendering signals the acquired image's Swapchain::presentSemaphores entry for present
+    std::vector<ThreadCommandPool> threadCommandPools; // Indexed by ThreadPool thread index
+};
+
+void createFrames(VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount, uint32_t recordingThreadCount, std::vector<Frame>& frames);
+void destroyFrames(VkDevice device, std::vector<Frame>& frames);
+
+// Blocks until the GPU has finished the previous submission that used this frame.
+void waitForFrame(VkDevice device, Frame& frame);
+
+// Resets the frame's fence and command pools ready for recording; call after waitForFrame once the frame is certain to be submitted.
+void resetFrame(VkDevice device, Frame& frame);
+
+// Returns an unused secondary command buffer from the given thread's pool. Only the thread owning threadIndex may call this.
+VkCommandBuffer getSecondaryCommandBuffer(VkDevice device, Frame& frame, uint32_t threadIndex);
+
+} // namespace Vulkan
+} // namespace GameSmith
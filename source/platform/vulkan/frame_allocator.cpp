@@ -0,0 +1,186 @@
+#include "gspch.h"
+
+#include "frame_allocator.h"
+
+#include "gamesmith/core/debug.h"
+#include "gamesmith/core/log.h"
+
+namespace gs
+{
+namespace vk
+{
+
+// Pages double in size, so a frame only reaches this many pages by growing by several orders of magnitude in one frame
+static const uint32_t kMaxPagesPerFrame = 16;
+
+static FrameAllocator::Page createPage(FrameAllocator& allocator, VkDeviceSize size)
+{
+    FrameAllocator::Page page{};
+    page.buffer = createBuffer(allocator.physicalDevice, allocator.device, size, allocator.usage,
+                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, { allocator.queueFamilyIndex });
+    GS_ASSERT(page.buffer.buffer);
+
+    if (allocator.descriptorSetLayout)
+    {
+        VkDescriptorSetAllocateInfo allocateInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+        allocateInfo.descriptorPool = allocator.descriptorPool;
+        allocateInfo.descriptorSetCount = 1;
+        allocateInfo.pSetLayouts = &allocator.descriptorSetLayout;
+        VK_CHECK_RESULT(vkAllocateDescriptorSets(allocator.device, &allocateInfo, &page.descriptorSet));
+
+        VkDescriptorBufferInfo bufferInfo{};
+        bufferInfo.buffer = page.buffer.buffer;
+        bufferInfo.offset = 0;
+        bufferInfo.range = allocator.descriptorRange;
+
+        VkWriteDescriptorSet write{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+        write.dstSet = page.descriptorSet;
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = allocator.descriptorType;
+        write.pBufferInfo = &bufferInfo;
+        vkUpdateDescriptorSets(allocator.device, 1, &write, 0, nullptr);
+    }
+
+    return page;
+}
+
+static void destroyPage(FrameAllocator& allocator, FrameAllocator::Page& page)
+{
+    if (page.descriptorSet)
+    {
+        VK_CHECK_RESULT(vkFreeDescriptorSets(allocator.device, allocator.descriptorPool, 1, &page.descriptorSet));
+    }
+
+    destroyBuffer(allocator.device, page.buffer);
+}
+
+void createFrameAllocator(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount, VkDeviceSize pageSize,
+                          VkBufferUsageFlags usage, VkDescriptorSetLayout descriptorSetLayout, VkDeviceSize descriptorRange,
+                          FrameAllocator& allocator)
+{
+    GS_ASSERT(usage & (VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT));
+
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    allocator.physicalDevice = physicalDevice;
+    allocator.device = device;
+    allocator.queueFamilyIndex = queueFamilyIndex;
+    allocator.usage = usage;
+    allocator.alignment = 1;
+    allocator.descriptorSetLayout = descriptorSetLayout;
+    allocator.descriptorRange = descriptorRange;
+    allocator.descriptorPool = VK_NULL_HANDLE;
+    allocator.currentFrame = nullptr;
+
+    if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+    {
+        allocator.alignment = std::max(allocator.alignment, properties.limits.minUniformBufferOffsetAlignment);
+        allocator.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        GS_ASSERT(descriptorRange <= properties.limits.maxUniformBufferRange);
+    }
+
+    if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+    {
+        allocator.alignment = std::max(allocator.alignment, properties.limits.minStorageBufferOffsetAlignment);
+        allocator.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    }
+
+    if (descriptorSetLayout)
+    {
+        VkDescriptorPoolSize poolSize{ allocator.descriptorType, frameCount * kMaxPagesPerFrame };
+        VkDescriptorPoolCreateInfo createInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+        createInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+        createInfo.maxSets = frameCount * kMaxPagesPerFrame;
+        createInfo.poolSizeCount = 1;
+        createInfo.pPoolSizes = &poolSize;
+        VK_CHECK_RESULT(vkCreateDescriptorPool(device, &createInfo, nullptr, &allocator.descriptorPool));
+    }
+
+    allocator.frames.resize(frameCount);
+
+    for (FrameAllocator::FramePages& frame : allocator.frames)
+    {
+        frame.pages.push_back(createPage(allocator, pageSize));
+        frame.offset = 0;
+    }
+}
+
+void destroyFrameAllocator(FrameAllocator& allocator)
+{
+    for (FrameAllocator::FramePages& frame : allocator.frames)
+    {
+        for (FrameAllocator::Page& page : frame.pages)
+        {
+            destroyPage(allocator, page);
+        }
+    }
+
+    allocator.frames.clear();
+    allocator.currentFrame = nullptr;
+
+    if (allocator.descriptorPool)
+    {
+        vkDestroyDescriptorPool(allocator.device, allocator.descriptorPool, nullptr);
+    }
+}
+
+void beginFrameAllocator(FrameAllocator& allocator, uint32_t frameIndex)
+{
+    FrameAllocator::FramePages& frame = allocator.frames[frameIndex];
+
+    if (frame.pages.size() > 1)
+    {
+        // The frame's fence has signalled, so none of its pages are in use. Replace them with one page that fits the whole frame.
+        VkDeviceSize size = 0;
+
+        for (FrameAllocator::Page& page : frame.pages)
+        {
+            size += page.buffer.size;
+            destroyPage(allocator, page);
+        }
+
+        frame.pages.clear();
+        frame.pages.push_back(createPage(allocator, size));
+        GS_INFO("Frame allocator grew to %llu bytes per frame.", (unsigned long long)size);
+    }
+
+    frame.offset = 0;
+    allocator.currentFrame = &frame;
+}
+
+FrameAllocation allocateFrameData(FrameAllocator& allocator, VkDeviceSize size)
+{
+    FrameAllocator::FramePages* frame = allocator.currentFrame;
+    GS_ASSERT(frame);
+
+    if (allocator.descriptorSetLayout)
+    {
+        size = std::max(size, allocator.descriptorRange);
+    }
+
+    VkDeviceSize offset = (frame->offset + allocator.alignment - 1) & ~(allocator.alignment - 1);
+
+    if (offset + size > frame->pages.back().buffer.size)
+    {
+        GS_ASSERT(frame->pages.size() < kMaxPagesPerFrame);
+        VkDeviceSize pageSize = std::max(frame->pages.back().buffer.size * 2, size);
+        frame->pages.push_back(createPage(allocator, pageSize));
+        offset = 0;
+    }
+
+    FrameAllocator::Page& page = frame->pages.back();
+    GS_ASSERT(offset + size <= UINT32_MAX);
+    frame->offset = offset + size;
+
+    FrameAllocation allocation{};
+    allocation.buffer = page.buffer.buffer;
+    allocation.descriptorSet = page.descriptorSet;
+    allocation.offset = uint32_t(offset);
+    allocation.data = (uint8_t*)page.buffer.mappedMemory + offset;
+    return allocation;
+}
+
+} // namespace Vulkan
+} // namespace GameSmith
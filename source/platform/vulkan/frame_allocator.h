@@ -0,0 +1,77 @@
+#pragma once
+
+#include "gsvulkan.h"
+
+#include "buffer.h"
+
+namespace gs
+{
+namespace vk
+{
+
+struct FrameAllocation
+{
+    VkBuffer buffer;
+    VkDescriptorSet descriptorSet; // Binds buffer at binding 0, VK_NULL_HANDLE without a descriptor set layout
+    uint32_t offset;               // Dynamic offset of the allocation within buffer
+    void* data;
+};
+
+// Linear allocator for data the CPU writes once per frame, such as per-pass and per-object constants. Every frame in flight owns
+// persistently mapped pages that are rewound when the frame slot comes round again, and allocations are aligned to be bound with
+// dynamic offsets. A frame that runs out of space gets an extra page of at least twice the size; the next time the slot is rewound its
+// pages are replaced by a single page large enough for all of them, so a steady workload settles on one page per frame and makes no
+// allocations. When a descriptor set layout is given, every page gets a descriptor set binding it at binding 0, written once when the
+// page is created.
+struct FrameAllocator
+{
+    struct Page
+    {
+        Buffer buffer;
+        VkDescriptorSet descriptorSet;
+    };
+
+    struct FramePages
+    {
+        std::vector<Page> pages;
+        VkDeviceSize offset; // Into the last page
+    };
+
+    VkPhysicalDevice physicalDevice;
+    VkDevice device;
+    uint32_t queueFamilyIndex;
+    VkBufferUsageFlags usage;
+    VkDeviceSize alignment;
+
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkDescriptorType descriptorType;
+    VkDeviceSize descriptorRange;
+    VkDescriptorPool descriptorPool;
+
+    std::vector<FramePages> frames;
+    FramePages* currentFrame;
+};
+
+// usage must include uniform or storage buffer usage, which selects the offset alignment and the dynamic descriptor type, storage if both
+// are given. descriptorRange is the size the descriptors expose to shaders; every allocation reserves at least that much so its range
+// stays within the page.
+void createFrameAllocator(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount, VkDeviceSize pageSize,
+                          VkBufferUsageFlags usage, VkDescriptorSetLayout descriptorSetLayout, VkDeviceSize descriptorRange,
+                          FrameAllocator& allocator);
+void destroyFrameAllocator(FrameAllocator& allocator);
+
+// Rewinds the frame slot's pages, merging them if the frame outgrew them. Call once the frame's fence has been waited on.
+void beginFrameAllocator(FrameAllocator& allocator, uint32_t frameIndex);
+
+// The returned memory is valid until the frame slot is rewound. Not thread safe.
+FrameAllocation allocateFrameData(FrameAllocator& allocator, VkDeviceSize size);
+
+template <typename T>
+T* allocateFrameData(FrameAllocator& allocator, FrameAllocation& allocation)
+{
+    allocation = allocateFrameData(allocator, sizeof(T));
+    return new (allocation.data) T{};
+}
+
+} // namespace Vulkan
+} // namespace GameSmith
@@ -0,0 +1,501 @@
+#include "gspch.h"
+
+#include "gpu_culling.h"
+
+#include "deletion_queue.h"
+#include "gpu_scene.h"
+
+#include "gamesmith/core/debug.h"
+#include "gamesmith/core/log.h"
+#include "gamesmith/math/mat44.h"
+
+namespace gs
+{
+namespace vk
+{
+
+// A 16K depth buffer reduces to 15 levels
+static const uint32_t kMaxPyramidLevels = 16;
+
+// Objects are culled one per workgroup; larger scenes spill into the second dispatch dimension
+static const uint32_t kMaxWorkGroupsX = 65535;
+
+// Matches the CullData block of cull.comp.glsl, std140 layout
+struct CullData
+{
+    float view[16];
+    float frustumPlanes[6][4]; // View space, pointing inwards
+    float projection[4];       // P00, P11, P22, P32
+    float pyramidSize[2];
+    uint32_t objectCount;
+    uint32_t maxDraws;
+    uint32_t frustumCulling;
+    uint32_t occlusionCulling;
+    uint32_t meshletCulling;
+    uint32_t pad;
+};
+
+// Matches the push constants of depth_pyramid.comp.glsl
+struct PyramidConstants
+{
+    uint32_t inputSize[2];
+    uint32_t outputSize[2];
+};
+
+static VkPipeline createComputePipeline(VkDevice device, VkPipelineCache pipelineCache, VkPipelineLayout layout, const ShaderModule& shader)
+{
+    VkComputePipelineCreateInfo createInfo{ VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+    createInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    createInfo.stage.stage = shader.stage;
+    createInfo.stage.module = shader.shader;
+    createInfo.stage.pName = shader.entryPoint.c_str();
+    createInfo.layout = layout;
+
+    VkPipeline pipeline{};
+    VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &createInfo, nullptr, &pipeline));
+    return pipeline;
+}
+
+static VkDescriptorSet allocateDescriptorSet(VkDevice device, VkDescriptorPool descriptorPool, VkDescriptorSetLayout setLayout)
+{
+    VkDescriptorSetAllocateInfo allocateInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+    allocateInfo.descriptorPool = descriptorPool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &setLayout;
+
+    VkDescriptorSet descriptorSet{};
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocateInfo, &descriptorSet));
+    return descriptorSet;
+}
+
+static VkBufferMemoryBarrier bufferBarrier(VkBuffer buffer, VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+{
+    VkBufferMemoryBarrier barrier{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buffer;
+    barrier.size = VK_WHOLE_SIZE;
+    return barrier;
+}
+
+static uint32_t previousPowerOfTwo(uint32_t value)
+{
+    uint32_t result = 1;
+
+    while (result * 2 <= value)
+    {
+        result *= 2;
+    }
+
+    return result;
+}
+
+static VkImageView createPyramidView(VkDevice device, VkImage image, uint32_t baseLevel, uint32_t levelCount)
+{
+    VkImageViewCreateInfo createInfo{ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+    createInfo.image = image;
+    createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    createInfo.format = VK_FORMAT_R32_SFLOAT;
+    createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    createInfo.subresourceRange.baseMipLevel = baseLevel;
+    createInfo.subresourceRange.levelCount = levelCount;
+    createInfo.subresourceRange.layerCount = 1;
+
+    VkImageView view{};
+    VK_CHECK_RESULT(vkCreateImageView(device, &createInfo, nullptr, &view));
+    return view;
+}
+
+static void createDepthPyramid(GpuCulling& culling, VkExtent2D depthExtent)
+{
+    culling.depthExtent = depthExtent;
+    culling.pyramidExtent = { previousPowerOfTwo(depthExtent.width), previousPowerOfTwo(depthExtent.height) };
+
+    uint32_t levelCount = 1;
+
+    while ((std::max(culling.pyramidExtent.width, culling.pyramidExtent.height) >> levelCount) > 0)
+    {
+        ++levelCount;
+    }
+
+    GS_ASSERT(levelCount <= kMaxPyramidLevels);
+
+    VkImageCreateInfo createInfo{ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    createInfo.imageType = VK_IMAGE_TYPE_2D;
+    createInfo.format = VK_FORMAT_R32_SFLOAT;
+    createInfo.extent = { culling.pyramidExtent.width, culling.pyramidExtent.height, 1 };
+    createInfo.mipLevels = levelCount;
+    createInfo.arrayLayers = 1;
+    createInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    createInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VK_CHECK_RESULT(vkCreateImage(culling.device, &createInfo, nullptr, &culling.pyramidImage));
+
+    VkMemoryRequirements requirements{};
+    vkGetImageMemoryRequirements(culling.device, culling.pyramidImage, &requirements);
+
+    VkMemoryAllocateInfo allocateInfo{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    allocateInfo.allocationSize = requirements.size;
+    allocateInfo.memoryTypeIndex = getMemoryTypeIndex(culling.physicalDevice, requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    GS_ASSERT(allocateInfo.memoryTypeIndex != UINT32_MAX);
+    VK_CHECK_RESULT(vkAllocateMemory(culling.device, &allocateInfo, nullptr, &culling.pyramidMemory));
+    VK_CHECK_RESULT(vkBindImageMemory(culling.device, culling.pyramidImage, culling.pyramidMemory, 0));
+
+    // The culling pass samples every level through one view; the pyramid pass writes and reads one level at a time
+    culling.pyramidView = createPyramidView(culling.device, culling.pyramidImage, 0, levelCount);
+
+    for (uint32_t level = 0; level < levelCount; ++level)
+    {
+        culling.pyramidLevelViews.push_back(createPyramidView(culling.device, culling.pyramidImage, level, 1));
+    }
+
+    culling.pyramidLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    culling.pyramidValid = false;
+    culling.pyramidWritten = false;
+}
+
+static void releaseDepthPyramid(GpuCulling& culling)
+{
+    for (VkImageView view : culling.pyramidLevelViews)
+    {
+        deferDestroy(*culling.deletionQueue, view);
+    }
+
+    deferDestroy(*culling.deletionQueue, culling.pyramidView);
+    deferDestroy(*culling.deletionQueue, culling.pyramidImage);
+    deferDestroy(*culling.deletionQueue, culling.pyramidMemory);
+
+    culling.pyramidLevelViews.clear();
+    culling.pyramidView = VK_NULL_HANDLE;
+    culling.pyramidImage = VK_NULL_HANDLE;
+    culling.pyramidMemory = VK_NULL_HANDLE;
+    culling.depthExtent = {};
+}
+
+void createGpuCulling(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, DeletionQueue& deletionQueue,
+                      PipelineLayoutCache& layoutCache, VkPipelineCache pipelineCache, uint32_t framesInFlight, uint32_t maxDraws,
+                      GpuCulling& culling)
+{
+    culling.physicalDevice = physicalDevice;
+    culling.device = device;
+    culling.deletionQueue = &deletionQueue;
+    culling.maxDraws = maxDraws;
+    culling.settings = { true, true, true };
+    culling.currentFrame = nullptr;
+    culling.visibleDrawCount = 0;
+
+    // createDevice enables these whenever they are supported
+    VkPhysicalDeviceVulkan12Features vulkan12Features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+    VkPhysicalDeviceFeatures2 features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+    features.pNext = &vulkan12Features;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+    culling.supported =
+            vulkan12Features.drawIndirectCount && features.features.multiDrawIndirect && features.features.drawIndirectFirstInstance;
+
+    if (!culling.supported)
+    {
+        GS_WARN("Indirect draw counts are not supported, GPU culling is disabled.");
+    }
+
+    culling.cullShader = loadShaderModule(device, "cull.comp.spv");
+    culling.pyramidShader = loadShaderModule(device, "depth_pyramid.comp.spv");
+    GS_ASSERT(culling.cullShader.shader && culling.pyramidShader.shader);
+    culling.cullPipelineLayout = &getPipelineLayout(layoutCache, { culling.cullShader });
+    culling.pyramidPipelineLayout = &getPipelineLayout(layoutCache, { culling.pyramidShader });
+    culling.cullPipeline = createComputePipeline(device, pipelineCache, culling.cullPipelineLayout->layout, culling.cullShader);
+    culling.pyramidPipeline = createComputePipeline(device, pipelineCache, culling.pyramidPipelineLayout->layout, culling.pyramidShader);
+
+    // Only read with texelFetch
+    VkSamplerCreateInfo samplerCreateInfo{ VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+    samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+    samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+    samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+    VK_CHECK_RESULT(vkCreateSampler(device, &samplerCreateInfo, nullptr, &culling.pyramidSampler));
+
+    VkDescriptorPoolSize poolSizes[] = { { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+                                         { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 },
+                                         { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 + kMaxPyramidLevels },
+                                         { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, kMaxPyramidLevels } };
+    VkDescriptorPoolCreateInfo poolCreateInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+    poolCreateInfo.maxSets = 1 + kMaxPyramidLevels;
+    poolCreateInfo.poolSizeCount = GS_ARRAY_COUNT(poolSizes);
+    poolCreateInfo.pPoolSizes = poolSizes;
+
+    VkMemoryPropertyFlags hostMemory = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    culling.frames.resize(framesInFlight);
+
+    for (GpuCulling::FrameResources& frame : culling.frames)
+    {
+        frame.dataBuffer = createBuffer(physicalDevice, device, sizeof(CullData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostMemory,
+                                        { queueFamilyIndex });
+        frame.drawBuffer = createBuffer(physicalDevice, device, VkDeviceSize(maxDraws) * sizeof(VkDrawIndexedIndirectCommand),
+                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, { queueFamilyIndex });
+        frame.countBuffer = createBuffer(physicalDevice, device, sizeof(uint32_t),
+                                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, { queueFamilyIndex });
+        frame.statsBuffer = createBuffer(physicalDevice, device, sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                         hostMemory, { queueFamilyIndex });
+        GS_ASSERT(frame.dataBuffer.buffer && frame.drawBuffer.buffer && frame.countBuffer.buffer && frame.statsBuffer.buffer);
+        VK_CHECK_RESULT(vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &frame.descriptorPool));
+        frame.cullSet = VK_NULL_HANDLE;
+        frame.culled = false;
+    }
+}
+
+void destroyGpuCulling(GpuCulling& culling)
+{
+    for (GpuCulling::FrameResources& frame : culling.frames)
+    {
+        destroyBuffer(culling.device, frame.dataBuffer);
+        destroyBuffer(culling.device, frame.drawBuffer);
+        destroyBuffer(culling.device, frame.countBuffer);
+        destroyBuffer(culling.device, frame.statsBuffer);
+        vkDestroyDescriptorPool(culling.device, frame.descriptorPool, nullptr);
+    }
+
+    // The deletion queue outlives the culling and destroys everything it still holds at shutdown
+    releaseDepthPyramid(culling);
+
+    vkDestroySampler(culling.device, culling.pyramidSampler, nullptr);
+    vkDestroyPipeline(culling.device, culling.cullPipeline, nullptr);
+    vkDestroyPipeline(culling.device, culling.pyramidPipeline, nullptr);
+    vkDestroyShaderModule(culling.device, culling.cullShader.shader, nullptr);
+    vkDestroyShaderModule(culling.device, culling.pyramidShader.shader, nullptr);
+
+    culling.frames.clear();
+    culling.currentFrame = nullptr;
+}
+
+void beginGpuCullingFrame(GpuCulling& culling, uint32_t frameIndex, VkExtent2D depthExtent)
+{
+    GpuCulling::FrameResources& frame = culling.frames[frameIndex];
+
+    if (frame.culled)
+    {
+        // Made visible to the host by the culling pass's barrier and the frame's fence
+        culling.visibleDrawCount = *(const uint32_t*)frame.statsBuffer.mappedMemory;
+    }
+
+    frame.culled = false;
+    frame.cullSet = VK_NULL_HANDLE;
+    VK_CHECK_RESULT(vkResetDescriptorPool(culling.device, frame.descriptorPool, 0));
+    culling.currentFrame = &frame;
+
+    culling.pyramidValid = culling.pyramidWritten;
+    culling.pyramidWritten = false;
+
+    if (memcmp(&culling.depthExtent, &depthExtent, sizeof(VkExtent2D)) != 0)
+    {
+        releaseDepthPyramid(culling);
+        createDepthPyramid(culling, depthExtent);
+    }
+}
+
+void setGpuCullingView(GpuCulling& culling, const GpuScene& scene, const mat44& proj, const mat44& view)
+{
+    GS_ASSERT(culling.currentFrame && scene.currentFrame);
+    GpuCulling::FrameResources& frame = *culling.currentFrame;
+
+    CullData data{};
+    memcpy(data.view, &view, sizeof(data.view));
+
+    // Planes of the clip volume from the rows of the projection, in view space. Vulkan clips z to [0, w], so the near plane is row 2
+    // alone rather than row 3 + row 2.
+    auto row = [&](int r) { return Vec4(proj[0][r], proj[1][r], proj[2][r], proj[3][r]); };
+    Vec4 planes[6] = { row(3) + row(0), row(3) - row(0), row(3) + row(1), row(3) - row(1), row(2), row(3) - row(2) };
+
+    for (int p = 0; p < 6; ++p)
+    {
+        float length = sqrtf(planes[p].x * planes[p].x + planes[p].y * planes[p].y + planes[p].z * planes[p].z);
+
+        for (int i = 0; i < 4; ++i)
+        {
+            data.frustumPlanes[p][i] = planes[p][i] / length;
+        }
+    }
+
+    data.projection[0] = proj[0][0];
+    data.projection[1] = proj[1][1];
+    data.projection[2] = proj[2][2];
+    data.projection[3] = proj[3][2];
+    data.pyramidSize[0] = float(culling.pyramidExtent.width);
+    data.pyramidSize[1] = float(culling.pyramidExtent.height);
+    data.objectCount = uint32_t(scene.objects.size());
+    data.maxDraws = culling.maxDraws;
+    data.frustumCulling = culling.settings.frustumCulling;
+
+    // Projecting spheres onto the pyramid assumes a perspective projection
+    bool perspective = proj[3][3] == 0.f;
+    data.occlusionCulling = culling.settings.occlusionCulling && culling.pyramidValid && perspective;
+    data.meshletCulling = culling.settings.meshletCulling;
+    memcpy(frame.dataBuffer.mappedMemory, &data, sizeof(data));
+
+    frame.cullSet = allocateDescriptorSet(culling.device, frame.descriptorPool, culling.cullPipelineLayout->setLayouts[0]);
+
+    VkDescriptorBufferInfo bufferInfos[] = { { frame.dataBuffer.buffer, 0, VK_WHOLE_SIZE },
+                                             { scene.currentFrame->objectBuffer.buffer, 0, VK_WHOLE_SIZE },
+                                             { scene.meshBuffer.buffer, 0, VK_WHOLE_SIZE },
+                                             { scene.meshletBuffer.buffer, 0, VK_WHOLE_SIZE },
+                                             { frame.drawBuffer.buffer, 0, VK_WHOLE_SIZE },
+                                             { frame.countBuffer.buffer, 0, VK_WHOLE_SIZE } };
+    VkDescriptorImageInfo pyramidInfo{ culling.pyramidSampler, culling.pyramidView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+    VkWriteDescriptorSet writes[GS_ARRAY_COUNT(bufferInfos) + 1]{};
+
+    for (uint32_t b = 0; b < GS_ARRAY_COUNT(writes); ++b)
+    {
+        writes[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[b].dstSet = frame.cullSet;
+        writes[b].dstBinding = b;
+        writes[b].descriptorCount = 1;
+
+        if (b == 0)
+        {
+            writes[b].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            writes[b].pBufferInfo = &bufferInfos[b];
+        }
+        else if (b < GS_ARRAY_COUNT(bufferInfos))
+        {
+            writes[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[b].pBufferInfo = &bufferInfos[b];
+        }
+        else
+        {
+            writes[b].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writes[b].pImageInfo = &pyramidInfo;
+        }
+    }
+
+    vkUpdateDescriptorSets(culling.device, GS_ARRAY_COUNT(writes), writes, 0, nullptr);
+}
+
+RenderGraphResource importDepthPyramid(GpuCulling& culling, RenderGraph& graph)
+{
+    // The previous frame's pyramid pass last wrote the pyramid in the compute stage; its own barrier made the writes available
+    return importRenderGraphImage(graph, "Depth pyramid", culling.pyramidImage, culling.pyramidView, VK_FORMAT_R32_SFLOAT,
+                                  culling.pyramidExtent, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, culling.pyramidLayout,
+                                  VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+}
+
+void recordGpuCulling(GpuCulling& culling, const GpuScene& scene, VkCommandBuffer commandBuffer)
+{
+    GpuCulling::FrameResources& frame = *culling.currentFrame;
+    GS_ASSERT(frame.cullSet);
+    frame.culled = true;
+
+    vkCmdFillBuffer(commandBuffer, frame.countBuffer.buffer, 0, sizeof(uint32_t), 0);
+    VkBufferMemoryBarrier fillBarrier =
+            bufferBarrier(frame.countBuffer.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &fillBarrier,
+                         0, nullptr);
+
+    uint32_t objectCount = uint32_t(scene.objects.size());
+
+    if (objectCount)
+    {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling.cullPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling.cullPipelineLayout->layout, 0, 1, &frame.cullSet, 0,
+                                nullptr);
+
+        uint32_t groupCountX = std::min(objectCount, kMaxWorkGroupsX);
+        vkCmdDispatch(commandBuffer, groupCountX, (objectCount + groupCountX - 1) / groupCountX, 1);
+    }
+
+    VkBufferMemoryBarrier drawBarriers[] = {
+        bufferBarrier(frame.drawBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
+        bufferBarrier(frame.countBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT)
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, GS_ARRAY_COUNT(drawBarriers), drawBarriers, 0, nullptr);
+
+    // The count is read back frames later, once the frame's fence has signalled
+    VkBufferCopy copyRegion{ 0, 0, sizeof(uint32_t) };
+    vkCmdCopyBuffer(commandBuffer, frame.countBuffer.buffer, frame.statsBuffer.buffer, 1, &copyRegion);
+    VkBufferMemoryBarrier hostBarrier = bufferBarrier(frame.statsBuffer.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &hostBarrier, 0, nullptr);
+}
+
+void recordDepthPyramid(GpuCulling& culling, VkCommandBuffer commandBuffer, VkImageView depthView)
+{
+    GpuCulling::FrameResources& frame = *culling.currentFrame;
+    const PipelineLayout& pipelineLayout = *culling.pyramidPipelineLayout;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling.pyramidPipeline);
+
+    VkExtent2D inputExtent = culling.depthExtent;
+
+    for (uint32_t level = 0; level < uint32_t(culling.pyramidLevelViews.size()); ++level)
+    {
+        VkExtent2D outputExtent = { std::max(culling.pyramidExtent.width >> level, 1u), std::max(culling.pyramidExtent.height >> level, 1u) };
+
+        // Level 0 reduces the depth buffer, every other level the level above it
+        VkDescriptorImageInfo inputInfo{ culling.pyramidSampler, depthView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+        if (level > 0)
+        {
+            inputInfo = { culling.pyramidSampler, culling.pyramidLevelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL };
+        }
+
+        VkDescriptorImageInfo outputInfo{ VK_NULL_HANDLE, culling.pyramidLevelViews[level], VK_IMAGE_LAYOUT_GENERAL };
+        VkDescriptorSet descriptorSet = allocateDescriptorSet(culling.device, frame.descriptorPool, pipelineLayout.setLayouts[0]);
+
+        VkWriteDescriptorSet writes[2]{};
+        writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[0].dstSet = descriptorSet;
+        writes[0].dstBinding = 0;
+        writes[0].descriptorCount = 1;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[0].pImageInfo = &inputInfo;
+        writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[1].dstSet = descriptorSet;
+        writes[1].dstBinding = 1;
+        writes[1].descriptorCount = 1;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[1].pImageInfo = &outputInfo;
+        vkUpdateDescriptorSets(culling.device, GS_ARRAY_COUNT(writes), writes, 0, nullptr);
+
+        PyramidConstants constants{ { inputExtent.width, inputExtent.height }, { outputExtent.width, outputExtent.height } };
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout.layout, 0, 1, &descriptorSet, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, pipelineLayout.layout, pipelineLayout.pushConstantRange.stageFlags, 0, sizeof(constants), &constants);
+        vkCmdDispatch(commandBuffer, (outputExtent.width + 7) / 8, (outputExtent.height + 7) / 8, 1);
+
+        // The next level reads this one. After the last level this makes the pyramid available to the next frame's culling pass.
+        VkImageMemoryBarrier barrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = culling.pyramidImage;
+        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr,
+                             1, &barrier);
+
+        inputExtent = outputExtent;
+    }
+
+    culling.pyramidLayout = VK_IMAGE_LAYOUT_GENERAL;
+    culling.pyramidWritten = true;
+}
+
+void recordGpuCulledDraws(const GpuCulling& culling, const GpuScene& scene, VkCommandBuffer commandBuffer, const PipelineLayout& pipelineLayout)
+{
+    const GpuCulling::FrameResources& frame = *culling.currentFrame;
+    bindGpuScene(scene, commandBuffer);
+    pushGpuDrawConstants(commandBuffer, pipelineLayout, { 0, 0, 1.f, 0 });
+    vkCmdDrawIndexedIndirectCount(commandBuffer, frame.drawBuffer.buffer, 0, frame.countBuffer.buffer, 0, culling.maxDraws,
+                                  sizeof(VkDrawIndexedIndirectCommand));
+}
+
+} // namespace Vulkan
+} // namespace GameSmith
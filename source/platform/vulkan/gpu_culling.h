@@ -0,0 +1,107 @@
+#pragma once
+
+#include "gsvulkan.h"
+
+#include "buffer.h"
+#include "pipeline_layout.h"
+#include "render_graph.h"
+#include "shader_module.h"
+
+namespace gs
+{
+
+struct mat44;
+
+namespace vk
+{
+
+struct DeletionQueue;
+struct GpuScene;
+
+struct GpuCullingSettings
+{
+    bool frustumCulling;
+    bool occlusionCulling;
+    bool meshletCulling; // Visible objects are drawn as their visible meshlets rather than whole
+};
+
+// Culls the scene's objects, and the meshlets of the objects that survive, with a compute pass and writes the visible ones as compacted
+// indexed indirect draws plus a draw count, so the main pass only pays for visible geometry and the CPU never touches visibility.
+// Bounding spheres are tested against the view frustum and against a hierarchical depth pyramid (Hi-Z) reduced from the previous
+// frame's depth buffer; each pyramid texel holds the farthest depth of the texels it covers, so a sphere is occluded when its nearest
+// point lies behind the pyramid depth at the level where its screen footprint spans at most two texels. The pyramid is reused with the
+// current frame's camera, so geometry revealed by fast camera motion can appear a frame late.
+struct GpuCulling
+{
+    struct FrameResources
+    {
+        Buffer dataBuffer;  // Culling constants
+        Buffer drawBuffer;  // Compacted VkDrawIndexedIndirectCommand, device local
+        Buffer countBuffer; // Draw count written by the culling shader, device local
+        Buffer statsBuffer; // Host visible copy of the draw count
+        VkDescriptorPool descriptorPool; // Reset every frame
+        VkDescriptorSet cullSet;
+        bool culled; // The culling pass was recorded for this frame, so statsBuffer is meaningful
+    };
+
+    VkPhysicalDevice physicalDevice;
+    VkDevice device;
+    DeletionQueue* deletionQueue;
+    bool supported; // Needs vkCmdDrawIndexedIndirectCount and multi-draw indirect
+    uint32_t maxDraws;
+    GpuCullingSettings settings;
+
+    ShaderModule cullShader;
+    ShaderModule pyramidShader;
+    const PipelineLayout* cullPipelineLayout;
+    const PipelineLayout* pyramidPipelineLayout;
+    VkPipeline cullPipeline;
+    VkPipeline pyramidPipeline;
+    VkSampler pyramidSampler;
+
+    // Depth pyramid: R32_SFLOAT with the power of two extent at or below the depth buffer's, with a full mip chain
+    VkImage pyramidImage;
+    VkDeviceMemory pyramidMemory;
+    VkImageView pyramidView;
+    std::vector<VkImageView> pyramidLevelViews;
+    VkExtent2D pyramidExtent;
+    VkExtent2D depthExtent;
+    VkImageLayout pyramidLayout; // Layout the last recorded frame left the pyramid in
+    bool pyramidValid;           // Holds the previous frame's depth
+    bool pyramidWritten;         // Rebuilt during the current frame
+
+    std::vector<FrameResources> frames;
+    FrameResources* currentFrame;
+    uint32_t visibleDrawCount; // Read back from the last completed frame that was culled
+};
+
+// Loads the culling shaders from cull.comp.spv and depth_pyramid.comp.spv. The scene's buffers must be usable on the graphics queue.
+void createGpuCulling(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, DeletionQueue& deletionQueue,
+                      PipelineLayoutCache& layoutCache, VkPipelineCache pipelineCache, uint32_t framesInFlight, uint32_t maxDraws,
+                      GpuCulling& culling);
+void destroyGpuCulling(GpuCulling& culling);
+
+// Call once the frame's fence has been waited on. Reads back the frame's visible draw count and recreates the depth pyramid when the
+// depth buffer's extent has changed; the replaced pyramid is released to the deletion queue.
+void beginGpuCullingFrame(GpuCulling& culling, uint32_t frameIndex, VkExtent2D depthExtent);
+
+// Writes the frame's culling constants and descriptors for the scene's current objects. Call after buildGpuSceneDraws.
+void setGpuCullingView(GpuCulling& culling, const GpuScene& scene, const mat44& proj, const mat44& view);
+
+// The pyramid must be read by the culling pass (RenderGraphAccess::ComputeShaderRead) and written by the pyramid pass
+// (RenderGraphAccess::ComputeShaderWrite), after the pass that writes the depth buffer. Frames that skip either pass leave the
+// pyramid without valid depth, which turns occlusion culling off for the next frame.
+RenderGraphResource importDepthPyramid(GpuCulling& culling, RenderGraph& graph);
+
+// Culling pass: resets the draw count, culls every object of the scene and makes the draws visible to indirect drawing.
+void recordGpuCulling(GpuCulling& culling, const GpuScene& scene, VkCommandBuffer commandBuffer);
+
+// Pyramid pass: reduces depthView, read as RenderGraphAccess::ComputeShaderRead, into every level of the pyramid.
+void recordDepthPyramid(GpuCulling& culling, VkCommandBuffer commandBuffer, VkImageView depthView);
+
+// Binds the scene and draws the culled draws in a graphics pass after the culling pass. The draws reach their objects through
+// firstInstance, so the draw constants are pushed once.
+void recordGpuCulledDraws(const GpuCulling& culling, const GpuScene& scene, VkCommandBuffer commandBuffer, const PipelineLayout& pipelineLayout);
+
+} // namespace Vulkan
+} // namespace GameSmith
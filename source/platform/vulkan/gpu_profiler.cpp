@@ -0,0 +1,287 @@
+#include "gspch.h"
+
+#include "gpu_profiler.h"
+
+#include "gamesmith/core/debug.h"
+#include "gamesmith/core/log.h"
+
+#include <cstdio>
+
+namespace gs
+{
+namespace vk
+{
+
+static void resolveFrame(GpuProfiler& profiler, GpuProfiler::FrameQueries& frame)
+{
+    if (frame.queryCount == 0)
+    {
+        return;
+    }
+
+    // Pairs of (timestamp, availability)
+    std::vector<uint64_t> results(frame.queryCount * 2);
+    VkResult result = vkGetQueryPoolResults(profiler.device, frame.queryPool, 0, frame.queryCount, results.size() * sizeof(uint64_t),
+                                            results.data(), 2 * sizeof(uint64_t),
+                                            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+    if (result != VK_SUCCESS && result != VK_NOT_READY)
+    {
+        VK_CHECK_RESULT(result);
+        return;
+    }
+
+    GpuProfiler::ResolvedFrame resolved{};
+    resolved.frameNumber = frame.frameNumber;
+
+    for (const GpuProfiler::Scope& scope : frame.scopes)
+    {
+        if (scope.endQuery == ~0u)
+        {
+            continue;
+        }
+
+        const uint64_t* begin = &results[scope.beginQuery * 2];
+        const uint64_t* end = &results[scope.endQuery * 2];
+
+        if (!begin[1] || !end[1])
+        {
+            continue;
+        }
+
+        uint64_t ticks = (end[0] - begin[0]) & profiler.timestampMask;
+        float milliseconds = float(double(ticks) * profiler.timestampPeriod * 1e-6);
+
+        auto average = profiler.averages.find(scope.name);
+
+        if (average == profiler.averages.end())
+        {
+            average = profiler.averages.emplace(scope.name, milliseconds).first;
+        }
+        else
+        {
+            average->second += (milliseconds - average->second) * 0.05f;
+        }
+
+        resolved.scopes.push_back({ scope.name, scope.depth, milliseconds, average->second });
+    }
+
+    profiler.latest = resolved.scopes;
+    profiler.history.push_back(std::move(resolved));
+
+    while (profiler.history.size() > profiler.maxHistory)
+    {
+        profiler.history.pop_front();
+    }
+}
+
+void createGpuProfiler(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount, uint32_t maxScopes,
+                       GpuProfiler& profiler)
+{
+    profiler.device = device;
+    profiler.maxQueries = maxScopes * 2;
+    profiler.maxHistory = 1024;
+    profiler.frameNumber = 0;
+    profiler.currentFrame = nullptr;
+
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    profiler.timestampPeriod = properties.limits.timestampPeriod;
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+    uint32_t validBits = queueFamilies[queueFamilyIndex].timestampValidBits;
+    profiler.supported = validBits != 0 && properties.limits.timestampPeriod > 0.f;
+    profiler.timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+
+    if (!profiler.supported)
+    {
+        GS_WARN("Queue family %u does not support timestamps, GPU profiling is disabled.", queueFamilyIndex);
+        return;
+    }
+
+    profiler.frames.resize(frameCount);
+
+    for (GpuProfiler::FrameQueries& frame : profiler.frames)
+    {
+        VkQueryPoolCreateInfo createInfo{ VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+        createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        createInfo.queryCount = profiler.maxQueries;
+        VK_CHECK_RESULT(vkCreateQueryPool(device, &createInfo, nullptr, &frame.queryPool));
+        frame.queryCount = 0;
+    }
+}
+
+void destroyGpuProfiler(GpuProfiler& profiler)
+{
+    for (GpuProfiler::FrameQueries& frame : profiler.frames)
+    {
+        vkDestroyQueryPool(profiler.device, frame.queryPool, nullptr);
+    }
+
+    profiler.frames.clear();
+    profiler.currentFrame = nullptr;
+}
+
+void beginGpuProfilerFrame(GpuProfiler& profiler, VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+    GS_ASSERT(profiler.scopeStack.empty());
+
+    if (!profiler.supported)
+    {
+        return;
+    }
+
+    GpuProfiler::FrameQueries& frame = profiler.frames[frameIndex];
+    resolveFrame(profiler, frame);
+
+    vkCmdResetQueryPool(commandBuffer, frame.queryPool, 0, profiler.maxQueries);
+    frame.scopes.clear();
+    frame.queryCount = 0;
+    frame.frameNumber = profiler.frameNumber++;
+    profiler.currentFrame = &frame;
+}
+
+void beginGpuScope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const char* name)
+{
+    if (!profiler.currentFrame)
+    {
+        return;
+    }
+
+    GpuProfiler::FrameQueries& frame = *profiler.currentFrame;
+    uint32_t scopeIndex = uint32_t(frame.scopes.size());
+    profiler.scopeStack.push_back(scopeIndex);
+
+    if (frame.queryCount + 2 > profiler.maxQueries)
+    {
+        // Out of queries; keep the stack balanced but don't record anything
+        profiler.scopeStack.back() = ~0u;
+        return;
+    }
+
+    frame.scopes.push_back({ name, uint32_t(profiler.scopeStack.size() - 1), frame.queryCount++, ~0u });
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.queryPool, frame.scopes.back().beginQuery);
+}
+
+void endGpuScope(GpuProfiler& profiler, VkCommandBuffer commandBuffer)
+{
+    if (!profiler.currentFrame)
+    {
+        return;
+    }
+
+    GS_ASSERT(!profiler.scopeStack.empty());
+    uint32_t scopeIndex = profiler.scopeStack.back();
+    profiler.scopeStack.pop_back();
+
+    if (scopeIndex == ~0u)
+    {
+        return;
+    }
+
+    GpuProfiler::FrameQueries& frame = *profiler.currentFrame;
+    GpuProfiler::Scope& scope = frame.scopes[scopeIndex];
+    scope.endQuery = frame.queryCount++;
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.queryPool, scope.endQuery);
+}
+
+// Scope names are free text, so they are quoted when they would break a CSV row
+static std::string escapeCsv(const std::string& text)
+{
+    if (text.find_first_of(",\"\r\n") == std::string::npos)
+    {
+        return text;
+    }
+
+    std::string escaped = "\"";
+
+    for (char c : text)
+    {
+        escaped += c == '"' ? "\"\"" : std::string(1, c);
+    }
+
+    return escaped + "\"";
+}
+
+static std::string escapeJson(const std::string& text)
+{
+    std::string escaped;
+
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if ((unsigned char)c < 0x20)
+        {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        }
+        else
+        {
+            escaped += c;
+        }
+    }
+
+    return escaped;
+}
+
+bool writeGpuProfilerHistory(const GpuProfiler& profiler, const std::string& path)
+{
+    std::ofstream fs(path, std::ios::out | std::ios::trunc);
+
+    if (!fs)
+    {
+        GS_ERROR("Failed to open '%s' for writing.", path.c_str());
+        return false;
+    }
+
+    bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+
+    if (json)
+    {
+        fs << "{\n  \"timestampPeriodNs\": " << profiler.timestampPeriod << ",\n  \"frames\": [";
+
+        for (size_t i = 0; i < profiler.history.size(); ++i)
+        {
+            const GpuProfiler::ResolvedFrame& frame = profiler.history[i];
+            fs << (i ? ",\n" : "\n") << "    { \"frame\": " << frame.frameNumber << ", \"scopes\": [";
+
+            for (size_t j = 0; j < frame.scopes.size(); ++j)
+            {
+                const GpuScopeTiming& scope = frame.scopes[j];
+                fs << (j ? ", " : " ") << "{ \"name\": \"" << escapeJson(scope.name) << "\", \"depth\": " << scope.depth
+                   << ", \"ms\": " << scope.milliseconds << " }";
+            }
+
+            fs << " ] }";
+        }
+
+        fs << "\n  ]\n}\n";
+    }
+    else
+    {
+        fs << "frame,scope,depth,ms\n";
+
+        for (const GpuProfiler::ResolvedFrame& frame : profiler.history)
+        {
+            for (const GpuScopeTiming& scope : frame.scopes)
+            {
+                fs << frame.frameNumber << "," << escapeCsv(scope.name) << "," << scope.depth << "," << scope.milliseconds << "\n";
+            }
+        }
+    }
+
+    GS_INFO("Wrote %zu frames of GPU timings to '%s'.", profiler.history.size(), path.c_str());
+    return bool(fs);
+}
+
+} // namespace Vulkan
+} // namespace GameSmith
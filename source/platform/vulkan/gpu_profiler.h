@@ -0,0 +1,80 @@
+#pragma once
+
+#include "gsvulkan.h"
+
+#include <deque>
+
+namespace gs
+{
+namespace vk
+{
+
+struct GpuScopeTiming
+{
+    std::string name;
+    uint32_t depth;
+    float milliseconds;
+    float averageMilliseconds;
+};
+
+// Times named scopes of GPU work with timestamp queries. Each frame in flight owns a query pool; the results for a frame are read back
+// when that frame comes round again, by which time its fence has signalled, so reading never stalls. Timings are therefore reported
+// framesInFlight frames late.
+struct GpuProfiler
+{
+    struct Scope
+    {
+        std::string name;
+        uint32_t depth;
+        uint32_t beginQuery;
+        uint32_t endQuery;
+    };
+
+    struct FrameQueries
+    {
+        VkQueryPool queryPool;
+        std::vector<Scope> scopes;
+        uint32_t queryCount;
+        uint64_t frameNumber;
+    };
+
+    struct ResolvedFrame
+    {
+        uint64_t frameNumber;
+        std::vector<GpuScopeTiming> scopes;
+    };
+
+    VkDevice device;
+    bool supported;
+    float timestampPeriod; // Nanoseconds per tick
+    uint64_t timestampMask;
+    uint32_t maxQueries;
+
+    std::vector<FrameQueries> frames;
+    FrameQueries* currentFrame;
+    uint64_t frameNumber;
+    std::vector<uint32_t> scopeStack; // Indices into currentFrame->scopes
+
+    std::vector<GpuScopeTiming> latest;
+    std::unordered_map<std::string, float> averages;
+    std::deque<ResolvedFrame> history;
+    size_t maxHistory;
+};
+
+void createGpuProfiler(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount, uint32_t maxScopes,
+                       GpuProfiler& profiler);
+void destroyGpuProfiler(GpuProfiler& profiler);
+
+// Collects the results of the last submission of this frame slot and resets its queries. Call once the frame's fence has been waited
+// on, at the start of the frame's command buffer and outside of a render pass.
+void beginGpuProfilerFrame(GpuProfiler& profiler, VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+// Scopes nest. They must be recorded into the primary command buffer outside of render passes whose contents are secondary buffers.
+void beginGpuScope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const char* name);
+void endGpuScope(GpuProfiler& profiler, VkCommandBuffer commandBuffer);
+
+// Writes the retained history as CSV, or as JSON if path ends in ".json".
+bool writeGpuProfilerHistory(const GpuProfiler& profiler, const std::string& path);
+
+} // namespace Vulkan
+} // namespace GameSmith
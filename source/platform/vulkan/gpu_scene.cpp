@@ -0,0 +1,363 @@
+#include "gspch.h"
+
+#include "gpu_scene.h"
+
+#include "upload_manager.h"
+
+#include "gamesmith/core/debug.h"
+#include "gamesmith/core/log.h"
+#include "gamesmith/math/mat44.h"
+
+#include <numeric>
+
+namespace gs
+{
+namespace vk
+{
+
+// Bounds the vertices referenced by indices, or the first count vertices when indices is null
+static void computeBoundingSphere(const void* vertices, uint32_t vertexStride, const uint32_t* indices, uint32_t count, float sphere[4])
+{
+    float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+    auto getPosition = [&](uint32_t i) { return (const float*)((const uint8_t*)vertices + (indices ? indices[i] : i) * vertexStride); };
+
+    for (uint32_t v = 0; v < count; ++v)
+    {
+        const float* position = getPosition(v);
+
+        for (int i = 0; i < 3; ++i)
+        {
+            minimum[i] = std::min(minimum[i], position[i]);
+            maximum[i] = std::max(maximum[i], position[i]);
+        }
+    }
+
+    float radiusSq = 0.f;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        sphere[i] = count ? (minimum[i] + maximum[i]) * 0.5f : 0.f;
+    }
+
+    for (uint32_t v = 0; v < count; ++v)
+    {
+        const float* position = getPosition(v);
+        float dx = position[0] - sphere[0];
+        float dy = position[1] - sphere[1];
+        float dz = position[2] - sphere[2];
+        radiusSq = std::max(radiusSq, dx * dx + dy * dy + dz * dz);
+    }
+
+    sphere[3] = sqrtf(radiusSq);
+}
+
+void createGpuScene(VkPhysicalDevice physicalDevice, VkDevice device, QueueFamilyIndices queueFamilies, uint32_t framesInFlight,
+                    const GpuSceneLimits& limits, BindlessHeap& bindlessHeap, GpuScene& scene)
+{
+    scene.device = device;
+    scene.bindlessHeap = &bindlessHeap;
+    scene.limits = limits;
+    scene.vertexCount = 0;
+    scene.indexCount = 0;
+    scene.meshletCount = 0;
+    scene.currentFrame = nullptr;
+    scene.instancing = true;
+    scene.perDrawData = GpuScenePerDrawData::FirstInstance;
+
+    // createDevice enables these whenever they are supported
+    VkPhysicalDeviceFeatures features{};
+    vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+    scene.indirectDraws = features.multiDrawIndirect && features.drawIndirectFirstInstance;
+
+    if (!scene.indirectDraws)
+    {
+        GS_WARN("Multi-draw indirect is not supported, the scene is drawn with one draw call per object.");
+    }
+
+    scene.vertexBuffer = createBuffer(physicalDevice, device, VkDeviceSize(limits.maxVertices) * limits.vertexStride,
+                                      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                      queueFamilies);
+    scene.indexBuffer = createBuffer(physicalDevice, device, VkDeviceSize(limits.maxIndices) * sizeof(uint32_t),
+                                     VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                     queueFamilies);
+    scene.meshBuffer = createBuffer(physicalDevice, device, VkDeviceSize(limits.maxMeshes) * sizeof(GpuMeshRecord),
+                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                    queueFamilies);
+    scene.meshletBuffer = createBuffer(physicalDevice, device, VkDeviceSize(limits.maxMeshlets) * sizeof(GpuMeshlet),
+                                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                       queueFamilies);
+    GS_ASSERT(scene.vertexBuffer.buffer && scene.indexBuffer.buffer && scene.meshBuffer.buffer && scene.meshletBuffer.buffer);
+
+    scene.frames.resize(framesInFlight);
+
+    for (GpuScene::FrameBuffers& frame : scene.frames)
+    {
+        VkMemoryPropertyFlags hostMemory = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        frame.objectBuffer = createBuffer(physicalDevice, device, limits.maxObjects * sizeof(GpuObject), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                          hostMemory, queueFamilies);
+        frame.drawBuffer = createBuffer(physicalDevice, device, limits.maxObjects * sizeof(VkDrawIndexedIndirectCommand),
+                                        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, hostMemory, queueFamilies);
+        frame.objectBufferHandle = registerStorageBuffer(bindlessHeap, frame.objectBuffer.buffer);
+        GS_ASSERT(frame.objectBufferHandle != kInvalidBindlessHandle);
+    }
+}
+
+void destroyGpuScene(GpuScene& scene)
+{
+    for (GpuScene::FrameBuffers& frame : scene.frames)
+    {
+        releaseBindlessHandle(*scene.bindlessHeap, kBindlessStorageBuffers, frame.objectBufferHandle);
+        destroyBuffer(scene.device, frame.objectBuffer);
+        destroyBuffer(scene.device, frame.drawBuffer);
+    }
+
+    destroyBuffer(scene.device, scene.vertexBuffer);
+    destroyBuffer(scene.device, scene.indexBuffer);
+    destroyBuffer(scene.device, scene.meshBuffer);
+    destroyBuffer(scene.device, scene.meshletBuffer);
+
+    scene.frames.clear();
+    scene.meshes.clear();
+    scene.currentFrame = nullptr;
+}
+
+uint32_t addGpuMesh(GpuScene& scene, UploadManager& uploadManager, const void* vertices, uint32_t vertexCount, const uint32_t* indices,
+                    uint32_t indexCount)
+{
+    GpuMesh mesh{};
+    mesh.vertexCount = vertexCount;
+    mesh.indexCount = indexCount;
+    mesh.meshletCount = (indexCount / 3 + kGpuMeshletTriangleCount - 1) / kGpuMeshletTriangleCount;
+    computeBoundingSphere(vertices, scene.limits.vertexStride, nullptr, vertexCount, mesh.boundingSphere);
+
+    uint32_t meshIndex{};
+
+    {
+        std::lock_guard<std::mutex> lock(scene.mutex);
+
+        if (scene.vertexCount + vertexCount > scene.limits.maxVertices || scene.indexCount + indexCount > scene.limits.maxIndices ||
+            scene.meshes.size() >= scene.limits.maxMeshes || scene.meshletCount + mesh.meshletCount > scene.limits.maxMeshlets)
+        {
+            GS_ERROR("Scene geometry buffers are full, can't add a mesh with %u vertices and %u indices.", vertexCount, indexCount);
+            return ~0u;
+        }
+
+        // Space is reserved under the lock; the uploads themselves may run concurrently
+        mesh.vertexOffset = int32_t(scene.vertexCount);
+        mesh.firstIndex = scene.indexCount;
+        mesh.firstMeshlet = scene.meshletCount;
+        scene.vertexCount += vertexCount;
+        scene.indexCount += indexCount;
+        scene.meshletCount += mesh.meshletCount;
+        meshIndex = uint32_t(scene.meshes.size());
+        scene.meshes.push_back(mesh);
+    }
+
+    std::vector<GpuMeshlet> meshlets(mesh.meshletCount);
+
+    for (uint32_t m = 0; m < mesh.meshletCount; ++m)
+    {
+        uint32_t firstIndex = m * kGpuMeshletTriangleCount * 3;
+        GpuMeshlet& meshlet = meshlets[m];
+        meshlet.firstIndex = mesh.firstIndex + firstIndex;
+        meshlet.indexCount = std::min(kGpuMeshletTriangleCount * 3, indexCount / 3 * 3 - firstIndex);
+        computeBoundingSphere(vertices, scene.limits.vertexStride, indices + firstIndex, meshlet.indexCount, meshlet.boundingSphere);
+    }
+
+    GpuMeshRecord record{};
+    memcpy(record.boundingSphere, mesh.boundingSphere, sizeof(record.boundingSphere));
+    record.firstIndex = mesh.firstIndex;
+    record.indexCount = mesh.indexCount;
+    record.vertexOffset = mesh.vertexOffset;
+    record.firstMeshlet = mesh.firstMeshlet;
+    record.meshletCount = mesh.meshletCount;
+
+    // Uploads complete in submission order, so the last one queued covers them all
+    VkDeviceSize vertexStride = scene.limits.vertexStride;
+    uploadBuffer(uploadManager, scene.vertexBuffer.buffer, mesh.vertexOffset * vertexStride, vertices, vertexCount * vertexStride);
+    uploadBuffer(uploadManager, scene.indexBuffer.buffer, mesh.firstIndex * sizeof(uint32_t), indices, indexCount * sizeof(uint32_t));
+
+    if (!meshlets.empty())
+    {
+        uploadBuffer(uploadManager, scene.meshletBuffer.buffer, mesh.firstMeshlet * sizeof(GpuMeshlet), meshlets.data(),
+                     meshlets.size() * sizeof(GpuMeshlet));
+    }
+
+    uint64_t uploadTimelineValue =
+            uploadBuffer(uploadManager, scene.meshBuffer.buffer, meshIndex * sizeof(GpuMeshRecord), &record, sizeof(GpuMeshRecord));
+
+    std::lock_guard<std::mutex> lock(scene.mutex);
+    scene.meshes[meshIndex].uploadTimelineValue = uploadTimelineValue;
+    return meshIndex;
+}
+
+GpuMesh getGpuMesh(GpuScene& scene, uint32_t meshIndex)
+{
+    std::lock_guard<std::mutex> lock(scene.mutex);
+    GS_ASSERT(meshIndex < scene.meshes.size());
+    return scene.meshes[meshIndex];
+}
+
+void beginGpuSceneFrame(GpuScene& scene, uint32_t frameIndex)
+{
+    scene.currentFrame = &scene.frames[frameIndex];
+    scene.objects.clear();
+    scene.objectKeys.clear();
+    scene.drawCommands.clear();
+    scene.drawConstants.clear();
+    scene.batches.clear();
+    scene.droppedObjects = 0;
+}
+
+bool addGpuObject(GpuScene& scene, uint32_t meshIndex, const mat44& transform, uint32_t pipelineKey)
+{
+    // The frame's object and draw buffers hold maxObjects entries
+    if (scene.objects.size() >= scene.limits.maxObjects)
+    {
+        if (scene.droppedObjects++ == 0)
+        {
+            GS_ERROR("Scene object buffers are full, objects beyond %u are not drawn this frame.", scene.limits.maxObjects);
+        }
+
+        return false;
+    }
+
+    GpuObject object{};
+    memcpy(object.transform, &transform, sizeof(object.transform));
+    object.meshIndex = meshIndex;
+    scene.objects.push_back(object);
+    scene.objectKeys.push_back(uint64_t(pipelineKey) << 32 | meshIndex);
+    return true;
+}
+
+void buildGpuSceneDraws(GpuScene& scene)
+{
+    GS_ASSERT(scene.currentFrame);
+    std::lock_guard<std::mutex> lock(scene.mutex);
+
+    // Sorting keeps pipeline changes to one per pipeline and makes the objects of each instanced draw consecutive. The sort is stable so
+    // instances keep their declaration order.
+    uint32_t objectCount = uint32_t(scene.objects.size());
+    scene.objectOrder.resize(objectCount);
+    std::iota(scene.objectOrder.begin(), scene.objectOrder.end(), 0u);
+    std::stable_sort(scene.objectOrder.begin(), scene.objectOrder.end(),
+                     [&](uint32_t lhs, uint32_t rhs) { return scene.objectKeys[lhs] < scene.objectKeys[rhs]; });
+
+    GpuScene::FrameBuffers& frame = *scene.currentFrame;
+    GpuObject* objects = (GpuObject*)frame.objectBuffer.mappedMemory;
+
+    for (uint32_t o = 0; o < objectCount; ++o)
+    {
+        objects[o] = scene.objects[scene.objectOrder[o]];
+    }
+
+    for (uint32_t firstObject = 0; firstObject < objectCount;)
+    {
+        uint64_t key = scene.objectKeys[scene.objectOrder[firstObject]];
+        uint32_t instanceCount = 1;
+
+        while (scene.instancing && firstObject + instanceCount < objectCount &&
+               scene.objectKeys[scene.objectOrder[firstObject + instanceCount]] == key)
+        {
+            ++instanceCount;
+        }
+
+        uint32_t pipelineKey = uint32_t(key >> 32);
+
+        if (scene.batches.empty() || scene.batches.back().pipelineKey != pipelineKey)
+        {
+            scene.batches.push_back({ pipelineKey, uint32_t(scene.drawCommands.size()), 0 });
+        }
+
+        const GpuMesh& mesh = scene.meshes[uint32_t(key)];
+        scene.drawCommands.push_back({ mesh.indexCount, instanceCount, mesh.firstIndex, mesh.vertexOffset, firstObject });
+        scene.drawConstants.push_back({ firstObject, pipelineKey, 1.f, 0 });
+        ++scene.batches.back().drawCount;
+        firstObject += instanceCount;
+    }
+
+    if (scene.indirectDraws)
+    {
+        memcpy(frame.drawBuffer.mappedMemory, scene.drawCommands.data(), scene.drawCommands.size() * sizeof(VkDrawIndexedIndirectCommand));
+    }
+}
+
+BindlessHandle getGpuSceneObjectBuffer(const GpuScene& scene)
+{
+    GS_ASSERT(scene.currentFrame);
+    return scene.currentFrame->objectBufferHandle;
+}
+
+void bindGpuScene(const GpuScene& scene, VkCommandBuffer commandBuffer)
+{
+    VkDeviceSize vertexBufferOffset{};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &scene.vertexBuffer.buffer, &vertexBufferOffset);
+    vkCmdBindIndexBuffer(commandBuffer, scene.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+void pushGpuDrawConstants(VkCommandBuffer commandBuffer, const PipelineLayout& pipelineLayout, const GpuDrawConstants& constants)
+{
+    GS_ASSERT(pipelineLayout.pushConstantRange.size >= sizeof(GpuDrawConstants));
+    vkCmdPushConstants(commandBuffer, pipelineLayout.layout, pipelineLayout.pushConstantRange.stageFlags, 0, sizeof(GpuDrawConstants),
+                       &constants);
+}
+
+void recordGpuSceneDraws(const GpuScene& scene, VkCommandBuffer commandBuffer, const PipelineLayout& pipelineLayout, uint32_t firstDraw,
+                         uint32_t drawCount, const FrameAllocation* drawUniforms)
+{
+    GS_ASSERT(firstDraw + drawCount <= scene.drawCommands.size());
+
+    if (drawCount == 0)
+    {
+        return;
+    }
+
+    const GpuScene::FrameBuffers& frame = *scene.currentFrame;
+    bindGpuScene(scene, commandBuffer);
+
+    if (scene.perDrawData != GpuScenePerDrawData::FirstInstance)
+    {
+        // Each draw starts its instances at 0 and finds its objects through its constants instead
+        GS_ASSERT(scene.perDrawData == GpuScenePerDrawData::PushConstants || drawUniforms);
+
+        for (uint32_t d = firstDraw; d < firstDraw + drawCount; ++d)
+        {
+            const VkDrawIndexedIndirectCommand& draw = scene.drawCommands[d];
+
+            if (scene.perDrawData == GpuScenePerDrawData::PushConstants)
+            {
+                pushGpuDrawConstants(commandBuffer, pipelineLayout, scene.drawConstants[d]);
+            }
+            else
+            {
+                const FrameAllocation& allocation = drawUniforms[d - firstDraw];
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout.layout, 0, 1,
+                                        &allocation.descriptorSet, 1, &allocation.offset);
+            }
+
+            vkCmdDrawIndexed(commandBuffer, draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, 0);
+        }
+
+        return;
+    }
+
+    pushGpuDrawConstants(commandBuffer, pipelineLayout, { 0, 0, 1.f, 0 });
+
+    if (scene.indirectDraws)
+    {
+        vkCmdDrawIndexedIndirect(commandBuffer, frame.drawBuffer.buffer, firstDraw * sizeof(VkDrawIndexedIndirectCommand), drawCount,
+                                 sizeof(VkDrawIndexedIndirectCommand));
+        return;
+    }
+
+    for (uint32_t d = firstDraw; d < firstDraw + drawCount; ++d)
+    {
+        const VkDrawIndexedIndirectCommand& draw = scene.drawCommands[d];
+        vkCmdDrawIndexed(commandBuffer, draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+    }
+}
+
+} // namespace Vulkan
+} // namespace GameSmith
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "gsvulkan.h"
+
+#include "bindless_heap.h"
+#include "buffer.h"
+#include "frame_allocator.h"
+#include "pipeline_layout.h"
+
+#include <mutex>
+
+namespace gs
+{
+
+struct mat44;
+
+namespace vk
+{
+
+struct UploadManager;
+
+// Meshes are split into meshlets of this many consecutive triangles, which GPU culling can test and draw on their own
+static constexpr uint32_t kGpuMeshletTriangleCount = 64;
+
+struct GpuMesh
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t vertexOffset;
+    uint32_t vertexCount;
+    uint32_t firstMeshlet;
+    uint32_t meshletCount;
+    float boundingSphere[4]; // Object space center and radius
+    uint64_t uploadTimelineValue;
+};
+
+// Matches the Mesh struct of the culling shader, std430 layout
+struct GpuMeshRecord
+{
+    float boundingSphere[4];
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t vertexOffset;
+    uint32_t firstMeshlet;
+    uint32_t meshletCount;
+    uint32_t pad[3];
+};
+
+// Matches the Meshlet struct of the culling shader, std430 layout
+struct GpuMeshlet
+{
+    float boundingSphere[4]; // Object space
+    uint32_t firstIndex;     // Into the scene's index buffer
+    uint32_t indexCount;
+    uint32_t pad[2];
+};
+
+// Matches the Object struct of the scene shaders, std430 layout
+struct GpuObject
+{
+    float transform[16]; // Column-major object to world
+    uint32_t meshIndex;
+    uint32_t pad[3];
+};
+
+// Matches the DrawConstants block of the scene shaders, std140 layout so it can also be embedded in a uniform buffer
+struct alignas(16) GpuDrawConstants
+{
+    uint32_t firstObject;   // Added to gl_InstanceIndex
+    uint32_t materialIndex; // The draw's pipeline key until the scene has materials
+    float lodFade;
+    uint32_t pad;
+};
+
+// Where draws take their per-draw constants from
+enum class GpuScenePerDrawData
+{
+    FirstInstance,   // Objects are reached through firstInstance and the constants are pushed once, so draws can be indirect
+    PushConstants,   // One vkCmdDrawIndexed per draw after vkCmdPushConstants
+    DynamicUniforms, // One vkCmdDrawIndexed per draw after rebinding set 0 with the draw's dynamic offset
+};
+
+// A run of consecutive draw commands using the same pipeline
+struct GpuSceneBatch
+{
+    uint32_t pipelineKey;
+    uint32_t firstDraw;
+    uint32_t drawCount;
+};
+
+struct GpuSceneLimits
+{
+    uint32_t vertexStride;
+    uint32_t maxVertices;
+    uint32_t maxIndices;
+    uint32_t maxMeshes;
+    uint32_t maxMeshlets;
+    uint32_t maxObjects; // Per frame
+};
+
+// Geometry and per-object data for GPU driven drawing. All meshes share one vertex and one index buffer, and the objects declared each
+// frame are written to a storage buffer along with indexed indirect draws, so the whole scene is drawn with a single
+// vkCmdDrawIndexedIndirect per pipeline however many objects it has. Objects are sorted by pipeline and mesh, and with instancing each
+// run of objects sharing both becomes one instanced draw whose firstInstance is the run's first object; the vertex shader fetches its
+// object through gl_InstanceIndex. Devices without multi-draw indirect or non-zero firstInstance in indirect draws fall back to one
+// vkCmdDrawIndexed per draw from the same commands. Mesh records and meshlet bounds are kept in storage buffers for GPU culling.
+struct GpuScene
+{
+    struct FrameBuffers
+    {
+        Buffer objectBuffer; // GpuObject per object
+        Buffer drawBuffer;   // VkDrawIndexedIndirectCommand per object
+        BindlessHandle objectBufferHandle;
+    };
+
+    VkDevice device;
+    BindlessHeap* bindlessHeap;
+    GpuSceneLimits limits;
+    bool indirectDraws;
+
+    Buffer vertexBuffer;
+    Buffer indexBuffer;
+    Buffer meshBuffer;    // GpuMeshRecord per mesh
+    Buffer meshletBuffer; // GpuMeshlet per meshlet
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t meshletCount;
+    std::vector<GpuMesh> meshes;
+    std::mutex mutex; // Meshes may be added from loading threads
+
+    std::vector<FrameBuffers> frames;
+    FrameBuffers* currentFrame;
+    bool instancing;                                        // Merge objects sharing a pipeline and mesh into one draw
+    GpuScenePerDrawData perDrawData;
+    std::vector<GpuObject> objects;                         // Declared this frame, in declaration order
+    uint32_t droppedObjects;                                // Declared this frame past maxObjects
+    std::vector<uint64_t> objectKeys;                       // Pipeline key and mesh index of each object
+    std::vector<uint32_t> objectOrder;                      // Declaration indices in draw order
+    std::vector<VkDrawIndexedIndirectCommand> drawCommands; // Built from objects
+    std::vector<GpuDrawConstants> drawConstants;            // One per draw command
+    std::vector<GpuSceneBatch> batches;                     // Draw commands grouped by pipeline
+};
+
+// The object buffers are registered in bindlessHeap, which must outlive the scene. Buffers are used by queueFamilies, normally only the
+// graphics family: geometry uploaded on another family is handed over by the upload manager's ownership transfers, which require the
+// exclusive sharing of a single family.
+void createGpuScene(VkPhysicalDevice physicalDevice, VkDevice device, QueueFamilyIndices queueFamilies, uint32_t framesInFlight,
+                    const GpuSceneLimits& limits, BindlessHeap& bindlessHeap, GpuScene& scene);
+void destroyGpuScene(GpuScene& scene);
+
+// Appends a mesh to the shared buffers and queues its upload; safe to call from any thread. Vertices start with their object space
+// position as three floats. Returns the mesh index, or ~0u if the buffers are full. The mesh must not be drawn before its upload has
+// completed and been acquired with acquireUploads().
+uint32_t addGpuMesh(GpuScene& scene, UploadManager& uploadManager, const void* vertices, uint32_t vertexCount, const uint32_t* indices,
+                    uint32_t indexCount);
+GpuMesh getGpuMesh(GpuScene& scene, uint32_t meshIndex);
+
+// Starts declaring the objects of a frame. Call once the frame's fence has been waited on.
+void beginGpuSceneFrame(GpuScene& scene, uint32_t frameIndex);
+
+// pipelineKey identifies the pipeline the caller draws the object with; objects with different keys are never instanced together.
+// Returns false, and drops the object, once the frame already holds limits.maxObjects objects.
+bool addGpuObject(GpuScene& scene, uint32_t meshIndex, const mat44& transform, uint32_t pipelineKey = 0);
+
+// Sorts the frame's objects into draw order, writes them and builds the draw commands and batches. Callers drawing with several
+// pipelines bind each batch's pipeline and draw its range of commands.
+void buildGpuSceneDraws(GpuScene& scene);
+
+// Bindless handle of the current frame's object buffer, for the shaders' per-frame constants
+BindlessHandle getGpuSceneObjectBuffer(const GpuScene& scene);
+
+// Binds the shared geometry. Shaders fetch the frame's objects through the bindless heap, which the caller binds.
+void bindGpuScene(const GpuScene& scene, VkCommandBuffer commandBuffer);
+
+// Pushes constants shared by all the draws that follow, for pipelines whose shaders declare the DrawConstants push constant block
+void pushGpuDrawConstants(VkCommandBuffer commandBuffer, const PipelineLayout& pipelineLayout, const GpuDrawConstants& constants);
+
+// Binds the scene and draws the given range of the frame's draw commands, passing their constants as scene.perDrawData selects. With
+// GpuScenePerDrawData::DynamicUniforms, drawUniforms holds an allocation per draw of the range, each holding the draw's set 0 uniforms
+// with its constants, which are bound with their descriptor set and offset.
+void recordGpuSceneDraws(const GpuScene& scene, VkCommandBuffer commandBuffer, const PipelineLayout& pipelineLayout, uint32_t firstDraw,
+                         uint32_t drawCount, const FrameAllocation* drawUniforms = nullptr);
+
+} // namespace Vulkan
+} // namespace GameSmith
@@ -13,6 +13,11 @@
 #define GS_VULKAN_VALIDATION 0
 #endif
 
+// Default number of frames the CPU may record ahead of the GPU
+#ifndef GS_VULKAN_FRAMES_IN_FLIGHT
+#define GS_VULKAN_FRAMES_IN_FLIGHT 2
+#endif
+
 #define VK_CHECK_RESULT(call)        \
     do                               \
     {                                \
@@ -0,0 +1,125 @@
+#include "gspch.h"
+
+#include "pipeline_cache.h"
+
+#include "gamesmith/core/debug.h"
+#include "gamesmith/core/log.h"
+
+namespace gs
+{
+namespace vk
+{
+
+// Layout of VK_PIPELINE_CACHE_HEADER_VERSION_ONE, which every implementation writes at the start of the cache data
+struct PipelineCacheHeader
+{
+    uint32_t headerSize;
+    uint32_t headerVersion;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+};
+
+static bool validatePipelineCacheData(VkPhysicalDevice physicalDevice, const std::vector<uint8_t>& data)
+{
+    if (data.size() < sizeof(PipelineCacheHeader))
+    {
+        return false;
+    }
+
+    PipelineCacheHeader header{};
+    memcpy(&header, data.data(), sizeof(header));
+
+    VkPhysicalDeviceProperties props{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &props);
+
+    return header.headerSize >= sizeof(PipelineCacheHeader) && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == props.vendorID && header.deviceID == props.deviceID &&
+           memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+VkPipelineCache loadPipelineCache(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& path)
+{
+    std::vector<uint8_t> data;
+    std::error_code ec;
+
+    if (std::filesystem::exists(path, ec))
+    {
+        std::ifstream fs(path, std::ios::in | std::ios::binary);
+        auto fileSize = std::filesystem::file_size(path, ec);
+
+        if (fs && !ec)
+        {
+            data.resize(size_t(fileSize));
+            fs.read((char*)data.data(), fileSize);
+
+            if (!fs || !validatePipelineCacheData(physicalDevice, data))
+            {
+                GS_WARN("Discarding pipeline cache '%s', it was created by a different device or driver.", path.c_str());
+                data.clear();
+            }
+        }
+    }
+
+    VkPipelineCacheCreateInfo createInfo{ VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+    createInfo.initialDataSize = data.size();
+    createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+    VkPipelineCache pipelineCache{};
+    VK_CHECK_RESULT(vkCreatePipelineCache(device, &createInfo, nullptr, &pipelineCache));
+
+    GS_INFO("Loaded pipeline cache '%s' (%zu bytes).", path.c_str(), data.size());
+    return pipelineCache;
+}
+
+bool savePipelineCache(VkDevice device, VkPipelineCache pipelineCache, const std::string& path)
+{
+    size_t dataSize{};
+    VK_CHECK_RESULT(vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr));
+    std::vector<uint8_t> data(dataSize);
+    VK_CHECK_RESULT(vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()));
+
+    std::string tempPath = path + ".tmp";
+
+    {
+        std::ofstream fs(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        fs.write((const char*)data.data(), dataSize);
+
+        if (!fs)
+        {
+            GS_ERROR("Failed to write pipeline cache '%s'.", tempPath.c_str());
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, path, ec);
+
+    if (ec)
+    {
+        GS_ERROR("Failed to replace pipeline cache '%s': %s", path.c_str(), ec.message().c_str());
+        return false;
+    }
+
+    GS_INFO("Saved pipeline cache '%s' (%zu bytes).", path.c_str(), dataSize);
+    return true;
+}
+
+VkPipelineCache createPipelineCache(VkDevice device)
+{
+    VkPipelineCacheCreateInfo createInfo{ VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+    VkPipelineCache pipelineCache{};
+    VK_CHECK_RESULT(vkCreatePipelineCache(device, &createInfo, nullptr, &pipelineCache));
+    return pipelineCache;
+}
+
+void mergePipelineCaches(VkDevice device, VkPipelineCache dstCache, const std::vector<VkPipelineCache>& srcCaches)
+{
+    if (!srcCaches.empty())
+    {
+        VK_CHECK_RESULT(vkMergePipelineCaches(device, dstCache, uint32_t(srcCaches.size()), srcCaches.data()));
+    }
+}
+
+} // namespace Vulkan
+} // namespace GameSmith
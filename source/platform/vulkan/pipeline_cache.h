@@ -0,0 +1,22 @@
+#pragma once
+
+#include "gsvulkan.h"
+
+namespace gs
+{
+namespace vk
+{
+
+// Creates a pipeline cache seeded with the data saved at path. The saved data is discarded if its header was written by a different
+// vendor, device or driver (pipelineCacheUUID), in which case an empty cache is returned.
+VkPipelineCache loadPipelineCache(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& path);
+
+// Writes the cache contents to path. The data is written to a temporary file first so a crash can't leave a truncated cache behind.
+bool savePipelineCache(VkDevice device, VkPipelineCache pipelineCache, const std::string& path);
+
+// Worker threads compile into their own empty caches to avoid contending on the shared one; merge them back before saving.
+VkPipelineCache createPipelineCache(VkDevice device);
+void mergePipelineCaches(VkDevice device, VkPipelineCache dstCache, const std::vector<VkPipelineCache>& srcCaches);
+
+} // namespace Vulkan
+} // namespace GameSmith
@@ -0,0 +1,182 @@
+#include "gspch.h"
+
+#include "pipeline_layout.h"
+
+#include "gamesmith/core/debug.h"
+
+namespace gs
+{
+namespace vk
+{
+
+static VkDescriptorSetLayout getDescriptorSetLayout(PipelineLayoutCache& cache, const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+{
+    std::vector<uint64_t> key;
+    key.reserve(bindings.size() * 4);
+
+    for (const VkDescriptorSetLayoutBinding& binding : bindings)
+    {
+        key.push_back(binding.binding);
+        key.push_back(binding.descriptorType);
+        key.push_back(binding.descriptorCount);
+        key.push_back(binding.stageFlags);
+    }
+
+    auto it = cache.setLayouts.find(key);
+
+    if (it != cache.setLayouts.end())
+    {
+        return it->second;
+    }
+
+    VkDescriptorSetLayoutCreateInfo createInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+    createInfo.bindingCount = uint32_t(bindings.size());
+    createInfo.pBindings = bindings.data();
+
+    VkDescriptorSetLayout setLayout{};
+    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(cache.device, &createInfo, nullptr, &setLayout));
+    cache.setLayouts.emplace(std::move(key), setLayout);
+    return setLayout;
+}
+
+void createPipelineLayoutCache(VkDevice device, PipelineLayoutCache& cache)
+{
+    cache.device = device;
+}
+
+void destroyPipelineLayoutCache(PipelineLayoutCache& cache)
+{
+    for (auto& entry : cache.pipelineLayouts)
+    {
+        vkDestroyPipelineLayout(cache.device, entry.second.layout, nullptr);
+    }
+
+    for (auto& entry : cache.setLayouts)
+    {
+        vkDestroyDescriptorSetLayout(cache.device, entry.second, nullptr);
+    }
+
+    cache.pipelineLayouts.clear();
+    cache.setLayouts.clear();
+    cache.reservedSets.clear();
+}
+
+void reservePipelineLayoutSet(PipelineLayoutCache& cache, uint32_t set, VkDescriptorSetLayout setLayout)
+{
+    GS_ASSERT(cache.pipelineLayouts.empty());
+    cache.reservedSets[set] = setLayout;
+}
+
+const PipelineLayout& getPipelineLayout(PipelineLayoutCache& cache, uint32_t shaderCount, const ShaderModule* shaders,
+                                        bool dynamicUniformBuffers)
+{
+    // Merge the bindings of every stage; a binding used by several stages must agree on its type
+    std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets;
+    VkPushConstantRange pushConstantRange{};
+
+    for (uint32_t s = 0; s < shaderCount; ++s)
+    {
+        const ShaderModule& shader = shaders[s];
+
+        for (const ShaderBinding& shaderBinding : shader.bindings)
+        {
+            VkDescriptorType descriptorType = shaderBinding.descriptorType;
+
+            if (dynamicUniformBuffers && descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+            {
+                descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            }
+
+            if (sets.size() <= shaderBinding.set)
+            {
+                sets.resize(shaderBinding.set + 1);
+            }
+
+            if (cache.reservedSets.count(shaderBinding.set))
+            {
+                continue;
+            }
+
+            std::vector<VkDescriptorSetLayoutBinding>& bindings = sets[shaderBinding.set];
+            auto it = std::find_if(bindings.begin(), bindings.end(),
+                                   [&](const VkDescriptorSetLayoutBinding& binding) { return binding.binding == shaderBinding.binding; });
+
+            if (it != bindings.end())
+            {
+                GS_ASSERT(it->descriptorType == descriptorType && it->descriptorCount == shaderBinding.descriptorCount);
+                it->stageFlags |= shader.stage;
+            }
+            else
+            {
+                bindings.push_back({ shaderBinding.binding, descriptorType, shaderBinding.descriptorCount, VkShaderStageFlags(shader.stage),
+                                     nullptr });
+            }
+        }
+
+        if (shader.pushConstantSize)
+        {
+            pushConstantRange.stageFlags |= shader.stage;
+            pushConstantRange.size = std::max(pushConstantRange.size, shader.pushConstantSize);
+        }
+    }
+
+    PipelineLayout pipelineLayout{};
+    pipelineLayout.pushConstantRange = pushConstantRange;
+    std::vector<uint64_t> key;
+
+    for (uint32_t set = 0; set < sets.size(); ++set)
+    {
+        std::vector<VkDescriptorSetLayoutBinding>& bindings = sets[set];
+        std::sort(bindings.begin(), bindings.end(),
+                  [](const VkDescriptorSetLayoutBinding& lhs, const VkDescriptorSetLayoutBinding& rhs) { return lhs.binding < rhs.binding; });
+
+        auto reserved = cache.reservedSets.find(set);
+        VkDescriptorSetLayout setLayout = reserved != cache.reservedSets.end() ? reserved->second : getDescriptorSetLayout(cache, bindings);
+        pipelineLayout.setLayouts.push_back(setLayout);
+        key.push_back(uint64_t(setLayout));
+    }
+
+    key.push_back(pushConstantRange.stageFlags);
+    key.push_back(pushConstantRange.size);
+
+    auto it = cache.pipelineLayouts.find(key);
+
+    if (it != cache.pipelineLayouts.end())
+    {
+        return it->second;
+    }
+
+    VkPipelineLayoutCreateInfo createInfo{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+    createInfo.setLayoutCount = uint32_t(pipelineLayout.setLayouts.size());
+    createInfo.pSetLayouts = pipelineLayout.setLayouts.data();
+    createInfo.pushConstantRangeCount = pushConstantRange.size ? 1 : 0;
+    createInfo.pPushConstantRanges = &pipelineLayout.pushConstantRange;
+    VK_CHECK_RESULT(vkCreatePipelineLayout(cache.device, &createInfo, nullptr, &pipelineLayout.layout));
+
+    return cache.pipelineLayouts.emplace(std::move(key), std::move(pipelineLayout)).first->second;
+}
+
+const PipelineLayout& getPipelineLayout(PipelineLayoutCache& cache, ShaderList shaders, bool dynamicUniformBuffers)
+{
+    return getPipelineLayout(cache, uint32_t(shaders.size()), shaders.begin(), dynamicUniformBuffers);
+}
+
+VertexInputLayout getVertexInputLayout(const ShaderModule& vertexShader)
+{
+    GS_ASSERT(vertexShader.stage == VK_SHADER_STAGE_VERTEX_BIT);
+
+    VertexInputLayout layout{};
+    layout.binding.binding = 0;
+    layout.binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    for (const ShaderVertexInput& input : vertexShader.vertexInputs)
+    {
+        layout.attributes.push_back({ input.location, 0, input.format, layout.binding.stride });
+        layout.binding.stride += input.size;
+    }
+
+    return layout;
+}
+
+} // namespace Vulkan
+} // namespace GameSmith
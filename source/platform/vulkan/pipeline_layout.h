@@ -0,0 +1,54 @@
+#pragma once
+
+#include "gsvulkan.h"
+
+#include "shader_module.h"
+
+#include <map>
+
+namespace gs
+{
+namespace vk
+{
+
+struct PipelineLayout
+{
+    VkPipelineLayout layout;
+    std::vector<VkDescriptorSetLayout> setLayouts; // Indexed by set number
+    VkPushConstantRange pushConstantRange;         // size is 0 if the shaders don't use push constants
+};
+
+// Builds descriptor set and pipeline layouts from shader reflection. Layouts are keyed by their full contents so pipelines whose
+// shaders declare the same interface share the same Vulkan objects.
+struct PipelineLayoutCache
+{
+    VkDevice device;
+    std::map<std::vector<uint64_t>, VkDescriptorSetLayout> setLayouts;
+    std::map<std::vector<uint64_t>, PipelineLayout> pipelineLayouts;
+    std::map<uint32_t, VkDescriptorSetLayout> reservedSets; // Set numbers whose layout is supplied rather than reflected, not owned
+};
+
+struct VertexInputLayout
+{
+    VkVertexInputBindingDescription binding;
+    std::vector<VkVertexInputAttributeDescription> attributes;
+};
+
+void createPipelineLayoutCache(VkDevice device, PipelineLayoutCache& cache);
+void destroyPipelineLayoutCache(PipelineLayoutCache& cache);
+
+// Merges the bindings and push constants of all shaders. With dynamicUniformBuffers set, uniform buffers are declared as
+// VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC. The returned layout is owned by the cache.
+const PipelineLayout& getPipelineLayout(PipelineLayoutCache& cache, uint32_t shaderCount, const ShaderModule* shaders,
+                                        bool dynamicUniformBuffers = false);
+const PipelineLayout& getPipelineLayout(PipelineLayoutCache& cache, ShaderList shaders, bool dynamicUniformBuffers = false);
+
+// Every pipeline layout declaring set uses setLayout for it instead of a layout reflected from its shaders, which lets shaders share a
+// global set such as the bindless heap whose runtime arrays and binding flags can't be reflected. Call before getting pipeline layouts.
+void reservePipelineLayoutSet(PipelineLayoutCache& cache, uint32_t set, VkDescriptorSetLayout setLayout);
+
+// Tightly packed, per vertex attributes in location order in binding 0
+VertexInputLayout getVertexInputLayout(const ShaderModule& vertexShader);
+
+} // namespace Vulkan
+} // namespace GameSmith
@@ -0,0 +1,278 @@
+#include "gspch.h"
+
+#include "pipeline_statistics.h"
+
+#include "gamesmith/core/debug.h"
+#include "gamesmith/core/log.h"
+
+namespace gs
+{
+namespace vk
+{
+
+// Results are written in bit order, which matches the PipelineStatistic enum
+static const VkQueryPipelineStatisticFlags kStatisticFlags =
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT | VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+static const VkQueryPipelineStatisticFlags kComputeStatisticFlags = VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+static const float kAverageWeight = 0.05f;
+
+const char* pipelineStatisticName(PipelineStatistic statistic)
+{
+    static const char* names[kPipelineStatisticCount] = { "IA vertices",         "IA primitives",      "VS invocations",
+                                                          "Clipping invocations", "Clipping primitives", "FS invocations",
+                                                          "CS invocations" };
+    GS_ASSERT(statistic < kPipelineStatisticCount);
+    return names[statistic];
+}
+
+static void accumulateAverage(PipelineStatisticsQueries& queries, PassStatistics& pass)
+{
+    auto it = queries.averages.find(pass.name);
+
+    if (it == queries.averages.end())
+    {
+        for (uint32_t s = 0; s < kPipelineStatisticCount; ++s)
+        {
+            pass.averageValues[s] = double(pass.values[s]);
+        }
+
+        pass.averageSamplesPassed = double(pass.samplesPassed);
+        queries.averages.emplace(pass.name, pass);
+        return;
+    }
+
+    PassStatistics& average = it->second;
+
+    for (uint32_t s = 0; s < kPipelineStatisticCount; ++s)
+    {
+        average.averageValues[s] += (double(pass.values[s]) - average.averageValues[s]) * kAverageWeight;
+        pass.averageValues[s] = average.averageValues[s];
+    }
+
+    average.averageSamplesPassed += (double(pass.samplesPassed) - average.averageSamplesPassed) * kAverageWeight;
+    pass.averageSamplesPassed = average.averageSamplesPassed;
+}
+
+static void resolveFrame(PipelineStatisticsQueries& queries, PipelineStatisticsQueries::FrameQueries& frame)
+{
+    uint32_t passCount = uint32_t(frame.passes.size());
+
+    if (passCount == 0)
+    {
+        return;
+    }
+
+    // Every query result is followed by its availability. Queries of the other kind of pass stay unavailable and are skipped.
+    const uint32_t statisticsStride = kPipelineStatisticCount + 1;
+    std::vector<uint64_t> statistics(passCount * statisticsStride);
+    std::vector<uint64_t> occlusion(passCount * 2);
+    std::vector<uint64_t> compute(passCount * 2);
+    VkQueryResultFlags resultFlags = VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+
+    VkResult result = vkGetQueryPoolResults(queries.device, frame.statisticsPool, 0, passCount, statistics.size() * sizeof(uint64_t),
+                                            statistics.data(), statisticsStride * sizeof(uint64_t), resultFlags);
+
+    if (result == VK_SUCCESS || result == VK_NOT_READY)
+    {
+        result = vkGetQueryPoolResults(queries.device, frame.occlusionPool, 0, passCount, occlusion.size() * sizeof(uint64_t),
+                                       occlusion.data(), 2 * sizeof(uint64_t), resultFlags);
+    }
+
+    if (result == VK_SUCCESS || result == VK_NOT_READY)
+    {
+        result = vkGetQueryPoolResults(queries.device, frame.computePool, 0, passCount, compute.size() * sizeof(uint64_t), compute.data(),
+                                       2 * sizeof(uint64_t), resultFlags);
+    }
+
+    if (result != VK_SUCCESS && result != VK_NOT_READY)
+    {
+        VK_CHECK_RESULT(result);
+        return;
+    }
+
+    queries.latest.clear();
+    queries.frameTotal = PassStatistics{};
+    queries.frameTotal.name = "Frame";
+
+    for (uint32_t p = 0; p < passCount; ++p)
+    {
+        PassStatistics pass{};
+        pass.name = frame.passes[p].name;
+
+        if (frame.passes[p].compute)
+        {
+            if (!compute[p * 2 + 1])
+            {
+                continue;
+            }
+
+            pass.values[kComputeShaderInvocations] = compute[p * 2];
+        }
+        else
+        {
+            const uint64_t* values = &statistics[p * statisticsStride];
+
+            if (!values[kPipelineStatisticCount] || !occlusion[p * 2 + 1])
+            {
+                continue;
+            }
+
+            std::copy(values, values + kPipelineStatisticCount, pass.values);
+            pass.samplesPassed = occlusion[p * 2];
+        }
+
+        queries.frameTotal.samplesPassed += pass.samplesPassed;
+
+        for (uint32_t s = 0; s < kPipelineStatisticCount; ++s)
+        {
+            queries.frameTotal.values[s] += pass.values[s];
+        }
+
+        accumulateAverage(queries, pass);
+        queries.latest.push_back(std::move(pass));
+    }
+
+    accumulateAverage(queries, queries.frameTotal);
+}
+
+void createPipelineStatisticsQueries(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t frameCount, uint32_t maxPasses,
+                                     PipelineStatisticsQueries& queries)
+{
+    queries.device = device;
+    queries.maxPasses = maxPasses;
+    queries.enabled = false;
+    queries.passActive = false;
+    queries.currentFrame = nullptr;
+
+    // createDevice enables these whenever they are supported
+    VkPhysicalDeviceFeatures features{};
+    vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+    queries.supported = features.pipelineStatisticsQuery;
+    queries.inheritedQueries = features.inheritedQueries;
+
+    if (!queries.supported)
+    {
+        GS_WARN("Pipeline statistics queries are not supported.");
+        return;
+    }
+
+    queries.frames.resize(frameCount);
+
+    for (PipelineStatisticsQueries::FrameQueries& frame : queries.frames)
+    {
+        VkQueryPoolCreateInfo createInfo{ VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+        createInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        createInfo.queryCount = maxPasses;
+        createInfo.pipelineStatistics = kStatisticFlags;
+        VK_CHECK_RESULT(vkCreateQueryPool(device, &createInfo, nullptr, &frame.statisticsPool));
+
+        createInfo.pipelineStatistics = kComputeStatisticFlags;
+        VK_CHECK_RESULT(vkCreateQueryPool(device, &createInfo, nullptr, &frame.computePool));
+
+        createInfo.queryType = VK_QUERY_TYPE_OCCLUSION;
+        createInfo.pipelineStatistics = 0;
+        VK_CHECK_RESULT(vkCreateQueryPool(device, &createInfo, nullptr, &frame.occlusionPool));
+    }
+}
+
+void destroyPipelineStatisticsQueries(PipelineStatisticsQueries& queries)
+{
+    for (PipelineStatisticsQueries::FrameQueries& frame : queries.frames)
+    {
+        vkDestroyQueryPool(queries.device, frame.occlusionPool, nullptr);
+        vkDestroyQueryPool(queries.device, frame.computePool, nullptr);
+        vkDestroyQueryPool(queries.device, frame.statisticsPool, nullptr);
+    }
+
+    queries.frames.clear();
+    queries.currentFrame = nullptr;
+}
+
+void beginPipelineStatisticsFrame(PipelineStatisticsQueries& queries, VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+    GS_ASSERT(!queries.passActive);
+    queries.currentFrame = nullptr;
+
+    if (!queries.supported)
+    {
+        return;
+    }
+
+    PipelineStatisticsQueries::FrameQueries& frame = queries.frames[frameIndex];
+    resolveFrame(queries, frame);
+    frame.passes.clear();
+
+    if (queries.enabled)
+    {
+        vkCmdResetQueryPool(commandBuffer, frame.statisticsPool, 0, queries.maxPasses);
+        vkCmdResetQueryPool(commandBuffer, frame.occlusionPool, 0, queries.maxPasses);
+        vkCmdResetQueryPool(commandBuffer, frame.computePool, 0, queries.maxPasses);
+        queries.currentFrame = &frame;
+    }
+}
+
+void beginPipelineStatisticsPass(PipelineStatisticsQueries& queries, VkCommandBuffer commandBuffer, const char* name, bool compute,
+                                 bool usesSecondaryCommandBuffers)
+{
+    GS_ASSERT(!queries.passActive);
+    PipelineStatisticsQueries::FrameQueries* frame = queries.currentFrame;
+
+    if (!frame || frame->passes.size() == queries.maxPasses || (usesSecondaryCommandBuffers && !queries.inheritedQueries))
+    {
+        return;
+    }
+
+    uint32_t query = uint32_t(frame->passes.size());
+    frame->passes.push_back({ name, compute });
+
+    if (compute)
+    {
+        vkCmdBeginQuery(commandBuffer, frame->computePool, query, 0);
+    }
+    else
+    {
+        vkCmdBeginQuery(commandBuffer, frame->statisticsPool, query, 0);
+        vkCmdBeginQuery(commandBuffer, frame->occlusionPool, query, 0);
+    }
+
+    queries.passActive = true;
+}
+
+void endPipelineStatisticsPass(PipelineStatisticsQueries& queries, VkCommandBuffer commandBuffer)
+{
+    if (!queries.passActive)
+    {
+        return;
+    }
+
+    PipelineStatisticsQueries::FrameQueries* frame = queries.currentFrame;
+    uint32_t query = uint32_t(frame->passes.size() - 1);
+
+    if (frame->passes.back().compute)
+    {
+        vkCmdEndQuery(commandBuffer, frame->computePool, query);
+    }
+    else
+    {
+        vkCmdEndQuery(commandBuffer, frame->occlusionPool, query);
+        vkCmdEndQuery(commandBuffer, frame->statisticsPool, query);
+    }
+
+    queries.passActive = false;
+}
+
+void setInheritedQueries(const PipelineStatisticsQueries& queries, VkCommandBufferInheritanceInfo& inheritanceInfo)
+{
+    bool compute = queries.passActive && queries.currentFrame->passes.back().compute;
+    inheritanceInfo.occlusionQueryEnable = queries.passActive && !compute ? VK_TRUE : VK_FALSE;
+    inheritanceInfo.queryFlags = 0;
+    inheritanceInfo.pipelineStatistics = queries.passActive ? (compute ? kComputeStatisticFlags : kStatisticFlags) : 0;
+}
+
+} // namespace Vulkan
+} // namespace GameSmith
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "gsvulkan.h"
+
+namespace gs
+{
+namespace vk
+{
+
+enum PipelineStatistic
+{
+    kInputAssemblyVertices,
+    kInputAssemblyPrimitives,
+    kVertexShaderInvocations,
+    kClippingInvocations,
+    kClippingPrimitives,
+    kFragmentShaderInvocations,
+    kComputeShaderInvocations,
+    kPipelineStatisticCount
+};
+
+const char* pipelineStatisticName(PipelineStatistic statistic);
+
+struct PassStatistics
+{
+    std::string name;
+    uint64_t values[kPipelineStatisticCount];
+    uint64_t samplesPassed;
+    double averageValues[kPipelineStatisticCount];
+    double averageSamplesPassed;
+};
+
+// Wraps graphics passes in pipeline statistics and occlusion queries, and compute passes in a compute shader invocation query, as the
+// other counters mean nothing for dispatches. Like the GPU profiler, every frame in flight owns its own query pools and results are
+// read back when the frame slot is reused, so they arrive framesInFlight frames late without stalling. Recording is optional and can
+// be switched on and off at runtime with the enabled flag.
+struct PipelineStatisticsQueries
+{
+    struct Pass
+    {
+        std::string name;
+        bool compute;
+    };
+
+    // Query i of each pool belongs to pass i; graphics passes use the statistics and occlusion pools, compute passes the compute pool
+    struct FrameQueries
+    {
+        VkQueryPool statisticsPool;
+        VkQueryPool occlusionPool;
+        VkQueryPool computePool;
+        std::vector<Pass> passes;
+    };
+
+    VkDevice device;
+    bool supported;
+    bool inheritedQueries; // Queries may stay active around vkCmdExecuteCommands
+    bool enabled;
+    uint32_t maxPasses;
+
+    std::vector<FrameQueries> frames;
+    FrameQueries* currentFrame;
+    bool passActive;
+
+    std::vector<PassStatistics> latest; // Per pass, in recording order
+    PassStatistics frameTotal;
+    std::unordered_map<std::string, PassStatistics> averages;
+};
+
+void createPipelineStatisticsQueries(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t frameCount, uint32_t maxPasses,
+                                     PipelineStatisticsQueries& queries);
+void destroyPipelineStatisticsQueries(PipelineStatisticsQueries& queries);
+
+// Collects the results of the last submission of this frame slot and resets its queries. Call at the start of the frame's command
+// buffer, after its fence has been waited on.
+void beginPipelineStatisticsFrame(PipelineStatisticsQueries& queries, VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+// Passes don't nest. compute must be set for passes that only dispatch, whose statistics hold just their compute shader invocations.
+// usesSecondaryCommandBuffers must be set for passes that execute secondary command buffers, which can only be measured when the
+// device supports inherited queries.
+void beginPipelineStatisticsPass(PipelineStatisticsQueries& queries, VkCommandBuffer commandBuffer, const char* name, bool compute,
+                                 bool usesSecondaryCommandBuffers = false);
+void endPipelineStatisticsPass(PipelineStatisticsQueries& queries, VkCommandBuffer commandBuffer);
+
+// Fills in the query inheritance state for secondary command buffers executed inside the current pass.
+void setInheritedQueries(const PipelineStatisticsQueries& queries, VkCommandBufferInheritanceInfo& inheritanceInfo);
+
+} // namespace Vulkan
+} // namespace GameSmith
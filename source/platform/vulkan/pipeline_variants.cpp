@@ -0,0 +1,715 @@
+#include "gspch.h"
+
+#include "pipeline_variants.h"
+
+#include "pipeline_cache.h"
+
+#include "gamesmith/core/core.h"
+#include "gamesmith/core/debug.h"
+#include "gamesmith/core/log.h"
+#include "gamesmith/core/thread_pool.h"
+
+#include <chrono>
+#include <sstream>
+
+namespace gs
+{
+namespace vk
+{
+
+// 64-bit FNV-1a
+struct VariantHasher
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    void add(const void* data, size_t size)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ ((const uint8_t*)data)[i]) * 0x100000001b3ull;
+        }
+    }
+
+    void add(uint64_t value) { add(&value, sizeof(value)); }
+
+    void add(const std::string& string)
+    {
+        add(string.size());
+        add(string.data(), string.size());
+    }
+};
+
+static const ShaderModule* findVertexShader(const PipelineVariantDesc& desc)
+{
+    auto isVertexShader = [](const ShaderModule& shader) { return shader.stage == VK_SHADER_STAGE_VERTEX_BIT; };
+    auto it = std::find_if(desc.shaders.begin(), desc.shaders.end(), isVertexShader);
+    return it != desc.shaders.end() ? &*it : nullptr;
+}
+
+GraphicsPipelineState getDefaultGraphicsPipelineState(VkFormat colorFormat, VkFormat depthFormat)
+{
+    GraphicsPipelineState state{};
+    state.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    state.cullMode = VK_CULL_MODE_NONE;
+    state.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    state.depthTestEnable = depthFormat != VK_FORMAT_UNDEFINED;
+    state.depthWriteEnable = depthFormat != VK_FORMAT_UNDEFINED;
+    state.depthCompareOp = VK_COMPARE_OP_GREATER;
+    state.colorFormat = colorFormat;
+    state.depthFormat = depthFormat;
+    return state;
+}
+
+uint64_t hashPipelineVariant(const PipelineVariantDesc& desc)
+{
+    VariantHasher hasher;
+    hasher.add(desc.shaders.size());
+
+    for (const ShaderModule& shader : desc.shaders)
+    {
+        hasher.add(shader.stage);
+        hasher.add(shader.entryPoint);
+
+        // Modules created from memory have no path and can only be told apart by their handle
+        if (shader.path.empty())
+        {
+            hasher.add(uint64_t(shader.shader));
+        }
+        else
+        {
+            hasher.add(shader.path);
+        }
+    }
+
+    if (const ShaderModule* vertexShader = findVertexShader(desc))
+    {
+        VertexInputLayout vertexInputLayout = getVertexInputLayout(*vertexShader);
+        hasher.add(vertexInputLayout.binding.stride);
+
+        for (const VkVertexInputAttributeDescription& attribute : vertexInputLayout.attributes)
+        {
+            hasher.add(&attribute, sizeof(attribute));
+        }
+    }
+
+    hasher.add(desc.dynamicUniformBuffers);
+
+    // Order doesn't change the pipeline, so the values are hashed sorted by constant
+    std::vector<SpecializationValue> specialization = desc.specialization;
+    std::sort(specialization.begin(), specialization.end(),
+              [](const SpecializationValue& lhs, const SpecializationValue& rhs) { return lhs.constantId < rhs.constantId; });
+    hasher.add(specialization.size());
+
+    for (const SpecializationValue& value : specialization)
+    {
+        hasher.add((uint64_t(value.constantId) << 32) | value.value);
+    }
+
+    const GraphicsPipelineState& state = desc.state;
+    uint32_t stateValues[] = {
+        uint32_t(state.topology), uint32_t(state.cullMode),       uint32_t(state.frontFace),   state.depthTestEnable,      state.depthWriteEnable,
+        state.blendEnable,        uint32_t(state.depthCompareOp), uint32_t(state.colorFormat), uint32_t(state.depthFormat),
+    };
+    hasher.add(stateValues, sizeof(stateValues));
+    return hasher.hash;
+}
+
+// renderPass is the compatible render pass, or VK_NULL_HANDLE to create the pipeline for dynamic rendering. Touches no shared state
+// besides the pipeline cache, which Vulkan synchronizes internally, so it can run on any thread.
+static VkPipeline compileGraphicsPipeline(VkDevice device, VkPipelineCache pipelineCache, VkRenderPass renderPass, VkPipelineLayout layout,
+                                          const PipelineVariantDesc& desc)
+{
+    // Every stage gets the values of the constants it declares, packed in declaration order
+    std::vector<VkPipelineShaderStageCreateInfo> stages(desc.shaders.size());
+    std::vector<VkSpecializationInfo> specializationInfos(desc.shaders.size());
+    std::vector<std::vector<VkSpecializationMapEntry>> mapEntries(desc.shaders.size());
+    std::vector<std::vector<uint32_t>> specializationData(desc.shaders.size());
+
+    for (size_t s = 0; s < desc.shaders.size(); ++s)
+    {
+        const ShaderModule& shader = desc.shaders[s];
+
+        for (const ShaderSpecializationConstant& constant : shader.specializationConstants)
+        {
+            auto isConstant = [&](const SpecializationValue& value) { return value.constantId == constant.constantId; };
+            auto value = std::find_if(desc.specialization.begin(), desc.specialization.end(), isConstant);
+
+            if (value != desc.specialization.end())
+            {
+                GS_ASSERT(constant.size == sizeof(uint32_t));
+                mapEntries[s].push_back({ constant.constantId, uint32_t(specializationData[s].size() * sizeof(uint32_t)), sizeof(uint32_t) });
+                specializationData[s].push_back(value->value);
+            }
+        }
+
+        VkSpecializationInfo& specializationInfo = specializationInfos[s];
+        specializationInfo.mapEntryCount = uint32_t(mapEntries[s].size());
+        specializationInfo.pMapEntries = mapEntries[s].data();
+        specializationInfo.dataSize = specializationData[s].size() * sizeof(uint32_t);
+        specializationInfo.pData = specializationData[s].data();
+
+        VkPipelineShaderStageCreateInfo& createInfo = stages[s];
+        createInfo = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+        createInfo.stage = shader.stage;
+        createInfo.module = shader.shader;
+        createInfo.pName = shader.entryPoint.c_str();
+        createInfo.pSpecializationInfo = mapEntries[s].empty() ? nullptr : &specializationInfo;
+    }
+
+    const ShaderModule* vertexShader = findVertexShader(desc);
+    GS_ASSERT(vertexShader);
+    VertexInputLayout vertexInputLayout = getVertexInputLayout(*vertexShader);
+
+    VkPipelineVertexInputStateCreateInfo vertexInputState{ VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+    vertexInputState.vertexBindingDescriptionCount = 1;
+    vertexInputState.pVertexBindingDescriptions = &vertexInputLayout.binding;
+    vertexInputState.vertexAttributeDescriptionCount = uint32_t(vertexInputLayout.attributes.size());
+    vertexInputState.pVertexAttributeDescriptions = vertexInputLayout.attributes.data();
+
+    const GraphicsPipelineState& state = desc.state;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyState{ VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+    inputAssemblyState.topology = state.topology;
+
+    VkPipelineViewportStateCreateInfo viewportState{ VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizationState{ VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+    rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizationState.cullMode = state.cullMode;
+    rasterizationState.frontFace = state.frontFace;
+    rasterizationState.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisampleState{ VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+    multisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencilState{ VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
+    depthStencilState.depthTestEnable = state.depthTestEnable;
+    depthStencilState.depthWriteEnable = state.depthWriteEnable;
+    depthStencilState.depthCompareOp = state.depthCompareOp;
+
+    VkPipelineColorBlendAttachmentState colorBlendStateAttachements[1]{};
+    colorBlendStateAttachements[0].blendEnable = state.blendEnable;
+    colorBlendStateAttachements[0].srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    colorBlendStateAttachements[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendStateAttachements[0].colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendStateAttachements[0].srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendStateAttachements[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendStateAttachements[0].alphaBlendOp = VK_BLEND_OP_ADD;
+    colorBlendStateAttachements[0].colorWriteMask =
+            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    VkPipelineColorBlendStateCreateInfo colorBlendState{ VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+    colorBlendState.attachmentCount = GS_ARRAY_COUNT(colorBlendStateAttachements);
+    colorBlendState.pAttachments = colorBlendStateAttachements;
+
+    VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamicState{ VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
+    dynamicState.dynamicStateCount = GS_ARRAY_COUNT(dynamicStates);
+    dynamicState.pDynamicStates = dynamicStates;
+
+    VkGraphicsPipelineCreateInfo createInfo{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+    createInfo.stageCount = uint32_t(stages.size());
+    createInfo.pStages = stages.data();
+    createInfo.pVertexInputState = &vertexInputState;
+    createInfo.pInputAssemblyState = &inputAssemblyState;
+    createInfo.pViewportState = &viewportState;
+    createInfo.pRasterizationState = &rasterizationState;
+    createInfo.pMultisampleState = &multisampleState;
+    createInfo.pDepthStencilState = &depthStencilState;
+    createInfo.pColorBlendState = &colorBlendState;
+    createInfo.pDynamicState = &dynamicState;
+    createInfo.layout = layout;
+
+    createInfo.renderPass = renderPass;
+
+    VkPipelineRenderingCreateInfoKHR renderingInfo{ VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR };
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &state.colorFormat;
+    renderingInfo.depthAttachmentFormat = state.depthFormat;
+    createInfo.pNext = renderPass ? nullptr : &renderingInfo;
+
+    VkPipeline pipeline{};
+    VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &createInfo, nullptr, &pipeline));
+    return pipeline;
+}
+
+// The render graph's render pass cache isn't thread safe, so passes are looked up on the calling thread before compiling
+static VkRenderPass getVariantRenderPass(RenderGraph& renderGraph, const PipelineVariantDesc& desc)
+{
+    return renderGraph.dynamicRendering ? VK_NULL_HANDLE : getCompatibleRenderPass(renderGraph, { desc.state.colorFormat }, desc.state.depthFormat);
+}
+
+VkPipeline createGraphicsPipeline(VkDevice device, VkPipelineCache pipelineCache, RenderGraph& renderGraph, VkPipelineLayout layout,
+                                  const PipelineVariantDesc& desc)
+{
+    return compileGraphicsPipeline(device, pipelineCache, getVariantRenderPass(renderGraph, desc), layout, desc);
+}
+
+// Swaps in the latest version of every reloaded shader the variant uses
+static void applyReloadedShaders(const PipelineVariantCache& cache, PipelineVariantDesc& desc)
+{
+    for (ShaderModule& shader : desc.shaders)
+    {
+        auto it = shader.path.empty() ? cache.reloadedShaders.end() : cache.reloadedShaders.find(shader.path);
+
+        if (it != cache.reloadedShaders.end())
+        {
+            shader = it->second;
+        }
+    }
+}
+
+static bool isSameShaderInterface(const ShaderModule& lhs, const ShaderModule& rhs)
+{
+    auto isSameBinding = [](const ShaderBinding& a, const ShaderBinding& b) {
+        return a.set == b.set && a.binding == b.binding && a.descriptorType == b.descriptorType && a.descriptorCount == b.descriptorCount;
+    };
+    auto isSameInput = [](const ShaderVertexInput& a, const ShaderVertexInput& b) { return a.location == b.location && a.format == b.format; };
+
+    return lhs.stage == rhs.stage && lhs.pushConstantSize == rhs.pushConstantSize &&
+           std::equal(lhs.bindings.begin(), lhs.bindings.end(), rhs.bindings.begin(), rhs.bindings.end(), isSameBinding) &&
+           std::equal(lhs.vertexInputs.begin(), lhs.vertexInputs.end(), rhs.vertexInputs.begin(), rhs.vertexInputs.end(), isSameInput);
+}
+
+// Compiles the variant on one of the pool's workers into the shared pipeline cache, for updatePipelineVariants to publish
+static void submitPipelineVariant(PipelineVariantCache& cache, ThreadPool& threadPool, uint64_t hash, const PipelineVariantDesc& desc)
+{
+    VkDevice device = cache.device;
+    VkPipelineCache pipelineCache = cache.pipelineCache;
+    VkRenderPass renderPass = getVariantRenderPass(*cache.renderGraph, desc);
+    VkPipelineLayout layout =
+            getPipelineLayout(*cache.layoutCache, uint32_t(desc.shaders.size()), desc.shaders.data(), desc.dynamicUniformBuffers).layout;
+
+    // The task keeps its own copy of the description; the shader modules it names must outlive the cache or the compile
+    cache.compiling[hash] = threadPool.submit([&cache, device, pipelineCache, renderPass, layout, desc, hash]() {
+        auto compileBegin = std::chrono::steady_clock::now();
+        VkPipeline pipeline = compileGraphicsPipeline(device, pipelineCache, renderPass, layout, desc);
+        float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - compileBegin).count();
+
+        std::lock_guard<std::mutex> lock(cache.compiledMutex);
+        cache.compiled.push_back({ hash, pipeline, milliseconds });
+    });
+}
+
+void createPipelineVariantCache(VkDevice device, VkPipelineCache pipelineCache, RenderGraph& renderGraph, PipelineLayoutCache& layoutCache,
+                                DeletionQueue& deletionQueue, PipelineVariantCache& cache)
+{
+    cache.device = device;
+    cache.pipelineCache = pipelineCache;
+    cache.renderGraph = &renderGraph;
+    cache.layoutCache = &layoutCache;
+    cache.deletionQueue = &deletionQueue;
+}
+
+void destroyPipelineVariantCache(PipelineVariantCache& cache)
+{
+    // Background compiles write to the cache, so let them finish
+    cache.staleCompiles.clear();
+
+    for (auto& entry : cache.compiling)
+    {
+        entry.second.wait();
+    }
+
+    // The device is idle, so pipelines that finished compiling since the last update are destroyed right away rather than
+    // published, which would retire the ones they replace to the deletion queue
+    for (const PipelineVariantCache::CompiledVariant& variant : cache.compiled)
+    {
+        vkDestroyPipeline(cache.device, variant.pipeline, nullptr);
+    }
+
+    for (auto& entry : cache.pipelines)
+    {
+        vkDestroyPipeline(cache.device, entry.second, nullptr);
+    }
+
+    for (auto& entry : cache.manifestShaders)
+    {
+        vkDestroyShaderModule(cache.device, entry.second.shader, nullptr);
+    }
+
+    for (auto& entry : cache.reloadedShaders)
+    {
+        vkDestroyShaderModule(cache.device, entry.second.shader, nullptr);
+    }
+
+    for (VkShaderModule shader : cache.retiredShaders)
+    {
+        vkDestroyShaderModule(cache.device, shader, nullptr);
+    }
+
+    cache.pipelines.clear();
+    cache.descs.clear();
+    cache.compiling.clear();
+    cache.compiled.clear();
+    cache.manifestShaders.clear();
+    cache.reloadedShaders.clear();
+    cache.retiredShaders.clear();
+}
+
+std::vector<uint64_t> createPipelineVariants(PipelineVariantCache& cache, ThreadPool& threadPool, const std::vector<PipelineVariantDesc>& descs)
+{
+    struct PendingVariant
+    {
+        PipelineVariantDesc desc;
+        uint64_t hash;
+        VkPipelineLayout layout;
+        VkRenderPass renderPass;
+        VkPipeline pipeline;
+    };
+
+    std::vector<uint64_t> hashes;
+    std::vector<PendingVariant> pending;
+
+    // Layouts and compatible render passes come from caches that aren't thread safe, so they are looked up here
+    for (const PipelineVariantDesc& desc : descs)
+    {
+        uint64_t hash = hashPipelineVariant(desc);
+        hashes.push_back(hash);
+
+        auto isHash = [&](const PendingVariant& variant) { return variant.hash == hash; };
+
+        if (cache.pipelines.count(hash) || cache.compiling.count(hash) || std::any_of(pending.begin(), pending.end(), isHash))
+        {
+            continue;
+        }
+
+        PipelineVariantDesc reloadedDesc = desc;
+        applyReloadedShaders(cache, reloadedDesc);
+        const PipelineLayout& layout = getPipelineLayout(*cache.layoutCache, uint32_t(reloadedDesc.shaders.size()), reloadedDesc.shaders.data(),
+                                                         reloadedDesc.dynamicUniformBuffers);
+        VkRenderPass renderPass = getVariantRenderPass(*cache.renderGraph, reloadedDesc);
+        pending.push_back({ std::move(reloadedDesc), hash, layout.layout, renderPass, VK_NULL_HANDLE });
+    }
+
+    if (pending.empty())
+    {
+        return hashes;
+    }
+
+    std::vector<VkPipelineCache> threadCaches(threadPool.getThreadCount());
+
+    for (VkPipelineCache& threadCache : threadCaches)
+    {
+        threadCache = createPipelineCache(cache.device);
+    }
+
+    threadPool.parallelFor(uint32_t(pending.size()), [&](uint32_t index, uint32_t threadIndex) {
+        PendingVariant& variant = pending[index];
+        variant.pipeline = compileGraphicsPipeline(cache.device, threadCaches[threadIndex], variant.renderPass, variant.layout, variant.desc);
+    });
+
+    mergePipelineCaches(cache.device, cache.pipelineCache, threadCaches);
+
+    for (VkPipelineCache threadCache : threadCaches)
+    {
+        vkDestroyPipelineCache(cache.device, threadCache, nullptr);
+    }
+
+    for (PendingVariant& variant : pending)
+    {
+        cache.pipelines.emplace(variant.hash, variant.pipeline);
+        cache.descs.emplace(variant.hash, std::move(variant.desc));
+    }
+
+    return hashes;
+}
+
+void prewarmPipelineVariants(PipelineVariantCache& cache, ThreadPool& threadPool, const std::string& path)
+{
+    std::ifstream fs(path);
+
+    if (!fs)
+    {
+        return;
+    }
+
+    // Each line: topology cullMode frontFace depthTest depthWrite depthCompareOp blend colorFormat depthFormat dynamicUniformBuffers
+    // specializationCount [constantId value]... shaderCount [path]...
+    std::vector<PipelineVariantDesc> descs;
+    std::string line;
+
+    while (std::getline(fs, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        std::istringstream ls(line);
+        PipelineVariantDesc desc{};
+        GraphicsPipelineState& state = desc.state;
+        uint32_t values[10]{};
+
+        for (uint32_t& value : values)
+        {
+            ls >> value;
+        }
+
+        state.topology = VkPrimitiveTopology(values[0]);
+        state.cullMode = VkCullModeFlags(values[1]);
+        state.frontFace = VkFrontFace(values[2]);
+        state.depthTestEnable = values[3];
+        state.depthWriteEnable = values[4];
+        state.depthCompareOp = VkCompareOp(values[5]);
+        state.blendEnable = values[6];
+        state.colorFormat = VkFormat(values[7]);
+        state.depthFormat = VkFormat(values[8]);
+        desc.dynamicUniformBuffers = values[9] != 0;
+
+        uint32_t specializationCount{};
+        ls >> specializationCount;
+        desc.specialization.resize(specializationCount);
+
+        for (SpecializationValue& value : desc.specialization)
+        {
+            ls >> value.constantId >> value.value;
+        }
+
+        uint32_t shaderCount{};
+        ls >> shaderCount;
+        bool shadersFound = true;
+
+        for (uint32_t s = 0; s < shaderCount && ls; ++s)
+        {
+            std::string shaderPath;
+            ls >> shaderPath;
+
+            auto it = cache.manifestShaders.find(shaderPath);
+
+            if (it == cache.manifestShaders.end())
+            {
+                std::error_code ec;
+
+                if (!std::filesystem::exists(shaderPath, ec))
+                {
+                    shadersFound = false;
+                    break;
+                }
+
+                ShaderModule shader = loadShaderModule(cache.device, shaderPath);
+
+                if (!shader.shader)
+                {
+                    shadersFound = false;
+                    break;
+                }
+
+                it = cache.manifestShaders.emplace(shaderPath, shader).first;
+            }
+
+            desc.shaders.push_back(it->second);
+        }
+
+        if (!ls || !shadersFound || desc.shaders.empty())
+        {
+            GS_WARN("Skipping pipeline variant '%s' from manifest '%s'.", line.c_str(), path.c_str());
+            continue;
+        }
+
+        descs.push_back(std::move(desc));
+    }
+
+    auto prewarmBegin = std::chrono::steady_clock::now();
+    createPipelineVariants(cache, threadPool, descs);
+    GS_INFO("Prewarmed %zu pipeline variants from '%s' in %.3f ms.", descs.size(), path.c_str(),
+            std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - prewarmBegin).count());
+}
+
+bool savePipelineVariantManifest(const PipelineVariantCache& cache, const std::string& path)
+{
+    std::ofstream fs(path, std::ios::out | std::ios::trunc);
+    fs << "# Pipeline variants: topology cullMode frontFace depthTest depthWrite depthCompareOp blend colorFormat depthFormat "
+          "dynamicUniformBuffers specializationCount [constantId value]... shaderCount [path]...\n";
+
+    for (const auto& entry : cache.descs)
+    {
+        const PipelineVariantDesc& desc = entry.second;
+        const GraphicsPipelineState& state = desc.state;
+
+        // Variants of shaders not loaded from files can't be recreated
+        if (std::any_of(desc.shaders.begin(), desc.shaders.end(), [](const ShaderModule& shader) { return shader.path.empty(); }))
+        {
+            continue;
+        }
+
+        fs << state.topology << ' ' << state.cullMode << ' ' << state.frontFace << ' ' << state.depthTestEnable << ' ' << state.depthWriteEnable
+           << ' ' << state.depthCompareOp << ' ' << state.blendEnable << ' ' << state.colorFormat << ' ' << state.depthFormat << ' '
+           << uint32_t(desc.dynamicUniformBuffers) << ' ' << desc.specialization.size();
+
+        for (const SpecializationValue& value : desc.specialization)
+        {
+            fs << ' ' << value.constantId << ' ' << value.value;
+        }
+
+        fs << ' ' << desc.shaders.size();
+
+        for (const ShaderModule& shader : desc.shaders)
+        {
+            fs << ' ' << shader.path;
+        }
+
+        fs << '\n';
+    }
+
+    if (!fs)
+    {
+        GS_ERROR("Failed to write pipeline variant manifest '%s'.", path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+uint64_t requestPipelineVariant(PipelineVariantCache& cache, ThreadPool& threadPool, const PipelineVariantDesc& desc)
+{
+    uint64_t hash = hashPipelineVariant(desc);
+
+    if (cache.pipelines.count(hash) || cache.compiling.count(hash))
+    {
+        return hash;
+    }
+
+    PipelineVariantDesc& reloadedDesc = cache.descs.emplace(hash, desc).first->second;
+    applyReloadedShaders(cache, reloadedDesc);
+    submitPipelineVariant(cache, threadPool, hash, reloadedDesc);
+    return hash;
+}
+
+void updatePipelineVariants(PipelineVariantCache& cache)
+{
+    std::vector<PipelineVariantCache::CompiledVariant> compiled;
+
+    {
+        std::lock_guard<std::mutex> lock(cache.compiledMutex);
+        compiled.swap(cache.compiled);
+    }
+
+    for (const PipelineVariantCache::CompiledVariant& variant : compiled)
+    {
+        GS_INFO("Pipeline variant %016llx compiled in the background in %.3f ms.", (unsigned long long)variant.hash, variant.milliseconds);
+        cache.compiling.erase(variant.hash);
+
+        // A reloaded variant replaces its pipeline from this frame on; frames in flight may still be using the old one
+        VkPipeline& pipeline = cache.pipelines[variant.hash];
+
+        if (pipeline)
+        {
+            deferDestroy(*cache.deletionQueue, pipeline);
+        }
+
+        pipeline = variant.pipeline;
+
+        auto stale = cache.staleCompiles.find(variant.hash);
+
+        if (stale != cache.staleCompiles.end())
+        {
+            ThreadPool* threadPool = stale->second;
+            cache.staleCompiles.erase(stale);
+            submitPipelineVariant(cache, *threadPool, variant.hash, cache.descs[variant.hash]);
+        }
+    }
+
+    // Shader modules are only used while pipelines are created from them
+    if (cache.compiling.empty())
+    {
+        for (VkShaderModule shader : cache.retiredShaders)
+        {
+            vkDestroyShaderModule(cache.device, shader, nullptr);
+        }
+
+        cache.retiredShaders.clear();
+    }
+}
+
+uint32_t reloadPipelineVariantShader(PipelineVariantCache& cache, ThreadPool& threadPool, const std::string& path)
+{
+    // Variants name the file the way it was loaded, which may differ in spelling from the path that changed
+    std::filesystem::path changedPath = std::filesystem::path(path).lexically_normal();
+    auto isChangedShader = [&](const ShaderModule& shader) {
+        return !shader.path.empty() && std::filesystem::path(shader.path).lexically_normal() == changedPath;
+    };
+
+    const ShaderModule* previous = nullptr;
+    std::vector<uint64_t> affected;
+
+    for (const auto& entry : cache.descs)
+    {
+        auto it = std::find_if(entry.second.shaders.begin(), entry.second.shaders.end(), isChangedShader);
+
+        if (it != entry.second.shaders.end())
+        {
+            previous = &*it;
+            affected.push_back(entry.first);
+        }
+    }
+
+    if (!previous)
+    {
+        return 0;
+    }
+
+    ShaderModule shader = loadShaderModule(cache.device, previous->path);
+
+    if (!shader.shader)
+    {
+        GS_ERROR("Keeping the previous version of shader '%s'.", previous->path.c_str());
+        return 0;
+    }
+
+    // Callers bind descriptors and push constants with the layout they looked up when creating the variant, which a pipeline built
+    // against a different layout can't be used with
+    if (!isSameShaderInterface(shader, *previous))
+    {
+        GS_ERROR("Shader '%s' changed its bindings, push constants or vertex inputs, restart to pick it up.", shader.path.c_str());
+        vkDestroyShaderModule(cache.device, shader.shader, nullptr);
+        return 0;
+    }
+
+    auto reloaded = cache.reloadedShaders.find(shader.path);
+
+    if (reloaded != cache.reloadedShaders.end())
+    {
+        cache.retiredShaders.push_back(reloaded->second.shader);
+        reloaded->second = shader;
+    }
+    else
+    {
+        cache.reloadedShaders.emplace(shader.path, shader);
+    }
+
+    for (uint64_t hash : affected)
+    {
+        PipelineVariantDesc& desc = cache.descs[hash];
+        applyReloadedShaders(cache, desc);
+
+        if (cache.compiling.count(hash))
+        {
+            cache.staleCompiles[hash] = &threadPool;
+        }
+        else
+        {
+            submitPipelineVariant(cache, threadPool, hash, desc);
+        }
+    }
+
+    GS_INFO("Reloaded shader '%s', recompiling %zu pipeline variants.", shader.path.c_str(), affected.size());
+    return uint32_t(affected.size());
+}
+
+VkPipeline getPipelineVariant(const PipelineVariantCache& cache, uint64_t hash, uint64_t fallbackHash)
+{
+    auto it = cache.pipelines.find(hash);
+
+    if (it == cache.pipelines.end())
+    {
+        it = cache.pipelines.find(fallbackHash);
+    }
+
+    return it != cache.pipelines.end() ? it->second : VK_NULL_HANDLE;
+}
+
+} // namespace Vulkan
+} // namespace GameSmith
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "gsvulkan.h"
+
+#include "deletion_queue.h"
+#include "pipeline_layout.h"
+#include "render_graph.h"
+#include "shader_module.h"
+
+#include <future>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace gs
+{
+
+class ThreadPool;
+
+namespace vk
+{
+
+// 32-bit specialization constant value; bools are 0 or 1 and floats are passed by their bits
+struct SpecializationValue
+{
+    uint32_t constantId;
+    uint32_t value;
+};
+
+// Fixed function state of a graphics pipeline. Viewport and scissor are always dynamic.
+struct GraphicsPipelineState
+{
+    VkPrimitiveTopology topology;
+    VkCullModeFlags cullMode;
+    VkFrontFace frontFace;
+    VkBool32 depthTestEnable;
+    VkBool32 depthWriteEnable;
+    VkCompareOp depthCompareOp;
+    VkBool32 blendEnable; // Alpha blending over the single color attachment
+    VkFormat colorFormat;
+    VkFormat depthFormat; // VK_FORMAT_UNDEFINED without a depth attachment
+};
+
+// Everything that identifies a pipeline. The vertex input layout is reflected from the vertex shader and the pipeline layout is built
+// from the shaders by the cache's layout cache.
+struct PipelineVariantDesc
+{
+    std::vector<ShaderModule> shaders;
+    bool dynamicUniformBuffers;
+    std::vector<SpecializationValue> specialization; // Applied to every stage declaring the constant, the rest keep their defaults
+    GraphicsPipelineState state;
+};
+
+// Triangle lists with depth testing and writes against the reversed depth range the main pass uses
+GraphicsPipelineState getDefaultGraphicsPipelineState(VkFormat colorFormat, VkFormat depthFormat);
+
+// Hash of the shader files and entry points, specialization values, vertex input layout, pipeline layout inputs and render state.
+// Shaders are identified by their path rather than their module handle, so variants recorded to a manifest hash the same when they
+// are rebuilt from it in a later run.
+uint64_t hashPipelineVariant(const PipelineVariantDesc& desc);
+
+// Specialization constants let one SPIR-V file cover every combination of feature toggles. Not thread safe without dynamic rendering,
+// as the compatible render pass comes from the graph's cache.
+VkPipeline createGraphicsPipeline(VkDevice device, VkPipelineCache pipelineCache, RenderGraph& renderGraph, VkPipelineLayout layout,
+                                  const PipelineVariantDesc& desc);
+
+// Pipelines keyed by hashPipelineVariant, so a draw finds its variant with one hash table lookup of a hash computed when the draw's
+// material was set up. Known variants are created up front on the thread pool, each worker compiling into its own VkPipelineCache
+// that is merged into the shared one afterwards. Variants first needed at runtime are requested instead: they compile in the
+// background into the shared cache while draws substitute a fallback pipeline, so a new variant never stalls a frame. Every variant
+// created is remembered with its description so it can be written to a manifest and created ahead of use in the next run.
+//
+// Shaders can be reloaded while running: every variant using the file is recompiled in the background against the new module and
+// swapped in at the next frame boundary, while frames in flight finish with the old pipeline, which goes to the deletion queue.
+struct PipelineVariantCache
+{
+    struct CompiledVariant
+    {
+        uint64_t hash;
+        VkPipeline pipeline;
+        float milliseconds;
+    };
+
+    VkDevice device;
+    VkPipelineCache pipelineCache;
+    RenderGraph* renderGraph;
+    PipelineLayoutCache* layoutCache;
+    DeletionQueue* deletionQueue;
+
+    // Only touched by the thread owning the cache, so lookups take no lock
+    std::unordered_map<uint64_t, VkPipeline> pipelines;
+    std::map<uint64_t, PipelineVariantDesc> descs;             // Ordered so manifests are written in a stable order
+    std::map<std::string, ShaderModule> manifestShaders;       // Loaded for manifest variants, owned by the cache
+    std::unordered_map<uint64_t, std::future<void>> compiling; // Requested variants still compiling in the background
+    std::map<std::string, ShaderModule> reloadedShaders;       // Latest version of each reloaded file, owned by the cache
+    std::vector<VkShaderModule> retiredShaders;                // Replaced by a later reload, destroyed once no compile can use them
+    std::unordered_map<uint64_t, ThreadPool*> staleCompiles;   // Reloaded while compiling, compiled again once that compile finishes
+
+    std::vector<CompiledVariant> compiled; // Finished in the background, published by updatePipelineVariants
+    std::mutex compiledMutex;
+};
+
+void createPipelineVariantCache(VkDevice device, VkPipelineCache pipelineCache, RenderGraph& renderGraph, PipelineLayoutCache& layoutCache,
+                                DeletionQueue& deletionQueue, PipelineVariantCache& cache);
+void destroyPipelineVariantCache(PipelineVariantCache& cache);
+
+// Creates the variants that don't exist yet on the thread pool and returns their hashes in order. Blocks until they are all created.
+std::vector<uint64_t> createPipelineVariants(PipelineVariantCache& cache, ThreadPool& threadPool, const std::vector<PipelineVariantDesc>& descs);
+
+// Creates every variant listed in the manifest at path, loading the shaders it names. A missing manifest is not an error.
+void prewarmPipelineVariants(PipelineVariantCache& cache, ThreadPool& threadPool, const std::string& path);
+
+// Writes the descriptions of every variant created so far, one per line
+bool savePipelineVariantManifest(const PipelineVariantCache& cache, const std::string& path);
+
+// Queues the variant for compilation on the pool's workers unless it exists or is already compiling, and returns its hash as a handle
+// to look it up with. The pool should be separate from the one recording draws so compiles never delay the frame's jobs.
+uint64_t requestPipelineVariant(PipelineVariantCache& cache, ThreadPool& threadPool, const PipelineVariantDesc& desc);
+
+// Publishes the variants that finished compiling since the last call, retiring the pipelines reloaded ones replace. Call once per
+// frame, after beginning the deletion queue frame and before looking pipelines up.
+void updatePipelineVariants(PipelineVariantCache& cache);
+
+// Loads the shader at path again and recompiles every variant using it on the pool's workers; variants requested later use the new
+// module too. Variants keep their hashes, so draws pick up the new pipelines without looking them up again. Only changes that keep
+// the shader's interface, and with it the pipeline layout, are picked up. Returns the number of variants recompiling, or 0 if no
+// variant uses the shader, the file can't be loaded or its interface changed, in which case the previous version stays.
+uint32_t reloadPipelineVariantShader(PipelineVariantCache& cache, ThreadPool& threadPool, const std::string& path);
+
+// O(1) lookup for draw time. Returns the fallback variant while the requested one is compiling, VK_NULL_HANDLE if neither exists.
+VkPipeline getPipelineVariant(const PipelineVariantCache& cache, uint64_t hash, uint64_t fallbackHash = 0);
+
+} // namespace Vulkan
+} // namespace GameSmith
@@ -0,0 +1,273 @@
+#include "gspch.h"
+
+#include "present_latency.h"
+
+#include "device.h"
+#include "gamesmith/core/debug.h"
+#include "gamesmith/core/log.h"
+#include "gamesmith/math/math.h"
+
+namespace gs
+{
+namespace vk
+{
+
+// The waiter thread returns from vkWaitForPresentKHR at least this often, to notice shutdown and swapchains being retired
+static const uint64_t kPresentWaitTimeoutNs = 5 * 1000 * 1000;
+
+// steady_clock reads QueryPerformanceCounter with MSVC and CLOCK_MONOTONIC with libstdc++, so the matching host time domain shares its
+// epoch and only needs converting to steady_clock ticks
+#ifdef GS_PLATFORM_WINDOWS
+static const VkTimeDomainEXT kHostTimeDomain = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+
+static PresentLatency::Clock::time_point hostTimeToClock(uint64_t ticks)
+{
+    LARGE_INTEGER frequency{};
+    QueryPerformanceFrequency(&frequency);
+    uint64_t ticksPerSecond = uint64_t(frequency.QuadPart);
+    uint64_t nanoseconds = ticks / ticksPerSecond * 1000000000ull + ticks % ticksPerSecond * 1000000000ull / ticksPerSecond;
+    return PresentLatency::Clock::time_point(std::chrono::duration_cast<PresentLatency::Clock::duration>(std::chrono::nanoseconds(nanoseconds)));
+}
+#else
+static const VkTimeDomainEXT kHostTimeDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+
+static PresentLatency::Clock::time_point hostTimeToClock(uint64_t nanoseconds)
+{
+    return PresentLatency::Clock::time_point(std::chrono::duration_cast<PresentLatency::Clock::duration>(std::chrono::nanoseconds(nanoseconds)));
+}
+#endif
+
+// Must be called with the mutex held.
+static void addSample(PresentLatency& latency, PresentLatency::Clock::time_point inputTime, PresentLatency::Clock::time_point outputTime)
+{
+    float milliseconds = std::chrono::duration<float, std::milli>(outputTime - inputTime).count();
+    latency.averageMilliseconds = gs::lerp(latency.averageMilliseconds, milliseconds, 0.05f);
+}
+
+static void waitForPresents(PresentLatency& latency)
+{
+    std::unique_lock<std::mutex> lock(latency.mutex);
+
+    while (!latency.quit)
+    {
+        if (latency.pendingPresents.empty())
+        {
+            latency.changed.wait(lock);
+            continue;
+        }
+
+        PresentLatency::PendingPresent present = latency.pendingPresents.front();
+        latency.waitingSwapchain = present.swapchain;
+        lock.unlock();
+
+        VkResult result = latency.waitForPresent(latency.device, present.swapchain, present.presentId, kPresentWaitTimeoutNs);
+        PresentLatency::Clock::time_point presentTime = PresentLatency::Clock::now();
+
+        lock.lock();
+        latency.waitingSwapchain = VK_NULL_HANDLE;
+        latency.changed.notify_all();
+
+        // The entry is gone if its swapchain was retired while waiting
+        if (result == VK_TIMEOUT || latency.pendingPresents.empty() || latency.pendingPresents.front().presentId != present.presentId)
+        {
+            continue;
+        }
+
+        // An out of date or lost swapchain may never display the present, so it is dropped without a sample
+        if (result == VK_SUCCESS)
+        {
+            addSample(latency, present.inputTime, presentTime);
+        }
+
+        latency.pendingPresents.pop_front();
+    }
+}
+
+static bool hasCalibrateableTimeDomains(VkInstance instance, VkPhysicalDevice physicalDevice)
+{
+    auto getTimeDomains = (PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT)vkGetInstanceProcAddr(
+            instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT");
+
+    if (!getTimeDomains)
+    {
+        return false;
+    }
+
+    uint32_t timeDomainCount{};
+    VK_CHECK_RESULT(getTimeDomains(physicalDevice, &timeDomainCount, nullptr));
+    std::vector<VkTimeDomainEXT> timeDomains(timeDomainCount);
+    VK_CHECK_RESULT(getTimeDomains(physicalDevice, &timeDomainCount, timeDomains.data()));
+
+    auto hasTimeDomain = [&](VkTimeDomainEXT domain) { return std::find(timeDomains.begin(), timeDomains.end(), domain) != timeDomains.end(); };
+    return hasTimeDomain(VK_TIME_DOMAIN_DEVICE_EXT) && hasTimeDomain(kHostTimeDomain);
+}
+
+void createPresentLatency(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex,
+                          uint32_t frameCount, PresentLatency& latency)
+{
+    latency.device = device;
+    latency.source = PresentLatencySource::None;
+    latency.averageMilliseconds = 0.f;
+    latency.nextPresentId = 1;
+    latency.waitingSwapchain = VK_NULL_HANDLE;
+    latency.quit = false;
+
+    if (isPresentWaitSupported(physicalDevice))
+    {
+        latency.waitForPresent = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(device, "vkWaitForPresentKHR");
+        GS_ASSERT(latency.waitForPresent);
+
+        latency.source = PresentLatencySource::PresentWait;
+        latency.waiter = std::thread(waitForPresents, std::ref(latency));
+        return;
+    }
+
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+    uint32_t validBits = queueFamilies[queueFamilyIndex].timestampValidBits;
+
+    if (!isCalibratedTimestampsSupported(physicalDevice) || !hasCalibrateableTimeDomains(instance, physicalDevice) || validBits == 0 ||
+        properties.limits.timestampPeriod <= 0.f)
+    {
+        GS_WARN("Neither present wait nor calibrated timestamps are supported, input latency is not measured.");
+        return;
+    }
+
+    latency.getCalibratedTimestamps = (PFN_vkGetCalibratedTimestampsEXT)vkGetDeviceProcAddr(device, "vkGetCalibratedTimestampsEXT");
+    GS_ASSERT(latency.getCalibratedTimestamps);
+
+    latency.source = PresentLatencySource::GpuCompletion;
+    latency.hostTimeDomain = kHostTimeDomain;
+    latency.timestampPeriod = properties.limits.timestampPeriod;
+    latency.timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+    latency.frames.resize(frameCount);
+
+    for (PresentLatency::FrameTimestamp& frame : latency.frames)
+    {
+        VkQueryPoolCreateInfo createInfo{ VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+        createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        createInfo.queryCount = 1;
+        VK_CHECK_RESULT(vkCreateQueryPool(device, &createInfo, nullptr, &frame.queryPool));
+        frame.pending = false;
+    }
+}
+
+void destroyPresentLatency(PresentLatency& latency)
+{
+    if (latency.waiter.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(latency.mutex);
+            latency.quit = true;
+            latency.changed.notify_all();
+        }
+
+        latency.waiter.join();
+    }
+
+    for (PresentLatency::FrameTimestamp& frame : latency.frames)
+    {
+        vkDestroyQueryPool(latency.device, frame.queryPool, nullptr);
+    }
+
+    latency.frames.clear();
+    latency.pendingPresents.clear();
+}
+
+void beginPresentLatencyFrame(PresentLatency& latency, VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+    if (latency.source != PresentLatencySource::GpuCompletion)
+    {
+        return;
+    }
+
+    PresentLatency::FrameTimestamp& frame = latency.frames[frameIndex];
+
+    if (frame.pending)
+    {
+        uint64_t timestamp{};
+        VkResult result = vkGetQueryPoolResults(latency.device, frame.queryPool, 0, 1, sizeof(timestamp), &timestamp, sizeof(timestamp),
+                                                VK_QUERY_RESULT_64_BIT);
+
+        // Sampling both clocks now rather than once at startup keeps drift between them out of the result
+        VkCalibratedTimestampInfoEXT timestampInfos[2] = { { VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT },
+                                                           { VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT } };
+        timestampInfos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+        timestampInfos[1].timeDomain = latency.hostTimeDomain;
+        uint64_t calibration[2]{};
+        uint64_t maxDeviation{};
+
+        if (result == VK_SUCCESS &&
+            latency.getCalibratedTimestamps(latency.device, 2, timestampInfos, calibration, &maxDeviation) == VK_SUCCESS)
+        {
+            // The timestamp precedes the calibration, so the masked difference is how far back it lies, even across a wrap
+            uint64_t ticksBefore = (calibration[0] - timestamp) & latency.timestampMask;
+            auto gpuTime = std::chrono::nanoseconds(int64_t(double(ticksBefore) * latency.timestampPeriod));
+            PresentLatency::Clock::time_point completionTime =
+                    hostTimeToClock(calibration[1]) - std::chrono::duration_cast<PresentLatency::Clock::duration>(gpuTime);
+
+            std::lock_guard<std::mutex> lock(latency.mutex);
+            addSample(latency, frame.inputTime, completionTime);
+        }
+
+        frame.pending = false;
+    }
+
+    vkCmdResetQueryPool(commandBuffer, frame.queryPool, 0, 1);
+}
+
+void endPresentLatencyFrame(PresentLatency& latency, VkCommandBuffer commandBuffer, uint32_t frameIndex, PresentLatency::Clock::time_point inputTime)
+{
+    if (latency.source != PresentLatencySource::GpuCompletion)
+    {
+        return;
+    }
+
+    PresentLatency::FrameTimestamp& frame = latency.frames[frameIndex];
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.queryPool, 0);
+    frame.inputTime = inputTime;
+    frame.pending = true;
+}
+
+uint64_t nextPresentLatencyId(PresentLatency& latency)
+{
+    return latency.source == PresentLatencySource::PresentWait ? latency.nextPresentId++ : 0;
+}
+
+void trackPresentLatency(PresentLatency& latency, VkSwapchainKHR swapchain, uint64_t presentId, PresentLatency::Clock::time_point inputTime)
+{
+    if (!presentId)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(latency.mutex);
+    latency.pendingPresents.push_back({ swapchain, presentId, inputTime });
+    latency.changed.notify_all();
+}
+
+void forgetPresentLatencySwapchains(PresentLatency& latency, VkSwapchainKHR currentSwapchain)
+{
+    std::unique_lock<std::mutex> lock(latency.mutex);
+
+    auto isRetired = [&](const PresentLatency::PendingPresent& present) { return present.swapchain != currentSwapchain; };
+    latency.pendingPresents.erase(std::remove_if(latency.pendingPresents.begin(), latency.pendingPresents.end(), isRetired),
+                                  latency.pendingPresents.end());
+
+    // Bounded by the waiter's timeout
+    latency.changed.wait(lock, [&]() { return !latency.waitingSwapchain || latency.waitingSwapchain == currentSwapchain; });
+}
+
+float getPresentLatencyMilliseconds(PresentLatency& latency)
+{
+    std::lock_guard<std::mutex> lock(latency.mutex);
+    return latency.averageMilliseconds;
+}
+
+} // namespace Vulkan
+} // namespace GameSmith
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "gsvulkan.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gs
+{
+namespace vk
+{
+
+enum class PresentLatencySource
+{
+    None,
+    PresentWait,   // Input to the present being displayed, with VK_KHR_present_id and VK_KHR_present_wait
+    GpuCompletion, // Input to the GPU finishing the frame, with VK_EXT_calibrated_timestamps; excludes the wait for scan-out
+};
+
+// Measures the latency from sampling input to presenting the frame built from it. With present wait every present gets an id and a
+// waiter thread blocks in vkWaitForPresentKHR, so the time is taken as soon as the present has been displayed. Otherwise the frame's
+// command buffer ends with a timestamp that is read back when the frame slot comes round again and converted to host time with
+// calibrated timestamps. Either way the reading doesn't depend on when the CPU gets round to it, so frame limiter sleeps and fence
+// waits don't end up in the numbers.
+struct PresentLatency
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct PendingPresent
+    {
+        VkSwapchainKHR swapchain;
+        uint64_t presentId;
+        Clock::time_point inputTime;
+    };
+
+    struct FrameTimestamp
+    {
+        VkQueryPool queryPool;
+        Clock::time_point inputTime;
+        bool pending;
+    };
+
+    VkDevice device;
+    PresentLatencySource source;
+    float averageMilliseconds; // Guarded by mutex
+
+    // PresentWait
+    PFN_vkWaitForPresentKHR waitForPresent;
+    uint64_t nextPresentId;
+    std::deque<PendingPresent> pendingPresents;
+    VkSwapchainKHR waitingSwapchain; // Swapchain the waiter thread is blocked on, if any
+    bool quit;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::thread waiter;
+
+    // GpuCompletion
+    PFN_vkGetCalibratedTimestampsEXT getCalibratedTimestamps;
+    VkTimeDomainEXT hostTimeDomain;
+    float timestampPeriod; // Nanoseconds per tick
+    uint64_t timestampMask;
+    std::vector<FrameTimestamp> frames;
+};
+
+// Picks the best source the device supports; createDevice enables the extensions whenever they are available.
+void createPresentLatency(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex,
+                          uint32_t frameCount, PresentLatency& latency);
+void destroyPresentLatency(PresentLatency& latency);
+
+// Reads the last timestamp of this frame slot and resets it. Call once the frame's fence has been waited on, at the start of the
+// frame's command buffer and outside of a render pass.
+void beginPresentLatencyFrame(PresentLatency& latency, VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+// Ends the frame's command buffer with a timestamp for the input sampled at inputTime. Call last before ending the command buffer.
+void endPresentLatencyFrame(PresentLatency& latency, VkCommandBuffer commandBuffer, uint32_t frameIndex, PresentLatency::Clock::time_point inputTime);
+
+// Id to chain into the next present with VkPresentIdKHR, or 0 when presents aren't waited on, in which case nothing is chained.
+uint64_t nextPresentLatencyId(PresentLatency& latency);
+
+// Call once a present with presentId has been queued successfully.
+void trackPresentLatency(PresentLatency& latency, VkSwapchainKHR swapchain, uint64_t presentId, PresentLatency::Clock::time_point inputTime);
+
+// Stops waiting on presents of any swapchain but currentSwapchain, blocking until the waiter thread has returned from them. Call before
+// retired swapchains are released for destruction.
+void forgetPresentLatencySwapchains(PresentLatency& latency, VkSwapchainKHR currentSwapchain);
+
+float getPresentLatencyMilliseconds(PresentLatency& latency);
+
+} // namespace Vulkan
+} // namespace GameSmith
@@ -0,0 +1,106 @@
+#include "gspch.h"
+
+#include "queue_ownership.h"
+
+namespace gs
+{
+namespace vk
+{
+
+// The release only makes the source queue's writes available, and the acquire only makes them visible; the semaphore between the
+// two submissions provides the execution dependency
+static VkBufferMemoryBarrier bufferBarrier(const QueueOwnershipTransfer& transfer, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size,
+                                           bool release)
+{
+    bool sameFamily = transfer.srcQueueFamily == transfer.dstQueueFamily;
+
+    VkBufferMemoryBarrier barrier{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+    barrier.srcAccessMask = release || sameFamily ? transfer.srcAccessMask : 0;
+    barrier.dstAccessMask = release ? 0 : transfer.dstAccessMask;
+    barrier.srcQueueFamilyIndex = sameFamily ? VK_QUEUE_FAMILY_IGNORED : transfer.srcQueueFamily;
+    barrier.dstQueueFamilyIndex = sameFamily ? VK_QUEUE_FAMILY_IGNORED : transfer.dstQueueFamily;
+    barrier.buffer = buffer;
+    barrier.offset = offset;
+    barrier.size = size;
+    return barrier;
+}
+
+static VkImageMemoryBarrier imageBarrier(const QueueOwnershipTransfer& transfer, VkImage image, const VkImageSubresourceRange& range,
+                                         VkImageLayout oldLayout, VkImageLayout newLayout, bool release)
+{
+    bool sameFamily = transfer.srcQueueFamily == transfer.dstQueueFamily;
+
+    VkImageMemoryBarrier barrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    barrier.srcAccessMask = release || sameFamily ? transfer.srcAccessMask : 0;
+    barrier.dstAccessMask = release ? 0 : transfer.dstAccessMask;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = sameFamily ? VK_QUEUE_FAMILY_IGNORED : transfer.srcQueueFamily;
+    barrier.dstQueueFamilyIndex = sameFamily ? VK_QUEUE_FAMILY_IGNORED : transfer.dstQueueFamily;
+    barrier.image = image;
+    barrier.subresourceRange = range;
+    return barrier;
+}
+
+// Source and destination stages of the release or acquire half of the transfer. The half on the other queue is covered by the
+// semaphore, so it is left to the top or bottom of the pipe.
+static void barrierStages(const QueueOwnershipTransfer& transfer, bool release, VkPipelineStageFlags& srcStageMask,
+                          VkPipelineStageFlags& dstStageMask)
+{
+    bool sameFamily = transfer.srcQueueFamily == transfer.dstQueueFamily;
+    srcStageMask = release || sameFamily ? transfer.srcStageMask : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    dstStageMask = release ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : transfer.dstStageMask;
+}
+
+void releaseBufferOwnership(VkCommandBuffer commandBuffer, const QueueOwnershipTransfer& transfer, VkBuffer buffer, VkDeviceSize offset,
+                            VkDeviceSize size)
+{
+    if (transfer.srcQueueFamily == transfer.dstQueueFamily)
+    {
+        return;
+    }
+
+    VkPipelineStageFlags srcStageMask{};
+    VkPipelineStageFlags dstStageMask{};
+    barrierStages(transfer, true, srcStageMask, dstStageMask);
+    VkBufferMemoryBarrier barrier = bufferBarrier(transfer, buffer, offset, size, true);
+    vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void acquireBufferOwnership(VkCommandBuffer commandBuffer, const QueueOwnershipTransfer& transfer, VkBuffer buffer, VkDeviceSize offset,
+                            VkDeviceSize size)
+{
+    VkPipelineStageFlags srcStageMask{};
+    VkPipelineStageFlags dstStageMask{};
+    barrierStages(transfer, false, srcStageMask, dstStageMask);
+    VkBufferMemoryBarrier barrier = bufferBarrier(transfer, buffer, offset, size, false);
+    vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void releaseImageOwnership(VkCommandBuffer commandBuffer, const QueueOwnershipTransfer& transfer, VkImage image,
+                           const VkImageSubresourceRange& range, VkImageLayout oldLayout, VkImageLayout newLayout)
+{
+    if (transfer.srcQueueFamily == transfer.dstQueueFamily)
+    {
+        return;
+    }
+
+    VkPipelineStageFlags srcStageMask{};
+    VkPipelineStageFlags dstStageMask{};
+    barrierStages(transfer, true, srcStageMask, dstStageMask);
+    VkImageMemoryBarrier barrier = imageBarrier(transfer, image, range, oldLayout, newLayout, true);
+    vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void acquireImageOwnership(VkCommandBuffer commandBuffer, const QueueOwnershipTransfer& transfer, VkImage image,
+                           const VkImageSubresourceRange& range, VkImageLayout oldLayout, VkImageLayout newLayout)
+{
+    VkPipelineStageFlags srcStageMask{};
+    VkPipelineStageFlags dstStageMask{};
+    barrierStages(transfer, false, srcStageMask, dstStageMask);
+    VkImageMemoryBarrier barrier = imageBarrier(transfer, image, range, oldLayout, newLayout, false);
+    vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+} // namespace Vulkan
+} // namespace GameSmith
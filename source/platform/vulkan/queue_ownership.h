@@ -0,0 +1,40 @@
+#pragma once
+
+#include "gsvulkan.h"
+
+namespace gs
+{
+namespace vk
+{
+
+// Moves a resource created with exclusive sharing from one queue family to another, e.g. a buffer written by async compute or an
+// image filled on the transfer queue that is then read by graphics. The source queue records the release and the destination queue
+// the acquire, and the acquiring submission must wait on a semaphore signalled after the releasing one. Both sides are recorded from
+// the same description, as the barriers must match. Until the acquire, the destination queue must not touch the resource, and any
+// contents written before the release are kept.
+//
+// Between queues of the same family no transfer is needed: the release records nothing and the acquire a regular barrier from the
+// source to the destination scope, so code can use the helpers whether or not the device has dedicated queue families.
+struct QueueOwnershipTransfer
+{
+    uint32_t srcQueueFamily;
+    uint32_t dstQueueFamily;
+    VkPipelineStageFlags srcStageMask; // Last use on the source queue
+    VkAccessFlags srcAccessMask;
+    VkPipelineStageFlags dstStageMask; // First use on the destination queue
+    VkAccessFlags dstAccessMask;
+};
+
+void releaseBufferOwnership(VkCommandBuffer commandBuffer, const QueueOwnershipTransfer& transfer, VkBuffer buffer, VkDeviceSize offset = 0,
+                            VkDeviceSize size = VK_WHOLE_SIZE);
+void acquireBufferOwnership(VkCommandBuffer commandBuffer, const QueueOwnershipTransfer& transfer, VkBuffer buffer, VkDeviceSize offset = 0,
+                            VkDeviceSize size = VK_WHOLE_SIZE);
+
+// A layout transition in the transfer happens once, between the release and the acquire, and both sides must name the same layouts
+void releaseImageOwnership(VkCommandBuffer commandBuffer, const QueueOwnershipTransfer& transfer, VkImage image,
+                           const VkImageSubresourceRange& range, VkImageLayout oldLayout, VkImageLayout newLayout);
+void acquireImageOwnership(VkCommandBuffer commandBuffer, const QueueOwnershipTransfer& transfer, VkImage image,
+                           const VkImageSubresourceRange& range, VkImageLayout oldLayout, VkImageLayout newLayout);
+
+} // namespace Vulkan
+} // namespace GameSmith
@@ -0,0 +1,1007 @@
+#include "gspch.h"
+
+#include "render_graph.h"
+
+#include "buffer.h"
+#include "deletion_queue.h"
+#include "device.h"
+#include "gpu_profiler.h"
+#include "pipeline_statistics.h"
+
+#include "gamesmith/core/debug.h"
+#include "gamesmith/core/log.h"
+
+namespace gs
+{
+namespace vk
+{
+
+struct AccessInfo
+{
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    VkImageLayout layout;
+    VkImageUsageFlags usage;
+};
+
+static const VkAccessFlags kWriteAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                              VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+static AccessInfo getAccessInfo(RenderGraphAccess access)
+{
+    switch (access)
+    {
+        case RenderGraphAccess::ColorAttachment:
+        {
+            return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                     VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT };
+        }
+        case RenderGraphAccess::DepthAttachment:
+        {
+            return { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                     VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                     VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT };
+        }
+        case RenderGraphAccess::DepthAttachmentRead:
+        {
+            return { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                     VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                     VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT };
+        }
+        case RenderGraphAccess::FragmentShaderRead:
+        {
+            return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                     VK_IMAGE_USAGE_SAMPLED_BIT };
+        }
+        case RenderGraphAccess::ComputeShaderRead:
+        {
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                     VK_IMAGE_USAGE_SAMPLED_BIT };
+        }
+        case RenderGraphAccess::ComputeShaderWrite:
+        {
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL,
+                     VK_IMAGE_USAGE_STORAGE_BIT };
+        }
+        case RenderGraphAccess::TransferRead:
+        {
+            return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                     VK_IMAGE_USAGE_TRANSFER_SRC_BIT };
+        }
+        case RenderGraphAccess::TransferWrite:
+        {
+            return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     VK_IMAGE_USAGE_TRANSFER_DST_BIT };
+        }
+        case RenderGraphAccess::Present:
+        default:
+        {
+            return { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0 };
+        }
+    }
+}
+
+static bool isDepthFormat(VkFormat format)
+{
+    switch (format)
+    {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        {
+            return true;
+        }
+        default:
+        {
+            return false;
+        }
+    }
+}
+
+static VkImageMemoryBarrier imageBarrier(VkImage image, VkFormat format, VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+                                         VkImageLayout oldLayout, VkImageLayout newLayout)
+{
+    VkImageMemoryBarrier barrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = isDepthFormat(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+    barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+    return barrier;
+}
+
+// Render passes leave attachments in the layout they were used in; the graph's barriers handle every transition.
+static VkRenderPass getRenderPass(RenderGraph& graph, const std::vector<uint64_t>& key)
+{
+    auto it = graph.renderPasses.find(key);
+
+    if (it != graph.renderPasses.end())
+    {
+        return it->second;
+    }
+
+    // The key is (format, loadOp, storeOp) per attachment, depth last when the final entry is a depth format
+    std::vector<VkAttachmentDescription> attachments;
+    std::vector<VkAttachmentReference> colorReferences;
+    VkAttachmentReference depthReference{ VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED };
+
+    for (size_t i = 0; i < key.size(); i += 3)
+    {
+        VkAttachmentDescription attachment{};
+        attachment.format = VkFormat(key[i]);
+        attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        attachment.loadOp = VkAttachmentLoadOp(key[i + 1]);
+        attachment.storeOp = VkAttachmentStoreOp(key[i + 2]);
+        attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+        if (isDepthFormat(attachment.format))
+        {
+            attachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            depthReference = { uint32_t(attachments.size()), attachment.initialLayout };
+        }
+        else
+        {
+            attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            colorReferences.push_back({ uint32_t(attachments.size()), attachment.initialLayout });
+        }
+
+        attachment.finalLayout = attachment.initialLayout;
+        attachments.push_back(attachment);
+    }
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = uint32_t(colorReferences.size());
+    subpass.pColorAttachments = colorReferences.data();
+    subpass.pDepthStencilAttachment = depthReference.attachment != VK_ATTACHMENT_UNUSED ? &depthReference : nullptr;
+
+    VkRenderPassCreateInfo createInfo{ VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
+    createInfo.attachmentCount = uint32_t(attachments.size());
+    createInfo.pAttachments = attachments.data();
+    createInfo.subpassCount = 1;
+    createInfo.pSubpasses = &subpass;
+
+    VkRenderPass renderPass{};
+    VK_CHECK_RESULT(vkCreateRenderPass(graph.device, &createInfo, nullptr, &renderPass));
+    graph.renderPasses.emplace(key, renderPass);
+    return renderPass;
+}
+
+// Framebuffers are imageless, so one framebuffer serves every set of image views with the same formats, usage and extent; the views are
+// supplied when the render pass begins.
+static VkFramebuffer getFramebuffer(RenderGraph& graph, const RenderGraph::Pass& pass, const std::vector<VkImageUsageFlags>& usages)
+{
+    std::vector<uint64_t> key{ uint64_t(pass.renderPass), pass.extent.width, pass.extent.height };
+
+    for (VkImageUsageFlags usage : usages)
+    {
+        key.push_back(usage);
+    }
+
+    auto it = graph.framebuffers.find(key);
+
+    if (it != graph.framebuffers.end())
+    {
+        return it->second;
+    }
+
+    // No view format lists: neither the graph's images nor the swapchain images are created with one, and the lists would have to
+    // match. The render pass, which is part of the key, already fixes the formats.
+    std::vector<VkFramebufferAttachmentImageInfo> attachmentImageInfos(usages.size());
+
+    for (size_t i = 0; i < usages.size(); ++i)
+    {
+        VkFramebufferAttachmentImageInfo& imageInfo = attachmentImageInfos[i];
+        imageInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENT_IMAGE_INFO;
+        imageInfo.usage = usages[i];
+        imageInfo.width = pass.extent.width;
+        imageInfo.height = pass.extent.height;
+        imageInfo.layerCount = 1;
+        imageInfo.viewFormatCount = 0;
+        imageInfo.pViewFormats = nullptr;
+    }
+
+    VkFramebufferAttachmentsCreateInfo attachmentsCreateInfo{ VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENTS_CREATE_INFO };
+    attachmentsCreateInfo.attachmentImageInfoCount = uint32_t(attachmentImageInfos.size());
+    attachmentsCreateInfo.pAttachmentImageInfos = attachmentImageInfos.data();
+
+    VkFramebufferCreateInfo createInfo{ VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+    createInfo.pNext = &attachmentsCreateInfo;
+    createInfo.flags = VK_FRAMEBUFFER_CREATE_IMAGELESS_BIT;
+    createInfo.renderPass = pass.renderPass;
+    createInfo.attachmentCount = uint32_t(attachmentImageInfos.size());
+    createInfo.width = pass.extent.width;
+    createInfo.height = pass.extent.height;
+    createInfo.layers = 1;
+
+    VkFramebuffer framebuffer{};
+    VK_CHECK_RESULT(vkCreateFramebuffer(graph.device, &createInfo, nullptr, &framebuffer));
+    graph.framebuffers.emplace(std::move(key), framebuffer);
+    return framebuffer;
+}
+
+static void retireFramebuffers(RenderGraph& graph)
+{
+    for (auto& entry : graph.framebuffers)
+    {
+        deferDestroy(*graph.deletionQueue, entry.second);
+    }
+
+    graph.framebuffers.clear();
+}
+
+static void retireTransients(RenderGraph& graph)
+{
+    for (RenderGraph::PhysicalImage& physicalImage : graph.physicalImages)
+    {
+        deferDestroy(*graph.deletionQueue, physicalImage.view);
+        deferDestroy(*graph.deletionQueue, physicalImage.image);
+    }
+
+    for (RenderGraph::MemoryBlock& block : graph.memoryBlocks)
+    {
+        deferDestroy(*graph.deletionQueue, block.memory);
+    }
+
+    graph.physicalImages.clear();
+    graph.memoryBlocks.clear();
+}
+
+// Creates the transient images used by the live passes. Images whose lifetimes [firstPass, lastPass] don't overlap share a memory
+// block; blocks are assigned greedily in order of first use.
+static void allocateTransients(RenderGraph& graph, const std::vector<RenderGraph::Resource*>& transients)
+{
+    struct BlockPlan
+    {
+        VkMemoryRequirements requirements;
+        uint32_t lastPass;
+    };
+
+    std::vector<BlockPlan> blocks;
+    std::vector<uint32_t> order(transients.size());
+
+    for (uint32_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs) { return transients[lhs]->firstPass < transients[rhs]->firstPass; });
+    graph.physicalImages.resize(transients.size());
+
+    for (uint32_t i : order)
+    {
+        RenderGraph::Resource& resource = *transients[i];
+        RenderGraph::PhysicalImage& physicalImage = graph.physicalImages[i];
+        physicalImage.desc = resource.desc;
+        physicalImage.usage = resource.usage;
+        physicalImage.firstPass = resource.firstPass;
+        physicalImage.lastPass = resource.lastPass;
+
+        VkImageCreateInfo createInfo{ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+        createInfo.imageType = VK_IMAGE_TYPE_2D;
+        createInfo.format = resource.desc.format;
+        createInfo.extent = { resource.desc.extent.width, resource.desc.extent.height, 1 };
+        createInfo.mipLevels = 1;
+        createInfo.arrayLayers = 1;
+        createInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        createInfo.usage = resource.usage;
+        createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VK_CHECK_RESULT(vkCreateImage(graph.device, &createInfo, nullptr, &physicalImage.image));
+
+        VkMemoryRequirements requirements{};
+        vkGetImageMemoryRequirements(graph.device, physicalImage.image, &requirements);
+
+        uint32_t blockIndex = 0;
+
+        for (; blockIndex < blocks.size(); ++blockIndex)
+        {
+            BlockPlan& block = blocks[blockIndex];
+
+            if (block.lastPass < resource.firstPass && (block.requirements.memoryTypeBits & requirements.memoryTypeBits))
+            {
+                break;
+            }
+        }
+
+        if (blockIndex == blocks.size())
+        {
+            blocks.push_back({ requirements, resource.lastPass });
+        }
+        else
+        {
+            BlockPlan& block = blocks[blockIndex];
+            block.requirements.size = std::max(block.requirements.size, requirements.size);
+            block.requirements.alignment = std::max(block.requirements.alignment, requirements.alignment);
+            block.requirements.memoryTypeBits &= requirements.memoryTypeBits;
+            block.lastPass = resource.lastPass;
+        }
+
+        physicalImage.memoryBlock = blockIndex;
+    }
+
+    graph.memoryBlocks.resize(blocks.size());
+
+    for (size_t b = 0; b < blocks.size(); ++b)
+    {
+        VkMemoryAllocateInfo allocateInfo{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+        allocateInfo.allocationSize = blocks[b].requirements.size;
+        allocateInfo.memoryTypeIndex = getMemoryTypeIndex(graph.physicalDevice, blocks[b].requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        GS_ASSERT(allocateInfo.memoryTypeIndex != UINT32_MAX);
+
+        RenderGraph::MemoryBlock& block = graph.memoryBlocks[b];
+        VK_CHECK_RESULT(vkAllocateMemory(graph.device, &allocateInfo, nullptr, &block.memory));
+        block.lastStages = 0;
+        block.lastWriteAccess = 0;
+    }
+
+    for (RenderGraph::PhysicalImage& physicalImage : graph.physicalImages)
+    {
+        VK_CHECK_RESULT(vkBindImageMemory(graph.device, physicalImage.image, graph.memoryBlocks[physicalImage.memoryBlock].memory, 0));
+
+        VkImageViewCreateInfo viewCreateInfo{ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+        viewCreateInfo.image = physicalImage.image;
+        viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewCreateInfo.format = physicalImage.desc.format;
+        viewCreateInfo.subresourceRange.aspectMask = isDepthFormat(physicalImage.desc.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+        viewCreateInfo.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        viewCreateInfo.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+        VK_CHECK_RESULT(vkCreateImageView(graph.device, &viewCreateInfo, nullptr, &physicalImage.view));
+    }
+}
+
+void createRenderGraph(VkPhysicalDevice physicalDevice, VkDevice device, DeletionQueue& deletionQueue, bool allowDynamicRendering,
+                       RenderGraph& graph)
+{
+    graph.physicalDevice = physicalDevice;
+    graph.device = device;
+    graph.deletionQueue = &deletionQueue;
+
+    // createDevice enables dynamic rendering whenever it is supported
+    graph.dynamicRendering = allowDynamicRendering && isDynamicRenderingSupported(physicalDevice);
+
+    if (graph.dynamicRendering)
+    {
+        graph.cmdBeginRendering = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR");
+        graph.cmdEndRendering = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR");
+        GS_ASSERT(graph.cmdBeginRendering && graph.cmdEndRendering);
+    }
+
+    GS_INFO("Render graph uses %s.", graph.dynamicRendering ? "dynamic rendering" : "render passes and imageless framebuffers");
+}
+
+void destroyRenderGraph(RenderGraph& graph)
+{
+    retireFramebuffers(graph);
+    retireTransients(graph);
+
+    for (auto& entry : graph.renderPasses)
+    {
+        vkDestroyRenderPass(graph.device, entry.second, nullptr);
+    }
+
+    graph.renderPasses.clear();
+    graph.transientSignature.clear();
+    graph.passes.clear();
+    graph.resources.clear();
+}
+
+void beginRenderGraph(RenderGraph& graph)
+{
+    graph.passes.clear();
+    graph.resources.clear();
+    graph.finalBarriers.clear();
+}
+
+RenderGraphResource importRenderGraphImage(RenderGraph& graph, const char* name, VkImage image, VkImageView view, VkFormat format,
+                                           VkExtent2D extent, VkImageUsageFlags usage, VkImageLayout initialLayout, VkImageLayout finalLayout,
+                                           VkPipelineStageFlags initialStage)
+{
+    RenderGraph::Resource resource{};
+    resource.name = name;
+    resource.desc = { format, extent };
+    resource.imported = true;
+    resource.image = image;
+    resource.view = view;
+    resource.usage = usage;
+    resource.initialLayout = initialLayout;
+    resource.finalLayout = finalLayout;
+    resource.initialStage = initialStage;
+    graph.resources.push_back(resource);
+    return RenderGraphResource(graph.resources.size() - 1);
+}
+
+RenderGraphResource createRenderGraphImage(RenderGraph& graph, const char* name, VkFormat format, VkExtent2D extent)
+{
+    RenderGraph::Resource resource{};
+    resource.name = name;
+    resource.desc = { format, extent };
+    graph.resources.push_back(resource);
+    return RenderGraphResource(graph.resources.size() - 1);
+}
+
+uint32_t addRenderGraphPass(RenderGraph& graph, const char* name, RenderGraphPassType type, RenderGraphExecuteFunction execute)
+{
+    RenderGraph::Pass pass{};
+    pass.name = name;
+    pass.type = type;
+    pass.depthAttachment.resource = kInvalidRenderGraphResource;
+    pass.execute = std::move(execute);
+    graph.passes.push_back(std::move(pass));
+    return uint32_t(graph.passes.size() - 1);
+}
+
+void addColorAttachment(RenderGraph& graph, uint32_t pass, RenderGraphResource resource, VkAttachmentLoadOp loadOp, VkClearColorValue clearValue)
+{
+    GS_ASSERT(graph.passes[pass].type == RenderGraphPassType::Graphics);
+    RenderGraph::Attachment attachment{ resource, loadOp };
+    attachment.clearValue.color = clearValue;
+    graph.passes[pass].colorAttachments.push_back(attachment);
+    graph.passes[pass].accesses.push_back({ resource, RenderGraphAccess::ColorAttachment, loadOp == VK_ATTACHMENT_LOAD_OP_LOAD, true });
+}
+
+void setDepthAttachment(RenderGraph& graph, uint32_t pass, RenderGraphResource resource, VkAttachmentLoadOp loadOp,
+                        VkClearDepthStencilValue clearValue)
+{
+    GS_ASSERT(graph.passes[pass].type == RenderGraphPassType::Graphics);
+    RenderGraph::Attachment attachment{ resource, loadOp };
+    attachment.clearValue.depthStencil = clearValue;
+    graph.passes[pass].depthAttachment = attachment;
+    graph.passes[pass].accesses.push_back({ resource, RenderGraphAccess::DepthAttachment, loadOp == VK_ATTACHMENT_LOAD_OP_LOAD, true });
+}
+
+void readRenderGraphImage(RenderGraph& graph, uint32_t pass, RenderGraphResource resource, RenderGraphAccess access)
+{
+    graph.passes[pass].accesses.push_back({ resource, access, true, false });
+}
+
+void writeRenderGraphImage(RenderGraph& graph, uint32_t pass, RenderGraphResource resource, RenderGraphAccess access)
+{
+    graph.passes[pass].accesses.push_back({ resource, access, access == RenderGraphAccess::ComputeShaderWrite, true });
+}
+
+void setSecondaryCommandBuffers(RenderGraph& graph, uint32_t pass)
+{
+    graph.passes[pass].secondaryCommandBuffers = true;
+}
+
+void setRenderPassRequired(RenderGraph& graph, uint32_t pass)
+{
+    graph.passes[pass].renderPassRequired = true;
+}
+
+void setSideEffects(RenderGraph& graph, uint32_t pass)
+{
+    graph.passes[pass].sideEffects = true;
+}
+
+// Walks the passes backwards from the imported images that outlive the graph, keeping only the passes that contribute to them
+static void cullPasses(RenderGraph& graph)
+{
+    std::vector<bool> needed(graph.resources.size());
+
+    for (size_t r = 0; r < graph.resources.size(); ++r)
+    {
+        needed[r] = graph.resources[r].imported && graph.resources[r].finalLayout != VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+
+    for (size_t p = graph.passes.size(); p-- > 0;)
+    {
+        RenderGraph::Pass& pass = graph.passes[p];
+        bool live = pass.sideEffects;
+
+        for (const RenderGraph::Access& access : pass.accesses)
+        {
+            live = live || (access.write && needed[access.resource]);
+        }
+
+        pass.culled = !live;
+
+        if (!live)
+        {
+            continue;
+        }
+
+        // Contents overwritten here aren't needed from earlier passes, unless this pass reads them too
+        for (const RenderGraph::Access& access : pass.accesses)
+        {
+            if (access.write && !access.read)
+            {
+                needed[access.resource] = false;
+            }
+        }
+
+        for (const RenderGraph::Access& access : pass.accesses)
+        {
+            if (access.read)
+            {
+                needed[access.resource] = true;
+            }
+        }
+    }
+}
+
+void compileRenderGraph(RenderGraph& graph)
+{
+    cullPasses(graph);
+
+    // Lifetimes and usage of the resources over the live passes
+    for (RenderGraph::Resource& resource : graph.resources)
+    {
+        resource.firstPass = ~0u;
+        resource.lastPass = 0;
+        resource.usage = resource.imported ? resource.usage : 0;
+    }
+
+    for (uint32_t p = 0; p < graph.passes.size(); ++p)
+    {
+        if (graph.passes[p].culled)
+        {
+            continue;
+        }
+
+        for (const RenderGraph::Access& access : graph.passes[p].accesses)
+        {
+            RenderGraph::Resource& resource = graph.resources[access.resource];
+            resource.firstPass = std::min(resource.firstPass, p);
+            resource.lastPass = std::max(resource.lastPass, p);
+            VkImageUsageFlags usage = getAccessInfo(access.access).usage;
+            GS_ASSERT(!resource.imported || (resource.usage & usage) == usage);
+            resource.usage |= usage;
+        }
+    }
+
+    // Transient images are only recreated when their descriptions or lifetimes change
+    std::vector<RenderGraph::Resource*> transients;
+    std::vector<uint64_t> signature;
+
+    for (RenderGraph::Resource& resource : graph.resources)
+    {
+        if (!resource.imported && resource.firstPass != ~0u)
+        {
+            resource.physicalIndex = uint32_t(transients.size());
+            transients.push_back(&resource);
+            signature.insert(signature.end(), { uint64_t(resource.desc.format), resource.desc.extent.width, resource.desc.extent.height,
+                                                resource.usage, resource.firstPass, resource.lastPass });
+        }
+    }
+
+    if (signature != graph.transientSignature)
+    {
+        retireFramebuffers(graph);
+        retireTransients(graph);
+        allocateTransients(graph, transients);
+        graph.transientSignature = std::move(signature);
+    }
+
+    for (RenderGraph::Resource* resource : transients)
+    {
+        resource->image = graph.physicalImages[resource->physicalIndex].image;
+        resource->view = graph.physicalImages[resource->physicalIndex].view;
+    }
+
+    // Simulate the accesses in order to find the barriers each pass needs
+    struct ResourceState
+    {
+        bool used;
+        VkImageLayout layout;
+        VkPipelineStageFlags writeStages;
+        VkAccessFlags writeAccess;
+        VkPipelineStageFlags readStages;   // Stages that have read since the last write
+        VkPipelineStageFlags visibleStages; // Stages and accesses the last write has been made visible to
+        VkAccessFlags visibleAccess;
+    };
+
+    std::vector<ResourceState> states(graph.resources.size());
+
+    for (RenderGraph::Pass& pass : graph.passes)
+    {
+        pass.barriers.clear();
+        pass.srcStageMask = 0;
+        pass.dstStageMask = 0;
+
+        if (pass.culled)
+        {
+            continue;
+        }
+
+        for (const RenderGraph::Access& access : pass.accesses)
+        {
+            RenderGraph::Resource& resource = graph.resources[access.resource];
+            ResourceState& state = states[access.resource];
+            AccessInfo info = getAccessInfo(access.access);
+            VkAccessFlags writeAccess = access.write ? (info.access & kWriteAccessMask) : 0;
+
+            if (!state.used)
+            {
+                state.used = true;
+                VkPipelineStageFlags srcStages{};
+                VkAccessFlags srcAccess{};
+                VkImageLayout oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+                if (resource.imported)
+                {
+                    srcStages = resource.initialStage ? resource.initialStage : info.stages;
+                    oldLayout = resource.initialLayout;
+                }
+                else
+                {
+                    // First use of a transient this frame; wait for whatever last used its memory, possibly in an earlier frame
+                    RenderGraph::MemoryBlock& block = graph.memoryBlocks[graph.physicalImages[resource.physicalIndex].memoryBlock];
+                    srcStages = block.lastStages;
+                    srcAccess = block.lastWriteAccess;
+                    block.lastStages = 0;
+                    block.lastWriteAccess = 0;
+                }
+
+                if (oldLayout != info.layout || !resource.imported)
+                {
+                    pass.barriers.push_back(imageBarrier(resource.image, resource.desc.format, srcAccess, info.access, oldLayout, info.layout));
+                    pass.srcStageMask |= srcStages;
+                    pass.dstStageMask |= info.stages;
+                }
+
+                state.layout = info.layout;
+                state.writeStages = access.write ? info.stages : 0;
+                state.writeAccess = writeAccess;
+                state.readStages = access.write ? 0 : info.stages;
+                state.visibleStages = info.stages;
+                state.visibleAccess = info.access;
+            }
+            else
+            {
+                bool layoutChange = state.layout != info.layout;
+                bool visible = (state.visibleStages & info.stages) == info.stages && (state.visibleAccess & info.access) == info.access;
+                bool hazard = access.write ? (state.writeStages || state.readStages) : (state.writeStages && !visible);
+
+                if (layoutChange || hazard)
+                {
+                    pass.barriers.push_back(
+                            imageBarrier(resource.image, resource.desc.format, state.writeAccess, info.access, state.layout, info.layout));
+                    pass.srcStageMask |= state.writeStages | state.readStages;
+                    pass.dstStageMask |= info.stages;
+                }
+
+                if (access.write || layoutChange)
+                {
+                    // A layout transition counts as a write that later readers in other stages have to wait for
+                    state.writeStages = info.stages;
+                    state.writeAccess = writeAccess;
+                    state.readStages = 0;
+                    state.visibleStages = info.stages;
+                    state.visibleAccess = info.access;
+                }
+                else
+                {
+                    state.visibleStages |= hazard ? info.stages : 0;
+                    state.visibleAccess |= hazard ? info.access : 0;
+                }
+
+                if (!access.write)
+                {
+                    state.readStages |= info.stages;
+                }
+
+                state.layout = info.layout;
+            }
+
+            if (!resource.imported)
+            {
+                RenderGraph::MemoryBlock& block = graph.memoryBlocks[graph.physicalImages[resource.physicalIndex].memoryBlock];
+                block.lastStages |= info.stages;
+                block.lastWriteAccess |= writeAccess;
+            }
+        }
+
+        if (pass.srcStageMask == 0 && !pass.barriers.empty())
+        {
+            pass.srcStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        }
+
+        if (pass.type != RenderGraphPassType::Graphics)
+        {
+            continue;
+        }
+
+        // Attachments are stored only if a later live pass or the outside world sees them
+        uint32_t passIndex = uint32_t(&pass - graph.passes.data());
+        std::vector<uint64_t> key;
+        std::vector<VkImageUsageFlags> usages;
+        pass.dynamicRendering = graph.dynamicRendering && !pass.renderPassRequired;
+        pass.colorFormats.clear();
+        pass.depthFormat = VK_FORMAT_UNDEFINED;
+        pass.storeOps.clear();
+        pass.views.clear();
+        pass.renderPass = VK_NULL_HANDLE;
+        pass.framebuffer = VK_NULL_HANDLE;
+
+        auto addAttachment = [&](const RenderGraph::Attachment& attachment) {
+            const RenderGraph::Resource& resource = graph.resources[attachment.resource];
+            bool exported = resource.imported && resource.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED;
+            bool store = exported || resource.lastPass > passIndex;
+            VkAttachmentStoreOp storeOp = store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            key.insert(key.end(), { uint64_t(resource.desc.format), uint64_t(attachment.loadOp), uint64_t(storeOp) });
+            usages.push_back(resource.usage);
+            pass.storeOps.push_back(storeOp);
+            pass.views.push_back(resource.view);
+            pass.extent = resource.desc.extent;
+        };
+
+        for (const RenderGraph::Attachment& attachment : pass.colorAttachments)
+        {
+            addAttachment(attachment);
+            pass.colorFormats.push_back(graph.resources[attachment.resource].desc.format);
+        }
+
+        if (pass.depthAttachment.resource != kInvalidRenderGraphResource)
+        {
+            addAttachment(pass.depthAttachment);
+            pass.depthFormat = graph.resources[pass.depthAttachment.resource].desc.format;
+        }
+
+        if (!pass.dynamicRendering)
+        {
+            pass.renderPass = getRenderPass(graph, key);
+            pass.framebuffer = getFramebuffer(graph, pass, usages);
+        }
+    }
+
+    // Hand imported images back in the layout their owner expects
+    graph.finalSrcStageMask = 0;
+
+    for (size_t r = 0; r < graph.resources.size(); ++r)
+    {
+        RenderGraph::Resource& resource = graph.resources[r];
+        ResourceState& state = states[r];
+
+        if (!resource.imported || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || !state.used || state.layout == resource.finalLayout)
+        {
+            continue;
+        }
+
+        graph.finalBarriers.push_back(imageBarrier(resource.image, resource.desc.format, state.writeAccess, 0, state.layout, resource.finalLayout));
+        graph.finalSrcStageMask |= state.writeStages | state.readStages;
+    }
+}
+
+static void beginGraphicsPass(const RenderGraph& graph, const RenderGraph::Pass& pass, VkCommandBuffer commandBuffer)
+{
+    std::vector<VkClearValue> clearValues;
+
+    for (const RenderGraph::Attachment& attachment : pass.colorAttachments)
+    {
+        clearValues.push_back(attachment.clearValue);
+    }
+
+    if (pass.depthAttachment.resource != kInvalidRenderGraphResource)
+    {
+        clearValues.push_back(pass.depthAttachment.clearValue);
+    }
+
+    if (!pass.dynamicRendering)
+    {
+        VkRenderPassAttachmentBeginInfo attachmentBeginInfo{ VK_STRUCTURE_TYPE_RENDER_PASS_ATTACHMENT_BEGIN_INFO };
+        attachmentBeginInfo.attachmentCount = uint32_t(pass.views.size());
+        attachmentBeginInfo.pAttachments = pass.views.data();
+
+        VkRenderPassBeginInfo beginInfo{ VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+        beginInfo.pNext = &attachmentBeginInfo;
+        beginInfo.renderPass = pass.renderPass;
+        beginInfo.framebuffer = pass.framebuffer;
+        beginInfo.renderArea.extent = pass.extent;
+        beginInfo.clearValueCount = uint32_t(clearValues.size());
+        beginInfo.pClearValues = clearValues.data();
+        vkCmdBeginRenderPass(commandBuffer, &beginInfo,
+                             pass.secondaryCommandBuffers ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+        return;
+    }
+
+    std::vector<VkRenderingAttachmentInfoKHR> attachments(pass.views.size());
+
+    for (size_t i = 0; i < attachments.size(); ++i)
+    {
+        bool depth = i == pass.colorAttachments.size();
+        const RenderGraph::Attachment& attachment = depth ? pass.depthAttachment : pass.colorAttachments[i];
+        VkRenderingAttachmentInfoKHR& info = attachments[i];
+        info.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        info.imageView = pass.views[i];
+        info.imageLayout = depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        info.loadOp = attachment.loadOp;
+        info.storeOp = pass.storeOps[i];
+        info.clearValue = clearValues[i];
+    }
+
+    VkRenderingInfoKHR renderingInfo{ VK_STRUCTURE_TYPE_RENDERING_INFO_KHR };
+    renderingInfo.flags = pass.secondaryCommandBuffers ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR : 0;
+    renderingInfo.renderArea.extent = pass.extent;
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = uint32_t(pass.colorAttachments.size());
+    renderingInfo.pColorAttachments = attachments.data();
+    renderingInfo.pDepthAttachment = pass.depthFormat != VK_FORMAT_UNDEFINED ? &attachments.back() : nullptr;
+    graph.cmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+void executeRenderGraph(RenderGraph& graph, VkCommandBuffer commandBuffer, GpuProfiler* profiler, PipelineStatisticsQueries* statistics)
+{
+    for (RenderGraph::Pass& pass : graph.passes)
+    {
+        if (pass.culled)
+        {
+            continue;
+        }
+
+        if (!pass.barriers.empty())
+        {
+            vkCmdPipelineBarrier(commandBuffer, pass.srcStageMask, pass.dstStageMask, 0, 0, nullptr, 0, nullptr, uint32_t(pass.barriers.size()),
+                                 pass.barriers.data());
+        }
+
+        if (profiler)
+        {
+            beginGpuScope(*profiler, commandBuffer, pass.name.c_str());
+        }
+
+        if (statistics && pass.type != RenderGraphPassType::Transfer)
+        {
+            bool compute = pass.type == RenderGraphPassType::Compute;
+            beginPipelineStatisticsPass(*statistics, commandBuffer, pass.name.c_str(), compute, pass.secondaryCommandBuffers);
+        }
+
+        RenderGraphPassContext context{};
+        context.graph = &graph;
+        context.pass = &pass;
+
+        if (pass.type == RenderGraphPassType::Graphics)
+        {
+            context.renderPass = pass.renderPass;
+            context.framebuffer = pass.framebuffer;
+            context.extent = pass.extent;
+            beginGraphicsPass(graph, pass, commandBuffer);
+        }
+
+        pass.execute(commandBuffer, context);
+
+        if (pass.type == RenderGraphPassType::Graphics)
+        {
+            if (pass.dynamicRendering)
+            {
+                graph.cmdEndRendering(commandBuffer);
+            }
+            else
+            {
+                vkCmdEndRenderPass(commandBuffer);
+            }
+        }
+
+        if (statistics && pass.type != RenderGraphPassType::Transfer)
+        {
+            endPipelineStatisticsPass(*statistics, commandBuffer);
+        }
+
+        if (profiler)
+        {
+            endGpuScope(*profiler, commandBuffer);
+        }
+    }
+
+    if (!graph.finalBarriers.empty())
+    {
+        vkCmdPipelineBarrier(commandBuffer, graph.finalSrcStageMask, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr,
+                             uint32_t(graph.finalBarriers.size()), graph.finalBarriers.data());
+    }
+}
+
+VkImage getRenderGraphImage(const RenderGraph& graph, RenderGraphResource resource)
+{
+    return graph.resources[resource].image;
+}
+
+VkImageView getRenderGraphImageView(const RenderGraph& graph, RenderGraphResource resource)
+{
+    return graph.resources[resource].view;
+}
+
+VkPipelineStageFlags getRenderGraphFirstUseStage(const RenderGraph& graph, RenderGraphResource resource)
+{
+    const RenderGraph::Resource& graphResource = graph.resources[resource];
+
+    if (graphResource.firstPass == ~0u)
+    {
+        return VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    }
+
+    for (const RenderGraph::Access& access : graph.passes[graphResource.firstPass].accesses)
+    {
+        if (access.resource == resource)
+        {
+            return getAccessInfo(access.access).stages;
+        }
+    }
+
+    return VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+}
+
+static VkRenderPass getCompatibleRenderPass(RenderGraph& graph, uint32_t colorFormatCount, const VkFormat* colorFormats, VkFormat depthFormat)
+{
+    // Load and store ops don't affect render pass compatibility
+    std::vector<uint64_t> key;
+
+    for (uint32_t i = 0; i < colorFormatCount; ++i)
+    {
+        key.insert(key.end(), { uint64_t(colorFormats[i]), uint64_t(VK_ATTACHMENT_LOAD_OP_DONT_CARE), uint64_t(VK_ATTACHMENT_STORE_OP_STORE) });
+    }
+
+    if (depthFormat != VK_FORMAT_UNDEFINED)
+    {
+        key.insert(key.end(), { uint64_t(depthFormat), uint64_t(VK_ATTACHMENT_LOAD_OP_DONT_CARE), uint64_t(VK_ATTACHMENT_STORE_OP_DONT_CARE) });
+    }
+
+    return getRenderPass(graph, key);
+}
+
+VkRenderPass getCompatibleRenderPass(RenderGraph& graph, std::initializer_list<VkFormat> colorFormats, VkFormat depthFormat)
+{
+    return getCompatibleRenderPass(graph, uint32_t(colorFormats.size()), colorFormats.begin(), depthFormat);
+}
+
+void setPipelineRenderingInfo(RenderGraph& graph, uint32_t colorFormatCount, const VkFormat* colorFormats, VkFormat depthFormat,
+                              VkGraphicsPipelineCreateInfo& createInfo, VkPipelineRenderingCreateInfoKHR& renderingInfo)
+{
+    if (!graph.dynamicRendering)
+    {
+        createInfo.renderPass = getCompatibleRenderPass(graph, colorFormatCount, colorFormats, depthFormat);
+        return;
+    }
+
+    renderingInfo = { VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR };
+    renderingInfo.pNext = createInfo.pNext;
+    renderingInfo.colorAttachmentCount = colorFormatCount;
+    renderingInfo.pColorAttachmentFormats = colorFormats;
+    renderingInfo.depthAttachmentFormat = depthFormat;
+    createInfo.pNext = &renderingInfo;
+    createInfo.renderPass = VK_NULL_HANDLE;
+}
+
+void setRenderGraphInheritance(const RenderGraphPassContext& context, const PipelineStatisticsQueries* statistics,
+                               VkCommandBufferInheritanceInfo& inheritanceInfo, VkCommandBufferInheritanceRenderingInfoKHR& renderingInfo)
+{
+    const RenderGraph::Pass& pass = *context.pass;
+    GS_ASSERT(pass.type == RenderGraphPassType::Graphics && pass.secondaryCommandBuffers);
+
+    if (statistics)
+    {
+        setInheritedQueries(*statistics, inheritanceInfo);
+    }
+
+    if (!pass.dynamicRendering)
+    {
+        inheritanceInfo.renderPass = pass.renderPass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = pass.framebuffer;
+        return;
+    }
+
+    renderingInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR };
+    renderingInfo.pNext = inheritanceInfo.pNext;
+    renderingInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR;
+    renderingInfo.colorAttachmentCount = uint32_t(pass.colorFormats.size());
+    renderingInfo.pColorAttachmentFormats = pass.colorFormats.data();
+    renderingInfo.depthAttachmentFormat = pass.depthFormat;
+    renderingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    inheritanceInfo.pNext = &renderingInfo;
+    inheritanceInfo.renderPass = VK_NULL_HANDLE;
+    inheritanceInfo.framebuffer = VK_NULL_HANDLE;
+}
+
+} // namespace Vulkan
+} // namespace GameSmith
@@ -0,0 +1,231 @@
+#pragma once
+
+#include "gsvulkan.h"
+
+#include <functional>
+#include <map>
+
+namespace gs
+{
+namespace vk
+{
+
+struct DeletionQueue;
+struct GpuProfiler;
+struct PipelineStatisticsQueries;
+
+using RenderGraphResource = uint32_t;
+static constexpr RenderGraphResource kInvalidRenderGraphResource = ~0u;
+
+enum class RenderGraphAccess
+{
+    ColorAttachment,
+    DepthAttachment,
+    DepthAttachmentRead,
+    FragmentShaderRead,
+    ComputeShaderRead,
+    ComputeShaderWrite,
+    TransferRead,
+    TransferWrite,
+    Present,
+};
+
+enum class RenderGraphPassType
+{
+    Graphics, // The graph begins a render pass over the pass's attachments around its execute callback
+    Compute,
+    Transfer,
+};
+
+struct RenderGraphPassContext;
+
+using RenderGraphExecuteFunction = std::function<void(VkCommandBuffer commandBuffer, const RenderGraphPassContext& context)>;
+
+// A frame's GPU work declared as passes that read and write images. The graph is declared afresh every frame; compiling it culls
+// passes whose results are never used, works out the layout transitions and barriers between passes, and places transient images in
+// memory shared with other transients whose lifetimes don't overlap. Physical images, render passes and framebuffers persist between
+// frames and are only recreated when the declared resources change; replaced objects are released to the deletion queue.
+struct RenderGraph
+{
+    struct ImageDesc
+    {
+        VkFormat format;
+        VkExtent2D extent;
+    };
+
+    struct Attachment
+    {
+        RenderGraphResource resource;
+        VkAttachmentLoadOp loadOp;
+        VkClearValue clearValue;
+    };
+
+    struct Access
+    {
+        RenderGraphResource resource;
+        RenderGraphAccess access;
+        bool read;
+        bool write;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        RenderGraphPassType type;
+        bool secondaryCommandBuffers;
+        bool sideEffects;
+        std::vector<Attachment> colorAttachments;
+        Attachment depthAttachment;
+        bool renderPassRequired;
+        std::vector<Access> accesses; // Includes the attachments once compiled
+        RenderGraphExecuteFunction execute;
+
+        // Compiled state
+        bool culled;
+        std::vector<VkImageMemoryBarrier> barriers;
+        VkPipelineStageFlags srcStageMask;
+        VkPipelineStageFlags dstStageMask;
+        bool dynamicRendering;
+        std::vector<VkFormat> colorFormats;
+        VkFormat depthFormat;
+        std::vector<VkAttachmentStoreOp> storeOps; // Color attachments, then depth
+        std::vector<VkImageView> views;            // Color attachments, then depth
+        VkExtent2D extent;
+        VkRenderPass renderPass;   // Render pass path only
+        VkFramebuffer framebuffer; // Imageless, render pass path only
+    };
+
+    struct Resource
+    {
+        std::string name;
+        ImageDesc desc;
+        bool imported;
+        VkImage image;
+        VkImageView view;
+        VkImageLayout initialLayout; // Imported images only
+        VkImageLayout finalLayout;   // Imported images only; VK_IMAGE_LAYOUT_UNDEFINED leaves the image in its last layout
+        VkPipelineStageFlags initialStage;
+        VkImageUsageFlags usage; // What the image was created with, for imported images; what the passes need, for transients
+        uint32_t firstPass;
+        uint32_t lastPass;
+        uint32_t physicalIndex; // Transient images only
+    };
+
+    // A transient image and the memory block it is bound to
+    struct PhysicalImage
+    {
+        ImageDesc desc;
+        VkImageUsageFlags usage;
+        uint32_t firstPass;
+        uint32_t lastPass;
+        VkImage image;
+        VkImageView view;
+        uint32_t memoryBlock;
+    };
+
+    // Aliased memory remembers the last access to it across frames so the next user, this frame or next, can wait for it
+    struct MemoryBlock
+    {
+        VkDeviceMemory memory;
+        VkPipelineStageFlags lastStages;
+        VkAccessFlags lastWriteAccess;
+    };
+
+    VkPhysicalDevice physicalDevice;
+    VkDevice device;
+    DeletionQueue* deletionQueue;
+
+    // Graphics passes begin rendering with vkCmdBeginRenderingKHR when the device supports dynamic rendering, and otherwise with
+    // cached render passes and imageless framebuffers, which are keyed by attachment formats, usage and extent rather than image views.
+    bool dynamicRendering;
+    PFN_vkCmdBeginRenderingKHR cmdBeginRendering;
+    PFN_vkCmdEndRenderingKHR cmdEndRendering;
+
+    std::vector<Pass> passes;
+    std::vector<Resource> resources;
+    std::vector<VkImageMemoryBarrier> finalBarriers;
+    VkPipelineStageFlags finalSrcStageMask;
+
+    std::vector<uint64_t> transientSignature;
+    std::vector<PhysicalImage> physicalImages;
+    std::vector<MemoryBlock> memoryBlocks;
+    std::map<std::vector<uint64_t>, VkRenderPass> renderPasses;
+    std::map<std::vector<uint64_t>, VkFramebuffer> framebuffers;
+};
+
+struct RenderGraphPassContext
+{
+    const RenderGraph* graph;
+    const RenderGraph::Pass* pass;
+    VkRenderPass renderPass;   // Graphics passes using the render pass path only
+    VkFramebuffer framebuffer; // Graphics passes using the render pass path only
+    VkExtent2D extent;         // Graphics passes only
+};
+
+// Dynamic rendering is used when allowed and supported by the device.
+void createRenderGraph(VkPhysicalDevice physicalDevice, VkDevice device, DeletionQueue& deletionQueue, bool allowDynamicRendering,
+                       RenderGraph& graph);
+
+// Images and framebuffers are released to the deletion queue, which must outlive the graph.
+void destroyRenderGraph(RenderGraph& graph);
+
+// Starts declaring a new frame.
+void beginRenderGraph(RenderGraph& graph);
+
+// Imported images are owned outside the graph. They start the frame in initialLayout (VK_IMAGE_LAYOUT_UNDEFINED discards their contents)
+// and are transitioned to finalLayout at the end of the graph; writing to an imported image with a final layout keeps its producers
+// alive. initialStage is the stage at which any semaphore guarding the image's availability is waited on; 0 waits at the image's first
+// use, see getRenderGraphFirstUseStage.
+RenderGraphResource importRenderGraphImage(RenderGraph& graph, const char* name, VkImage image, VkImageView view, VkFormat format,
+                                           VkExtent2D extent, VkImageUsageFlags usage, VkImageLayout initialLayout, VkImageLayout finalLayout,
+                                           VkPipelineStageFlags initialStage);
+
+// Transient images are owned by the graph; their contents don't survive between frames.
+RenderGraphResource createRenderGraphImage(RenderGraph& graph, const char* name, VkFormat format, VkExtent2D extent);
+
+uint32_t addRenderGraphPass(RenderGraph& graph, const char* name, RenderGraphPassType type, RenderGraphExecuteFunction execute);
+void addColorAttachment(RenderGraph& graph, uint32_t pass, RenderGraphResource resource, VkAttachmentLoadOp loadOp,
+                        VkClearColorValue clearValue = {});
+void setDepthAttachment(RenderGraph& graph, uint32_t pass, RenderGraphResource resource, VkAttachmentLoadOp loadOp,
+                        VkClearDepthStencilValue clearValue = {});
+void readRenderGraphImage(RenderGraph& graph, uint32_t pass, RenderGraphResource resource, RenderGraphAccess access);
+void writeRenderGraphImage(RenderGraph& graph, uint32_t pass, RenderGraphResource resource, RenderGraphAccess access);
+
+// The pass records its draws into secondary command buffers executed inside the graph's render pass.
+void setSecondaryCommandBuffers(RenderGraph& graph, uint32_t pass);
+
+// The pass draws with pipelines created against a render pass, e.g. by a library without dynamic rendering support, so it is never
+// recorded with dynamic rendering.
+void setRenderPassRequired(RenderGraph& graph, uint32_t pass);
+
+// Keeps the pass even if nothing reads what it writes.
+void setSideEffects(RenderGraph& graph, uint32_t pass);
+
+void compileRenderGraph(RenderGraph& graph);
+
+// Records every live pass with its barriers. Passes are timed and measured when a profiler and statistics queries are given.
+void executeRenderGraph(RenderGraph& graph, VkCommandBuffer commandBuffer, GpuProfiler* profiler = nullptr,
+                        PipelineStatisticsQueries* statistics = nullptr);
+
+VkImage getRenderGraphImage(const RenderGraph& graph, RenderGraphResource resource);
+VkImageView getRenderGraphImageView(const RenderGraph& graph, RenderGraphResource resource);
+
+// Stage of the first access to a resource in the compiled graph, e.g. for waiting on the swapchain acquire semaphore.
+VkPipelineStageFlags getRenderGraphFirstUseStage(const RenderGraph& graph, RenderGraphResource resource);
+
+// A render pass compatible with the graph's render pass path for these attachment formats, for passes that require one. depthFormat
+// may be VK_FORMAT_UNDEFINED.
+VkRenderPass getCompatibleRenderPass(RenderGraph& graph, std::initializer_list<VkFormat> colorFormats, VkFormat depthFormat);
+
+// Sets up a graphics pipeline to render to these attachment formats in graph passes: chains renderingInfo into createInfo with dynamic
+// rendering, and sets a compatible render pass otherwise. colorFormats must stay valid until the pipeline has been created.
+void setPipelineRenderingInfo(RenderGraph& graph, uint32_t colorFormatCount, const VkFormat* colorFormats, VkFormat depthFormat,
+                              VkGraphicsPipelineCreateInfo& createInfo, VkPipelineRenderingCreateInfoKHR& renderingInfo);
+
+// Fills in the inheritance state of secondary command buffers executed inside a graphics pass, including any active pipeline
+// statistics queries. renderingInfo is chained into inheritanceInfo with dynamic rendering.
+void setRenderGraphInheritance(const RenderGraphPassContext& context, const PipelineStatisticsQueries* statistics,
+                               VkCommandBufferInheritanceInfo& inheritanceInfo, VkCommandBufferInheritanceRenderingInfoKHR& renderingInfo);
+
+} // namespace Vulkan
+} // namespace GameSmith
@@ -4,6 +4,7 @@
 
 #include "renderer_vk.h"
 #include "gamesmith/core/debug.h"
+#include "gamesmith/core/log.h"
 
 #include <spirv-headers/spirv.h>
 
@@ -12,6 +13,29 @@ namespace gs
 namespace vk
 {
 
+// Everything the reflection pass needs to know about a single SPIR-V id
+struct SpirvId
+{
+    SpvOp opcode;
+    uint32_t typeId;         // Result type for variables/constants, element/pointee/component type for types
+    uint32_t storageClass;   // Variables and pointers
+    uint32_t width;          // OpTypeInt / OpTypeFloat
+    uint32_t componentCount; // OpTypeVector / OpTypeMatrix column count
+    uint32_t constant;       // Low word of OpConstant, array length id for OpTypeArray
+    uint32_t dim;            // OpTypeImage
+    uint32_t sampled;        // OpTypeImage
+    uint32_t set = ~0u;
+    uint32_t binding = ~0u;
+    uint32_t location = ~0u;
+    uint32_t specId = ~0u;
+    uint32_t arrayStride;
+    bool builtIn;
+    bool bufferBlock;
+    std::vector<uint32_t> members;
+    std::vector<uint32_t> memberOffsets;
+    std::vector<uint32_t> memberMatrixStrides;
+};
+
 VkShaderStageFlagBits ShaderStage(SpvExecutionModel executionModel)
 {
     switch (executionModel)
@@ -24,6 +48,10 @@ VkShaderStageFlagBits ShaderStage(SpvExecutionModel executionModel)
         {
             return VK_SHADER_STAGE_FRAGMENT_BIT;
         }
+        case SpvExecutionModelGLCompute:
+        {
+            return VK_SHADER_STAGE_COMPUTE_BIT;
+        }
         default:
         {
             GS_ASSERT(!"Unsupported execution model");
@@ -32,30 +60,440 @@ VkShaderStageFlagBits ShaderStage(SpvExecutionModel executionModel)
     }
 }
 
+// Fewest words, opcode included, of each instruction the parser reads operands from
+static uint32_t minimumWordCount(SpvOp opcode)
+{
+    switch (opcode)
+    {
+        case SpvOpTypeBool:
+        case SpvOpTypeSampler:
+        case SpvOpTypeStruct:
+        {
+            return 2;
+        }
+        case SpvOpDecorate:
+        case SpvOpTypeFloat:
+        case SpvOpTypeSampledImage:
+        case SpvOpTypeRuntimeArray:
+        case SpvOpSpecConstantTrue:
+        case SpvOpSpecConstantFalse:
+        {
+            return 3;
+        }
+        case SpvOpEntryPoint:
+        case SpvOpMemberDecorate:
+        case SpvOpTypeInt:
+        case SpvOpTypeVector:
+        case SpvOpTypeMatrix:
+        case SpvOpTypeArray:
+        case SpvOpTypePointer:
+        case SpvOpConstant:
+        case SpvOpSpecConstant:
+        case SpvOpVariable:
+        {
+            return 4;
+        }
+        case SpvOpTypeImage:
+        {
+            return 9;
+        }
+        default:
+        {
+            return 1;
+        }
+    }
+}
+
+// Literal operands following the decoration of an OpDecorate or OpMemberDecorate, for the decorations the parser reads
+static uint32_t decorationLiteralCount(uint32_t decoration)
+{
+    switch (decoration)
+    {
+        case SpvDecorationDescriptorSet:
+        case SpvDecorationBinding:
+        case SpvDecorationLocation:
+        case SpvDecorationSpecId:
+        case SpvDecorationArrayStride:
+        case SpvDecorationOffset:
+        case SpvDecorationMatrixStride:
+        case SpvDecorationBuiltIn:
+        {
+            return 1;
+        }
+        default:
+        {
+            return 0;
+        }
+    }
+}
+
+static void setMemberDecoration(std::vector<uint32_t>& values, uint32_t member, uint32_t value)
+{
+    if (values.size() <= member)
+    {
+        values.resize(member + 1);
+    }
+
+    values[member] = value;
+}
+
+// Size in bytes of a type laid out with explicit offsets/strides, as used for push constant blocks
+static uint32_t typeSize(const std::vector<SpirvId>& ids, uint32_t typeId, uint32_t matrixStride = 0)
+{
+    const SpirvId& type = ids[typeId];
+
+    switch (type.opcode)
+    {
+        case SpvOpTypeBool:
+        case SpvOpTypeInt:
+        case SpvOpTypeFloat:
+        {
+            return type.opcode == SpvOpTypeBool ? 4 : type.width / 8;
+        }
+        case SpvOpTypeVector:
+        {
+            return type.componentCount * typeSize(ids, type.typeId);
+        }
+        case SpvOpTypeMatrix:
+        {
+            uint32_t columnSize = matrixStride ? matrixStride : typeSize(ids, type.typeId);
+            return type.componentCount * columnSize;
+        }
+        case SpvOpTypeArray:
+        {
+            uint32_t length = ids[type.constant].constant;
+            uint32_t stride = type.arrayStride ? type.arrayStride : typeSize(ids, type.typeId);
+            return length * stride;
+        }
+        case SpvOpTypeStruct:
+        {
+            uint32_t size = 0;
+
+            for (size_t i = 0; i < type.members.size(); ++i)
+            {
+                uint32_t offset = i < type.memberOffsets.size() ? type.memberOffsets[i] : 0;
+                uint32_t stride = i < type.memberMatrixStrides.size() ? type.memberMatrixStrides[i] : 0;
+                size = std::max(size, offset + typeSize(ids, type.members[i], stride));
+            }
+
+            return size;
+        }
+        default:
+        {
+            return 0;
+        }
+    }
+}
+
+static VkDescriptorType descriptorType(const std::vector<SpirvId>& ids, uint32_t typeId, uint32_t storageClass)
+{
+    const SpirvId& type = ids[typeId];
+
+    switch (type.opcode)
+    {
+        case SpvOpTypeStruct:
+        {
+            if (storageClass == SpvStorageClassStorageBuffer || type.bufferBlock)
+            {
+                return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            }
+
+            return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        }
+        case SpvOpTypeSampler:
+        {
+            return VK_DESCRIPTOR_TYPE_SAMPLER;
+        }
+        case SpvOpTypeSampledImage:
+        {
+            const SpirvId& image = ids[type.typeId];
+            return image.dim == SpvDimBuffer ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        }
+        case SpvOpTypeImage:
+        {
+            if (type.dim == SpvDimSubpassData)
+            {
+                return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+            }
+
+            if (type.dim == SpvDimBuffer)
+            {
+                return type.sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+            }
+
+            return type.sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        }
+        default:
+        {
+            GS_ASSERT(!"Unsupported descriptor type");
+            return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+        }
+    }
+}
+
+static VkFormat vertexInputFormat(const std::vector<SpirvId>& ids, uint32_t typeId)
+{
+    const SpirvId& type = ids[typeId];
+    uint32_t componentCount = 1;
+    const SpirvId* component = &type;
+
+    if (type.opcode == SpvOpTypeVector)
+    {
+        componentCount = type.componentCount;
+        component = &ids[type.typeId];
+    }
+
+    GS_ASSERT(component->width == 32 && "Only 32 bit vertex inputs are supported");
+
+    static const VkFormat floatFormats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT,
+                                             VK_FORMAT_R32G32B32A32_SFLOAT };
+    static const VkFormat intFormats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT,
+                                           VK_FORMAT_R32G32B32A32_SINT };
+    static const VkFormat uintFormats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT,
+                                            VK_FORMAT_R32G32B32A32_UINT };
+
+    if (component->opcode == SpvOpTypeFloat)
+    {
+        return floatFormats[componentCount - 1];
+    }
+
+    // For OpTypeInt the signedness operand was stored in constant
+    return component->constant ? intFormats[componentCount - 1] : uintFormats[componentCount - 1];
+}
+
+static void reflectShaderModule(const std::vector<SpirvId>& ids, ShaderModule& module)
+{
+    for (const SpirvId& variable : ids)
+    {
+        if (variable.opcode != SpvOpVariable)
+        {
+            continue;
+        }
+
+        // Variables are always pointers; look through to the pointee
+        uint32_t typeId = ids[variable.typeId].typeId;
+
+        switch (variable.storageClass)
+        {
+            case SpvStorageClassUniform:
+            case SpvStorageClassUniformConstant:
+            case SpvStorageClassStorageBuffer:
+            {
+                if (variable.binding == ~0u)
+                {
+                    break;
+                }
+
+                ShaderBinding binding{};
+                binding.set = variable.set == ~0u ? 0 : variable.set;
+                binding.binding = variable.binding;
+                binding.descriptorCount = 1;
+
+                if (ids[typeId].opcode == SpvOpTypeArray)
+                {
+                    binding.descriptorCount = ids[ids[typeId].constant].constant;
+                    typeId = ids[typeId].typeId;
+                }
+                else if (ids[typeId].opcode == SpvOpTypeRuntimeArray)
+                {
+                    binding.descriptorCount = 0;
+                    typeId = ids[typeId].typeId;
+                }
+
+                binding.descriptorType = descriptorType(ids, typeId, variable.storageClass);
+                module.bindings.push_back(binding);
+                break;
+            }
+            case SpvStorageClassPushConstant:
+            {
+                module.pushConstantSize = std::max(module.pushConstantSize, typeSize(ids, typeId));
+                break;
+            }
+            case SpvStorageClassInput:
+            {
+                if (module.stage != VK_SHADER_STAGE_VERTEX_BIT || variable.builtIn || ids[typeId].builtIn || variable.location == ~0u)
+                {
+                    break;
+                }
+
+                ShaderVertexInput input{};
+                input.location = variable.location;
+                input.format = vertexInputFormat(ids, typeId);
+                input.size = typeSize(ids, typeId);
+                module.vertexInputs.push_back(input);
+                break;
+            }
+        }
+    }
+
+    for (const SpirvId& constant : ids)
+    {
+        if (constant.specId != ~0u)
+        {
+            module.specializationConstants.push_back({ constant.specId, typeSize(ids, constant.typeId) });
+        }
+    }
+
+    std::sort(module.bindings.begin(), module.bindings.end(), [](const ShaderBinding& lhs, const ShaderBinding& rhs) {
+        return lhs.set < rhs.set || (lhs.set == rhs.set && lhs.binding < rhs.binding);
+    });
+
+    std::sort(module.vertexInputs.begin(), module.vertexInputs.end(),
+              [](const ShaderVertexInput& lhs, const ShaderVertexInput& rhs) { return lhs.location < rhs.location; });
+
+    std::sort(module.specializationConstants.begin(), module.specializationConstants.end(),
+              [](const ShaderSpecializationConstant& lhs, const ShaderSpecializationConstant& rhs) { return lhs.constantId < rhs.constantId; });
+}
+
+static uint64_t hashCode(const std::vector<uint8_t>& code)
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    for (uint8_t byte : code)
+    {
+        hash = (hash ^ byte) * 1099511628211ull;
+    }
+
+    return hash;
+}
+
+// Reads the .refl sidecar project/build_shaders.py writes next to each .spv, which holds the same reflection reflectShaderModule
+// produces. The sidecar is only used when its header matches the exact SPIR-V loaded, so a stale or hand copied .spv is still
+// reflected correctly.
+static bool loadReflectionSidecar(const std::string& path, const std::vector<uint8_t>& code, ShaderModule& module)
+{
+    std::ifstream fs(std::filesystem::path(path).replace_extension(".refl"));
+
+    if (!fs)
+    {
+        return false;
+    }
+
+    std::string version;
+    size_t codeSize{};
+    uint64_t codeHash{};
+    fs >> version >> codeSize >> std::hex >> codeHash >> std::dec;
+
+    if (!fs || version != "gsrefl1" || codeSize != code.size() || codeHash != hashCode(code))
+    {
+        GS_WARN("Ignoring stale reflection sidecar for %s", path.c_str());
+        return false;
+    }
+
+    ShaderModule reflected{};
+    std::string keyword;
+
+    while (fs >> keyword)
+    {
+        if (keyword == "stage")
+        {
+            uint32_t stage{};
+            fs >> stage;
+            reflected.stage = VkShaderStageFlagBits(stage);
+        }
+        else if (keyword == "entry")
+        {
+            fs >> reflected.entryPoint;
+        }
+        else if (keyword == "push")
+        {
+            fs >> reflected.pushConstantSize;
+        }
+        else if (keyword == "binding")
+        {
+            ShaderBinding binding{};
+            uint32_t descriptorType{};
+            fs >> binding.set >> binding.binding >> descriptorType >> binding.descriptorCount;
+            binding.descriptorType = VkDescriptorType(descriptorType);
+            reflected.bindings.push_back(binding);
+        }
+        else if (keyword == "input")
+        {
+            ShaderVertexInput input{};
+            uint32_t format{};
+            fs >> input.location >> format >> input.size;
+            input.format = VkFormat(format);
+            reflected.vertexInputs.push_back(input);
+        }
+        else if (keyword == "spec")
+        {
+            ShaderSpecializationConstant constant{};
+            fs >> constant.constantId >> constant.size;
+            reflected.specializationConstants.push_back(constant);
+        }
+        else
+        {
+            fs.setstate(std::ios::failbit);
+        }
+
+        if (!fs)
+        {
+            GS_WARN("Malformed reflection sidecar for %s", path.c_str());
+            return false;
+        }
+    }
+
+    module.stage = reflected.stage;
+    module.entryPoint = std::move(reflected.entryPoint);
+    module.bindings = std::move(reflected.bindings);
+    module.vertexInputs = std::move(reflected.vertexInputs);
+    module.specializationConstants = std::move(reflected.specializationConstants);
+    module.pushConstantSize = reflected.pushConstantSize;
+    return true;
+}
+
 ShaderModule loadShaderModule(VkDevice device, const std::string& path)
 {
     ShaderModule module{};
+    module.path = path;
 
+    // Files are reloaded while the application runs, so a missing, truncated or half written file must not take it down
+    std::error_code ec;
+    auto fileSize = std::filesystem::file_size(path, ec);
     std::ifstream fs(path, std::ios::in | std::ios::binary);
-    GS_ASSERT(fs);
-    auto fileSize = std::filesystem::file_size(path);
+
+    if (ec || !fs || fileSize < 5 * sizeof(uint32_t) || fileSize % sizeof(uint32_t) != 0)
+    {
+        GS_ERROR("Failed to load shader %s: missing or not a whole number of SPIR-V words.", path.c_str());
+        return module;
+    }
+
     std::vector<uint8_t> data(fileSize);
     fs.read((char*)data.data(), fileSize);
 
     uint32_t* code = (uint32_t*)data.data();
     uint32_t codeSize = (uint32_t)data.size();
 
+    // Every id is defined by an instruction of at least two words, so a larger bound means a corrupt header
+    if (!fs || code[0] != SpvMagicNumber || code[1] > SpvVersion || code[3] > codeSize / sizeof(uint32_t))
+    {
+        GS_ERROR("Failed to load shader %s: not a supported SPIR-V module.", path.c_str());
+        return module;
+    }
+
     VkShaderModuleCreateInfo createInfo{ VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
     createInfo.codeSize = codeSize;
     createInfo.pCode = code;
 
-    VkShaderModule shaderModule{};
-    VK_CHECK_RESULT(vkCreateShaderModule(device, &createInfo, nullptr, &module.shader));
+    if (loadReflectionSidecar(path, data, module))
+    {
+        VK_CHECK_RESULT(vkCreateShaderModule(device, &createInfo, nullptr, &module.shader));
+        return module;
+    }
 
-    // Orientation / sanity checking; vkCreateShaderModule would probably have failed if any of this were untrue?
-    GS_ASSERT(code[0] == SpvMagicNumber);
-    GS_ASSERT(code[1] == SpvVersion);
     uint32_t boundIds = code[3];
+    uint32_t moduleWords = codeSize / sizeof(uint32_t);
+    std::vector<SpirvId> ids(boundIds);
+
+    // Instructions defining or referencing ids outside the bound write to invalidId instead, and the module is rejected after parsing,
+    // so reflection only ever follows ids that exist
+    SpirvId invalidId{};
+    bool valid = true;
+    auto idRef = [&](uint32_t index) {
+        valid = valid && index < boundIds;
+        return index;
+    };
+    auto idAt = [&](uint32_t index) -> SpirvId& { return idRef(index) < boundIds ? ids[index] : invalidId; };
 
     // Parse SPIR-V
     code = code + 5;
@@ -66,13 +504,161 @@ ShaderModule loadShaderModule(VkDevice device, const std::string& path)
         SpvOp opcode = SpvOp(code[0] & SpvOpCodeMask);
         uint32_t wordCount = code[0] >> SpvWordCountShift;
 
+        if (wordCount == 0 || wordCount > codeSize / sizeof(uint32_t))
+        {
+            valid = false;
+            break;
+        }
+
+        // A truncated or corrupt instruction must not have its operands read from the next one, or past the end of the module
+        uint32_t requiredWordCount = minimumWordCount(opcode);
+
+        if ((opcode == SpvOpDecorate || opcode == SpvOpMemberDecorate) && wordCount >= requiredWordCount)
+        {
+            requiredWordCount += decorationLiteralCount(code[requiredWordCount - 1]);
+        }
+
+        if (wordCount < requiredWordCount)
+        {
+            valid = false;
+            break;
+        }
+
         switch (opcode)
         {
             case SpvOpEntryPoint:
             {
                 SpvExecutionModel executionModel = SpvExecutionModel(code[1]);
                 module.stage = ShaderStage(executionModel);
-                module.entryPoint = (const char*)(&code[3]);
+                const char* name = (const char*)(&code[3]);
+                module.entryPoint.assign(name, strnlen(name, (wordCount - 3) * sizeof(uint32_t)));
+                break;
+            }
+            case SpvOpDecorate:
+            {
+                SpirvId& id = idAt(code[1]);
+
+                switch (code[2])
+                {
+                    case SpvDecorationDescriptorSet: id.set = code[3]; break;
+                    case SpvDecorationBinding: id.binding = code[3]; break;
+                    case SpvDecorationLocation: id.location = code[3]; break;
+                    case SpvDecorationSpecId: id.specId = code[3]; break;
+                    case SpvDecorationArrayStride: id.arrayStride = code[3]; break;
+                    case SpvDecorationBuiltIn: id.builtIn = true; break;
+                    case SpvDecorationBufferBlock: id.bufferBlock = true; break;
+                }
+
+                break;
+            }
+            case SpvOpMemberDecorate:
+            {
+                SpirvId& id = idAt(code[1]);
+
+                // A struct can't have more members than the module has words, which also bounds the member decoration arrays
+                if (code[2] >= moduleWords)
+                {
+                    valid = false;
+                    break;
+                }
+
+                switch (code[3])
+                {
+                    case SpvDecorationOffset: setMemberDecoration(id.memberOffsets, code[2], code[4]); break;
+                    case SpvDecorationMatrixStride: setMemberDecoration(id.memberMatrixStrides, code[2], code[4]); break;
+                    case SpvDecorationBuiltIn: id.builtIn = true; break;
+                }
+
+                break;
+            }
+            case SpvOpTypeBool:
+            case SpvOpTypeSampler:
+            {
+                idAt(code[1]).opcode = opcode;
+                break;
+            }
+            case SpvOpTypeInt:
+            {
+                SpirvId& id = idAt(code[1]);
+                id.opcode = opcode;
+                id.width = code[2];
+                id.constant = code[3];
+                break;
+            }
+            case SpvOpTypeFloat:
+            {
+                SpirvId& id = idAt(code[1]);
+                id.opcode = opcode;
+                id.width = code[2];
+                break;
+            }
+            case SpvOpTypeVector:
+            case SpvOpTypeMatrix:
+            {
+                SpirvId& id = idAt(code[1]);
+                id.opcode = opcode;
+                id.typeId = idRef(code[2]);
+                id.componentCount = code[3];
+                break;
+            }
+            case SpvOpTypeImage:
+            {
+                SpirvId& id = idAt(code[1]);
+                id.opcode = opcode;
+                id.typeId = idRef(code[2]);
+                id.dim = code[3];
+                id.sampled = code[7];
+                break;
+            }
+            case SpvOpTypeSampledImage:
+            case SpvOpTypeRuntimeArray:
+            {
+                SpirvId& id = idAt(code[1]);
+                id.opcode = opcode;
+                id.typeId = idRef(code[2]);
+                break;
+            }
+            case SpvOpTypeArray:
+            {
+                SpirvId& id = idAt(code[1]);
+                id.opcode = opcode;
+                id.typeId = idRef(code[2]);
+                id.constant = idRef(code[3]);
+                break;
+            }
+            case SpvOpTypeStruct:
+            {
+                SpirvId& id = idAt(code[1]);
+                id.opcode = opcode;
+                id.members.assign(code + 2, code + wordCount);
+                std::for_each(id.members.begin(), id.members.end(), idRef);
+                break;
+            }
+            case SpvOpTypePointer:
+            {
+                SpirvId& id = idAt(code[1]);
+                id.opcode = opcode;
+                id.storageClass = code[2];
+                id.typeId = idRef(code[3]);
+                break;
+            }
+            case SpvOpConstant:
+            case SpvOpSpecConstant:
+            case SpvOpSpecConstantTrue:
+            case SpvOpSpecConstantFalse:
+            {
+                SpirvId& id = idAt(code[2]);
+                id.opcode = opcode;
+                id.typeId = idRef(code[1]);
+                id.constant = wordCount > 3 ? code[3] : 0;
+                break;
+            }
+            case SpvOpVariable:
+            {
+                SpirvId& id = idAt(code[2]);
+                id.opcode = opcode;
+                id.typeId = idRef(code[1]);
+                id.storageClass = code[3];
                 break;
             }
         }
@@ -81,10 +667,17 @@ ShaderModule loadShaderModule(VkDevice device, const std::string& path)
         codeSize -= wordCount * 4;
     }
 
-    // TODO: validate that we got everything we need here.
+    if (!valid)
+    {
+        GS_ERROR("Failed to load shader %s: malformed SPIR-V instruction stream.", path.c_str());
+        return module;
+    }
+
+    VK_CHECK_RESULT(vkCreateShaderModule(device, &createInfo, nullptr, &module.shader));
+    reflectShaderModule(ids, module);
 
     return module;
 }
 
 } // namespace Vulkan
-} // namespace GameSmith
\ No newline at end of file
+} // namespace GameSmith
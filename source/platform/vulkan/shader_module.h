@@ -7,13 +7,44 @@ namespace gs
 namespace vk
 {
 
+struct ShaderBinding
+{
+    uint32_t set;
+    uint32_t binding;
+    VkDescriptorType descriptorType;
+    uint32_t descriptorCount; // 0 for runtime sized arrays
+};
+
+struct ShaderVertexInput
+{
+    uint32_t location;
+    VkFormat format;
+    uint32_t size;
+};
+
+struct ShaderSpecializationConstant
+{
+    uint32_t constantId;
+    uint32_t size;
+};
+
+// Shader module plus the interface reflected from its SPIR-V
 struct ShaderModule
 {
     VkShaderModule shader;
+    std::string path; // File the module was loaded from
     VkShaderStageFlagBits stage;
     std::string entryPoint;
+    std::vector<ShaderBinding> bindings;
+    std::vector<ShaderVertexInput> vertexInputs; // Sorted by location, vertex shaders only
+    std::vector<ShaderSpecializationConstant> specializationConstants;
+    uint32_t pushConstantSize;
 };
 
+using ShaderList = std::initializer_list<ShaderModule>;
+
+// Logs an error and returns a module without a shader if the file is missing or isn't valid SPIR-V, e.g. when it is caught half
+// written during a hot reload
 ShaderModule loadShaderModule(VkDevice device, const std::string& path);
 
 } // namespace Vulkan
@@ -0,0 +1,199 @@
+#version 450
+
+// One workgroup per object; its threads share out the object's meshlets
+layout(local_size_x = 64) in;
+
+layout(set = 0, binding = 0) uniform CullData
+{
+	mat4 view;
+	vec4 frustumPlanes[6]; // View space, pointing inwards
+	vec4 projection;       // P00, P11, P22, P32
+	vec2 pyramidSize;
+	uint objectCount;
+	uint maxDraws;
+	uint frustumCulling;
+	uint occlusionCulling;
+	uint meshletCulling;
+} data;
+
+struct Object
+{
+	mat4 transform;
+	uint meshIndex;
+};
+
+struct Mesh
+{
+	vec4 boundingSphere;
+	uint firstIndex;
+	uint indexCount;
+	int vertexOffset;
+	uint firstMeshlet;
+	uint meshletCount;
+};
+
+struct Meshlet
+{
+	vec4 boundingSphere;
+	uint firstIndex;
+	uint indexCount;
+};
+
+struct DrawCommand
+{
+	uint indexCount;
+	uint instanceCount;
+	uint firstIndex;
+	int vertexOffset;
+	uint firstInstance;
+};
+
+layout(set = 0, binding = 1) readonly buffer Objects
+{
+	Object objects[];
+};
+
+layout(set = 0, binding = 2) readonly buffer Meshes
+{
+	Mesh meshes[];
+};
+
+layout(set = 0, binding = 3) readonly buffer Meshlets
+{
+	Meshlet meshlets[];
+};
+
+layout(set = 0, binding = 4) writeonly buffer Draws
+{
+	DrawCommand draws[];
+};
+
+layout(set = 0, binding = 5) buffer DrawCount
+{
+	uint drawCount;
+};
+
+// Farthest depth of the previous frame, one level per halving of the resolution
+layout(set = 0, binding = 6) uniform sampler2D depthPyramid;
+
+// Screen space bounds of a sphere in front of the near plane, as uv min and max, from "2D Polyhedral Bounds of a Clipped,
+// Perspective-Projected 3D Sphere" (Mara and McGuire). center is in view space with z pointing forwards.
+vec4 projectSphere(vec3 center, float radius)
+{
+	vec2 cx = center.xz;
+	vec2 vx = vec2(sqrt(dot(cx, cx) - radius * radius), radius);
+	vec2 minX = mat2(vx.x, vx.y, -vx.y, vx.x) * cx;
+	vec2 maxX = mat2(vx.x, -vx.y, vx.y, vx.x) * cx;
+
+	vec2 cy = center.yz;
+	vec2 vy = vec2(sqrt(dot(cy, cy) - radius * radius), radius);
+	vec2 minY = mat2(vy.x, vy.y, -vy.y, vy.x) * cy;
+	vec2 maxY = mat2(vy.x, -vy.y, vy.y, vy.x) * cy;
+
+	vec4 ndc = vec4(minX.x / minX.y * data.projection.x, minY.x / minY.y * data.projection.y, maxX.x / maxX.y * data.projection.x,
+	                maxY.x / maxY.y * data.projection.y);
+
+	// The viewport is flipped, so ndc y = 1 is the top row of the depth buffer
+	return clamp(vec4(ndc.x, -ndc.w, ndc.z, -ndc.y) * 0.5 + 0.5, 0.0, 1.0);
+}
+
+bool isOccluded(vec3 center, float radius)
+{
+	// Flip to positive depth in front of the camera
+	center.z = -center.z;
+	float nearestDistance = center.z - radius;
+
+	// Vulkan clips at ndc z = 0, which this projection puts at P32 / P22
+	if (nearestDistance <= data.projection.w / data.projection.z)
+	{
+		return false;
+	}
+
+	vec4 uv = projectSphere(center, radius);
+	vec2 size = (uv.zw - uv.xy) * data.pyramidSize;
+	int level = int(ceil(log2(max(max(size.x, size.y), 1.0))));
+	level = min(level, textureQueryLevels(depthPyramid) - 1);
+
+	// The footprint spans at most two texels across at this level
+	ivec2 levelSize = textureSize(depthPyramid, level);
+	ivec2 texelMin = clamp(ivec2(uv.xy * vec2(levelSize)), ivec2(0), levelSize - 1);
+	ivec2 texelMax = clamp(ivec2(uv.zw * vec2(levelSize)), ivec2(0), levelSize - 1);
+	float pyramidDepth = min(texelFetch(depthPyramid, texelMin, level).r, texelFetch(depthPyramid, texelMax, level).r);
+	pyramidDepth = min(pyramidDepth, texelFetch(depthPyramid, ivec2(texelMin.x, texelMax.y), level).r);
+	pyramidDepth = min(pyramidDepth, texelFetch(depthPyramid, ivec2(texelMax.x, texelMin.y), level).r);
+
+	// Depth is 1 - ndc z, so nearer is greater
+	float sphereDepth = 1.0 + data.projection.z - data.projection.w / nearestDistance;
+	return sphereDepth < pyramidDepth;
+}
+
+bool isVisible(vec4 boundingSphere, mat4 modelView, float scale)
+{
+	vec3 center = (modelView * vec4(boundingSphere.xyz, 1.0)).xyz;
+	float radius = boundingSphere.w * scale;
+
+	if (data.frustumCulling != 0)
+	{
+		for (int p = 0; p < 6; ++p)
+		{
+			if (dot(data.frustumPlanes[p].xyz, center) + data.frustumPlanes[p].w < -radius)
+			{
+				return false;
+			}
+		}
+	}
+
+	return data.occlusionCulling == 0 || !isOccluded(center, radius);
+}
+
+void emitDraw(uint indexCount, uint firstIndex, int vertexOffset, uint objectIndex)
+{
+	uint drawIndex = atomicAdd(drawCount, 1);
+
+	// The count may overshoot; vkCmdDrawIndexedIndirectCount clamps it to maxDraws
+	if (drawIndex < data.maxDraws)
+	{
+		draws[drawIndex] = DrawCommand(indexCount, 1, firstIndex, vertexOffset, objectIndex);
+	}
+}
+
+void main()
+{
+	uint objectIndex = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+
+	if (objectIndex >= data.objectCount)
+	{
+		return;
+	}
+
+	Object object = objects[objectIndex];
+	Mesh mesh = meshes[object.meshIndex];
+	mat4 modelView = data.view * object.transform;
+	float scale = max(length(object.transform[0].xyz), max(length(object.transform[1].xyz), length(object.transform[2].xyz)));
+
+	// Every thread tests the object, which keeps the workgroup's control flow uniform without shared memory
+	if (!isVisible(mesh.boundingSphere, modelView, scale))
+	{
+		return;
+	}
+
+	if (data.meshletCulling == 0)
+	{
+		if (gl_LocalInvocationIndex == 0)
+		{
+			emitDraw(mesh.indexCount, mesh.firstIndex, mesh.vertexOffset, objectIndex);
+		}
+
+		return;
+	}
+
+	for (uint m = gl_LocalInvocationIndex; m < mesh.meshletCount; m += gl_WorkGroupSize.x)
+	{
+		Meshlet meshlet = meshlets[mesh.firstMeshlet + m];
+
+		if (isVisible(meshlet.boundingSphere, modelView, scale))
+		{
+			emitDraw(meshlet.indexCount, meshlet.firstIndex, mesh.vertexOffset, objectIndex);
+		}
+	}
+}
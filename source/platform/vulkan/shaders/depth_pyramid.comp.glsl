@@ -0,0 +1,39 @@
+#version 450
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// The depth buffer for level 0, the level above otherwise
+layout(set = 0, binding = 0) uniform sampler2D inputDepth;
+layout(set = 0, binding = 1, r32f) uniform writeonly image2D outputDepth;
+
+layout(push_constant) uniform Constants
+{
+	uvec2 inputSize;
+	uvec2 outputSize;
+} constants;
+
+void main()
+{
+	uvec2 texel = gl_GlobalInvocationID.xy;
+
+	if (any(greaterThanEqual(texel, constants.outputSize)))
+	{
+		return;
+	}
+
+	// Level 0 rounds the depth buffer down to a power of two, so a texel covers up to three input texels across; later levels cover
+	// two. Nearer surfaces have greater depth, so the farthest depth of the footprint is its minimum.
+	uvec2 begin = texel * constants.inputSize / constants.outputSize;
+	uvec2 end = max(((texel + 1) * constants.inputSize + constants.outputSize - 1) / constants.outputSize, begin + 1);
+	float depth = 1.0;
+
+	for (uint y = begin.y; y < end.y; ++y)
+	{
+		for (uint x = begin.x; x < end.x; ++x)
+		{
+			depth = min(depth, texelFetch(inputDepth, ivec2(x, y), 0).r);
+		}
+	}
+
+	imageStore(outputDepth, ivec2(texel), vec4(depth));
+}
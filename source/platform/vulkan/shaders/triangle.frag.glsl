@@ -1,9 +1,20 @@
 #version 450
 
+// Feature toggle, set per pipeline variant
+layout(constant_id = 0) const bool kLighting = false;
+
 layout(location = 0) in vec4 vcolor;
 layout(location = 0) out vec4 color;
 
 void main()
 {
 	color = vcolor;
+
+	if (kLighting)
+	{
+		// The vertex color is the world space normal remapped to [0, 1]
+		vec3 normal = normalize(vcolor.xyz * 2 - 1);
+		float diffuse = max(dot(normal, normalize(vec3(-0.4, 1, 0.6))), 0);
+		color = vec4(vec3(0.1 + 0.8 * diffuse), vcolor.a);
+	}
 }
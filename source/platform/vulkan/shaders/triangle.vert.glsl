@@ -1,18 +1,48 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec3 aPosition;
 layout(location = 1) in vec3 aNormal;
 
 layout(location = 0) out vec4 color;
 
-layout(binding = 0) uniform Globals
+struct DrawConstants
+{
+	uint firstObject;
+	uint materialIndex;
+	float lodFade;
+};
+
+layout(set = 0, binding = 0) uniform Globals
 {
 	mat4 proj;
 	mat4 view;
+	DrawConstants draw; // Used instead of the push constants when drawUniforms is set
+	uint objectBuffer;  // Bindless handle of the frame's objects
+	uint drawUniforms;
 } globals;
 
+layout(push_constant) uniform PushConstants
+{
+	DrawConstants draw;
+} pushConstants;
+
+struct Object
+{
+	mat4 transform;
+	uint meshIndex;
+};
+
+// Bindless heap storage buffers, the objects are indexed by the draw's firstInstance
+layout(set = 1, binding = 0) readonly buffer Objects
+{
+	Object objects[];
+} objectBuffers[];
+
 void main()
 {
-	gl_Position = globals.proj * globals.view * vec4(aPosition, 1);
-	color = vec4(aNormal, 1) * 0.5 + 0.5;
+	DrawConstants draw = globals.drawUniforms != 0 ? globals.draw : pushConstants.draw;
+	mat4 transform = objectBuffers[globals.objectBuffer].objects[draw.firstObject + gl_InstanceIndex].transform;
+	gl_Position = globals.proj * globals.view * transform * vec4(aPosition, 1);
+	color = vec4(normalize(mat3(transform) * aNormal) * 0.5 + 0.5, draw.lodFade);
 }
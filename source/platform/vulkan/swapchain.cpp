@@ -2,6 +2,8 @@
 
 #include "swapchain.h"
 
+#include "deletion_queue.h"
+
 #include "gamesmith/core/core.h"
 #include "gamesmith/core/debug.h"
 #include "gamesmith/core/log.h"
@@ -10,48 +12,145 @@ namespace gs
 {
 namespace vk
 {
-VkSwapchainKHR createSwapchain(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, VkDevice device, VkSurfaceFormatKHR surfaceFormat)
+// Color attachment use is always supported; copying into the images is only requested where the surface allows it
+static const VkImageUsageFlags kSwapchainImageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+const char* presentModeName(VkPresentModeKHR presentMode)
+{
+    switch (presentMode)
+    {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:
+        {
+            return "Immediate";
+        }
+        case VK_PRESENT_MODE_MAILBOX_KHR:
+        {
+            return "Mailbox";
+        }
+        case VK_PRESENT_MODE_FIFO_KHR:
+        {
+            return "FIFO";
+        }
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+        {
+            return "FIFO relaxed";
+        }
+        default:
+        {
+            return "Unknown";
+        }
+    }
+}
+
+static VkPresentModeKHR choosePresentMode(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, VkPresentModeKHR requested)
+{
+    uint32_t presentModeCount{};
+    VK_CHECK_RESULT(vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, nullptr));
+    std::vector<VkPresentModeKHR> presentModes(presentModeCount);
+    VK_CHECK_RESULT(vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, presentModes.data()));
+
+    // The low latency modes fall back to each other before vsync
+    std::vector<VkPresentModeKHR> candidates{ requested };
+
+    if (requested == VK_PRESENT_MODE_MAILBOX_KHR)
+    {
+        candidates.push_back(VK_PRESENT_MODE_IMMEDIATE_KHR);
+    }
+    else if (requested == VK_PRESENT_MODE_IMMEDIATE_KHR)
+    {
+        candidates.push_back(VK_PRESENT_MODE_MAILBOX_KHR);
+    }
+
+    for (VkPresentModeKHR candidate : candidates)
+    {
+        if (std::find(presentModes.begin(), presentModes.end(), candidate) != presentModes.end())
+        {
+            if (candidate != requested)
+            {
+                GS_WARN("Present mode %s is not supported, using %s.", presentModeName(requested), presentModeName(candidate));
+            }
+
+            return candidate;
+        }
+    }
+
+    if (requested != VK_PRESENT_MODE_FIFO_KHR)
+    {
+        GS_WARN("Present mode %s is not supported, using FIFO.", presentModeName(requested));
+    }
+
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+static uint32_t chooseImageCount(const VkSurfaceCapabilitiesKHR& surfaceCaps, VkPresentModeKHR presentMode, uint32_t requested)
+{
+    // Mailbox needs an image to render to while one is queued and another is on screen
+    uint32_t imageCount = requested;
+
+    if (imageCount == 0)
+    {
+        imageCount = presentMode == VK_PRESENT_MODE_MAILBOX_KHR ? 3 : 2;
+    }
+
+    imageCount = std::max(imageCount, surfaceCaps.minImageCount);
+
+    if (surfaceCaps.maxImageCount)
+    {
+        imageCount = std::min(imageCount, surfaceCaps.maxImageCount);
+    }
+
+    return imageCount;
+}
+
+VkSwapchainKHR createSwapchain(VkSurfaceKHR surface, VkDevice device, VkSurfaceFormatKHR surfaceFormat, const VkSurfaceCapabilitiesKHR& surfaceCaps,
+                               VkPresentModeKHR presentMode, uint32_t imageCount, VkSwapchainKHR oldSwapchain)
 {
-    VkSurfaceCapabilitiesKHR surfaceCaps{};
-    VK_CHECK_RESULT(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &surfaceCaps));
     GS_ASSERT(surfaceCaps.supportedCompositeAlpha & VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR);
+    GS_ASSERT(surfaceCaps.supportedUsageFlags & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
 
     VkSwapchainCreateInfoKHR createInfo{ VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR };
     createInfo.surface = surface;
-    createInfo.minImageCount = std::max(2u, surfaceCaps.minImageCount);
+    createInfo.minImageCount = imageCount;
     createInfo.imageFormat = surfaceFormat.format;
     createInfo.imageColorSpace = surfaceFormat.colorSpace;
     createInfo.imageExtent = surfaceCaps.currentExtent;
     createInfo.imageArrayLayers = 1;
-    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    createInfo.imageUsage = kSwapchainImageUsage & surfaceCaps.supportedUsageFlags;
     createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
     createInfo.preTransform = surfaceCaps.currentTransform;
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR; // TODO: support other composite alpha
-    createInfo.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    createInfo.presentMode = presentMode;
     createInfo.clipped = VK_FALSE; // TODO: mindfulness
+    createInfo.oldSwapchain = oldSwapchain;
 
     VkSwapchainKHR swapchain{};
     VK_CHECK_RESULT(vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapchain));
     return swapchain;
 }
 
-bool createSwapchain(VkPhysicalDevice physicalDevice, VkDevice device, VkSurfaceKHR surface, VkSurfaceFormatKHR surfaceFormat, Swapchain& swapchain)
+bool createSwapchain(VkPhysicalDevice physicalDevice, VkDevice device, VkSurfaceKHR surface, VkSurfaceFormatKHR surfaceFormat,
+                     const VkSurfaceCapabilitiesKHR& surfaceCaps, const SwapchainConfig& config, Swapchain& swapchain,
+                     VkSwapchainKHR oldSwapchain)
 {
-    swapchain.swapchain = createSwapchain(physicalDevice, surface, device, surfaceFormat);
+    GS_ASSERT(surfaceCaps.currentExtent.width && surfaceCaps.currentExtent.height);
+    VkPresentModeKHR presentMode = choosePresentMode(physicalDevice, surface, config.presentMode);
+    uint32_t imageCount = chooseImageCount(surfaceCaps, presentMode, config.imageCount);
+    swapchain.swapchain = createSwapchain(surface, device, surfaceFormat, surfaceCaps, presentMode, imageCount, oldSwapchain);
 
     if (!swapchain.swapchain)
     {
         return false;
     }
 
-    VkSurfaceCapabilitiesKHR surfaceCaps{};
-    VK_CHECK_RESULT(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &surfaceCaps));
     swapchain.extent = surfaceCaps.currentExtent;
+    swapchain.imageUsage = kSwapchainImageUsage & surfaceCaps.supportedUsageFlags;
+    swapchain.presentMode = presentMode;
 
     uint32_t swapchainImageCount{};
     VK_CHECK_RESULT(vkGetSwapchainImagesKHR(device, swapchain.swapchain, &swapchainImageCount, nullptr));
     swapchain.images.resize(swapchainImageCount);
     swapchain.imageViews.resize(swapchainImageCount);
+    swapchain.presentSemaphores.resize(swapchainImageCount);
 
     VK_CHECK_RESULT(vkGetSwapchainImagesKHR(device, swapchain.swapchain, &swapchainImageCount, swapchain.images.data()));
 
@@ -65,6 +164,9 @@ bool createSwapchain(VkPhysicalDevice physicalDevice, VkDevice device, VkSurface
         createInfo.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
         createInfo.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
         VK_CHECK_RESULT(vkCreateImageView(device, &createInfo, nullptr, &swapchain.imageViews[i]));
+
+        VkSemaphoreCreateInfo semaphoreCreateInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+        VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &swapchain.presentSemaphores[i]));
     }
 
     return true;
@@ -72,11 +174,31 @@ bool createSwapchain(VkPhysicalDevice physicalDevice, VkDevice device, VkSurface
 
 void destroySwapchain(VkDevice device, Swapchain& swapchain)
 {
+    for (RetiredSwapchain& retired : swapchain.retired)
+    {
+        for (VkImageView imageView : retired.imageViews)
+        {
+            vkDestroyImageView(device, imageView, nullptr);
+        }
+
+        for (VkSemaphore semaphore : retired.presentSemaphores)
+        {
+            vkDestroySemaphore(device, semaphore, nullptr);
+        }
+
+        vkDestroySwapchainKHR(device, retired.swapchain, nullptr);
+    }
+
     for (VkImageView& imageView : swapchain.imageViews)
     {
         vkDestroyImageView(device, imageView, nullptr);
     }
 
+    for (VkSemaphore& semaphore : swapchain.presentSemaphores)
+    {
+        vkDestroySemaphore(device, semaphore, nullptr);
+    }
+
     if (swapchain.swapchain)
     {
         vkDestroySwapchainKHR(device, swapchain.swapchain, nullptr);
@@ -84,5 +206,46 @@ void destroySwapchain(VkDevice device, Swapchain& swapchain)
 
     swapchain = Swapchain{};
 }
+
+bool recreateSwapchain(VkPhysicalDevice physicalDevice, VkDevice device, VkSurfaceKHR surface, VkSurfaceFormatKHR surfaceFormat,
+                       const VkSurfaceCapabilitiesKHR& surfaceCaps, const SwapchainConfig& config, Swapchain& swapchain)
+{
+    Swapchain newSwapchain{};
+
+    if (!createSwapchain(physicalDevice, device, surface, surfaceFormat, surfaceCaps, config, newSwapchain, swapchain.swapchain))
+    {
+        return false;
+    }
+
+    // The old swapchain is retired even if its images are still being presented. Its last presents may still be waiting on its present
+    // semaphores, which no frame fence covers, so it is kept until the new swapchain has presented.
+    newSwapchain.retired = std::move(swapchain.retired);
+    newSwapchain.retired.push_back({ swapchain.swapchain, std::move(swapchain.imageViews), std::move(swapchain.presentSemaphores) });
+    swapchain = std::move(newSwapchain);
+    GS_INFO("Recreated swapchain at %u x %u, %zu images, %s.", swapchain.extent.width, swapchain.extent.height, swapchain.images.size(),
+            presentModeName(swapchain.presentMode));
+    return true;
+}
+
+void releaseRetiredSwapchains(Swapchain& swapchain, DeletionQueue& deletionQueue)
+{
+    for (RetiredSwapchain& retired : swapchain.retired)
+    {
+        for (VkImageView imageView : retired.imageViews)
+        {
+            deferDestroy(deletionQueue, imageView);
+        }
+
+        for (VkSemaphore semaphore : retired.presentSemaphores)
+        {
+            deferDestroy(deletionQueue, semaphore);
+        }
+
+        deferDestroy(deletionQueue, retired.swapchain);
+    }
+
+    swapchain.retired.clear();
+}
+
 } // namespace Vulkan
 } // namespace GameSmith
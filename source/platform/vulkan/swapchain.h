@@ -8,16 +8,57 @@ namespace gs
 namespace vk
 {
 
+struct DeletionQueue;
+
+// Requested presentation policy. Unsupported present modes fall back to the closest supported one, ending with FIFO which is always
+// available; the image count is clamped to what the surface allows.
+struct SwapchainConfig
+{
+    VkPresentModeKHR presentMode;
+    uint32_t imageCount; // 0 picks a default for the present mode
+};
+
+const char* presentModeName(VkPresentModeKHR presentMode);
+
+// A replaced swapchain. Frame fences don't cover the presentation engine's wait on the present semaphores or its use of the images,
+// so without VK_EXT_swapchain_maintenance1 present fences the only safe point to release these is once an image of a later swapchain
+// has been presented.
+struct RetiredSwapchain
+{
+    VkSwapchainKHR swapchain;
+    std::vector<VkImageView> imageViews;
+    std::vector<VkSemaphore> presentSemaphores;
+};
+
 struct Swapchain
 {
     VkSwapchainKHR swapchain;
     VkExtent2D extent;
+    VkImageUsageFlags imageUsage; // Color attachment, plus transfer destination where the surface supports it
+    VkPresentModeKHR presentMode; // The mode actually in use
     std::vector<VkImage> images;
     std::vector<VkImageView> imageViews;
+    std::vector<VkSemaphore> presentSemaphores; // Indexed by image; the presentation engine holds on to one until the image is reacquired
+    std::vector<RetiredSwapchain> retired;      // Replaced swapchains not yet released, oldest first
 };
 
-bool createSwapchain(VkPhysicalDevice physicalDevice, VkDevice device, VkSurfaceKHR surface, VkSurfaceFormatKHR surfaceFormat, Swapchain& swapchain);
+// Creates a swapchain for the extent in surfaceCaps, which must not be empty. Passing the swapchain being replaced as oldSwapchain
+// lets the presentation engine reuse its resources; the old swapchain still has to be destroyed.
+bool createSwapchain(VkPhysicalDevice physicalDevice, VkDevice device, VkSurfaceKHR surface, VkSurfaceFormatKHR surfaceFormat,
+                     const VkSurfaceCapabilitiesKHR& surfaceCaps, const SwapchainConfig& config, Swapchain& swapchain,
+                     VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
+
+// Also destroys the retired swapchains that were never released
 void destroySwapchain(VkDevice device, Swapchain& swapchain);
 
+// Replaces the swapchain without waiting for the device. The old one is kept in swapchain.retired until
+// releaseRetiredSwapchains().
+bool recreateSwapchain(VkPhysicalDevice physicalDevice, VkDevice device, VkSurfaceKHR surface, VkSurfaceFormatKHR surfaceFormat,
+                       const VkSurfaceCapabilitiesKHR& surfaceCaps, const SwapchainConfig& config, Swapchain& swapchain);
+
+// Call after an image of the current swapchain has been queued for presentation. The retired swapchains go to the deletion queue,
+// which destroys them once the frame that presented has completed, by which time the presentation engine has moved on from them.
+void releaseRetiredSwapchains(Swapchain& swapchain, DeletionQueue& deletionQueue);
+
 } // namespace Vulkan
 } // namespace GameSmith
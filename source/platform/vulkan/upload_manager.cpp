@@ -0,0 +1,350 @@
+#include "gspch.h"
+
+#include "upload_manager.h"
+
+#include "queue_ownership.h"
+
+#include "gamesmith/core/debug.h"
+#include "gamesmith/core/log.h"
+
+namespace gs
+{
+namespace vk
+{
+
+static constexpr VkDeviceSize kStagingAlignment = 16;
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// The release half of an upload only uses the source scope, the acquire half only the destination scope
+static QueueOwnershipTransfer uploadOwnershipTransfer(const UploadManager& uploadManager, VkPipelineStageFlags dstStageMask,
+                                                      VkAccessFlags dstAccessMask)
+{
+    QueueOwnershipTransfer transfer{};
+    transfer.srcQueueFamily = uploadManager.queueFamilyIndex;
+    transfer.dstQueueFamily = uploadManager.dstQueueFamilyIndex;
+    transfer.srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    transfer.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    transfer.dstStageMask = dstStageMask;
+    transfer.dstAccessMask = dstAccessMask;
+    return transfer;
+}
+
+static void waitForTimelineValue(VkDevice device, VkSemaphore timeline, uint64_t timelineValue)
+{
+    VkSemaphoreWaitInfo waitInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &timeline;
+    waitInfo.pValues = &timelineValue;
+    VK_CHECK_RESULT(vkWaitSemaphores(device, &waitInfo, UINT64_MAX));
+}
+
+// Must be called with the mutex held.
+static void retireSubmissions(UploadManager& uploadManager)
+{
+    uint64_t completedValue{};
+    VK_CHECK_RESULT(vkGetSemaphoreCounterValue(uploadManager.device, uploadManager.timeline, &completedValue));
+
+    while (!uploadManager.submissions.empty() && uploadManager.submissions.front().timelineValue <= completedValue)
+    {
+        UploadManager::Submission& submission = uploadManager.submissions.front();
+        uploadManager.ringUsed -= submission.ringBytes;
+        uploadManager.freeCommandBuffers.push_back(submission.commandBuffer);
+        uploadManager.submissions.pop_front();
+    }
+
+    if (uploadManager.ringUsed == 0)
+    {
+        uploadManager.ringHead = 0;
+    }
+}
+
+// Must be called with the mutex held. The ring is the region [tail, head) of the staging buffer, possibly wrapping around the end; the
+// space between head and the end of the buffer is wasted when an allocation doesn't fit there.
+static bool allocateStaging(UploadManager& uploadManager, VkDeviceSize size, VkDeviceSize& offset)
+{
+    VkDeviceSize capacity = uploadManager.stagingBuffer.size;
+    VkDeviceSize head = uploadManager.ringHead;
+    VkDeviceSize tail = (head + capacity - uploadManager.ringUsed) % capacity;
+    VkDeviceSize alignedHead = alignUp(head, kStagingAlignment);
+
+    if (uploadManager.ringUsed == 0 || head > tail)
+    {
+        if (alignedHead + size <= capacity)
+        {
+            offset = alignedHead;
+        }
+        else if (size <= tail)
+        {
+            offset = 0;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else if (alignedHead + size <= tail)
+    {
+        offset = alignedHead;
+    }
+    else
+    {
+        return false;
+    }
+
+    VkDeviceSize consumed = (offset >= head) ? (offset + size - head) : (capacity - head + offset + size);
+    uploadManager.ringHead = offset + size;
+    uploadManager.ringUsed += consumed;
+    uploadManager.pendingBytes += consumed;
+    return true;
+}
+
+// Must be called with the mutex held.
+static uint64_t submitPendingCopies(UploadManager& uploadManager)
+{
+    retireSubmissions(uploadManager);
+
+    VkCommandBuffer commandBuffer{};
+
+    if (!uploadManager.freeCommandBuffers.empty())
+    {
+        commandBuffer = uploadManager.freeCommandBuffers.back();
+        uploadManager.freeCommandBuffers.pop_back();
+    }
+    else
+    {
+        VkCommandBufferAllocateInfo allocInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+        allocInfo.commandPool = uploadManager.commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        VK_CHECK_RESULT(vkAllocateCommandBuffers(uploadManager.device, &allocInfo, &commandBuffer));
+    }
+
+    VkCommandBufferBeginInfo beginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+    // Batch the regions for each destination buffer into a single copy command
+    std::vector<UploadManager::PendingCopy>& copies = uploadManager.pendingCopies;
+    std::stable_sort(copies.begin(), copies.end(),
+                     [](const UploadManager::PendingCopy& lhs, const UploadManager::PendingCopy& rhs) { return lhs.dstBuffer < rhs.dstBuffer; });
+
+    std::vector<VkBufferCopy> regions;
+    regions.reserve(copies.size());
+
+    for (size_t first = 0; first < copies.size();)
+    {
+        size_t last = first;
+        regions.clear();
+
+        for (; last < copies.size() && copies[last].dstBuffer == copies[first].dstBuffer; ++last)
+        {
+            regions.push_back(copies[last].region);
+        }
+
+        vkCmdCopyBuffer(commandBuffer, uploadManager.stagingBuffer.buffer, copies[first].dstBuffer, uint32_t(regions.size()), regions.data());
+        first = last;
+    }
+
+    uint64_t timelineValue = uploadManager.nextTimelineValue++;
+
+    if (uploadManager.queueFamilyIndex != uploadManager.dstQueueFamilyIndex)
+    {
+        QueueOwnershipTransfer transfer = uploadOwnershipTransfer(uploadManager, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+
+        for (const UploadManager::PendingCopy& copy : copies)
+        {
+            releaseBufferOwnership(commandBuffer, transfer, copy.dstBuffer, copy.region.dstOffset, copy.region.size);
+            uploadManager.releases.push_back({ copy.dstBuffer, copy.region.dstOffset, copy.region.size, timelineValue });
+        }
+    }
+
+    VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{ VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+    timelineSubmitInfo.signalSemaphoreValueCount = 1;
+    timelineSubmitInfo.pSignalSemaphoreValues = &timelineValue;
+
+    VkSubmitInfo submitInfo{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    submitInfo.pNext = &timelineSubmitInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &uploadManager.timeline;
+    VK_CHECK_RESULT(vkQueueSubmit(uploadManager.queue, 1, &submitInfo, VK_NULL_HANDLE));
+
+    uploadManager.submissions.push_back({ commandBuffer, timelineValue, uploadManager.pendingBytes });
+    uploadManager.pendingBytes = 0;
+    copies.clear();
+
+    uploadManager.flushed.notify_all();
+    return timelineValue;
+}
+
+void createUploadManager(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, uint32_t dstQueueFamilyIndex,
+                         VkDeviceSize stagingSize, UploadManager& uploadManager)
+{
+    uploadManager.device = device;
+    uploadManager.queueFamilyIndex = queueFamilyIndex;
+    uploadManager.dstQueueFamilyIndex = dstQueueFamilyIndex;
+    uploadManager.ownerThread = std::this_thread::get_id();
+    vkGetDeviceQueue(device, queueFamilyIndex, 0, &uploadManager.queue);
+    GS_ASSERT(uploadManager.queue);
+
+    VkCommandPoolCreateInfo commandPoolCreateInfo{ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+    VK_CHECK_RESULT(vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &uploadManager.commandPool));
+
+    VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+    semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    semaphoreTypeCreateInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+    semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+    VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &uploadManager.timeline));
+
+    uploadManager.stagingBuffer = createBuffer(physicalDevice, device, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, { queueFamilyIndex });
+    GS_ASSERT(uploadManager.stagingBuffer.buffer);
+
+    uploadManager.ringHead = 0;
+    uploadManager.ringUsed = 0;
+    uploadManager.pendingBytes = 0;
+    uploadManager.nextTimelineValue = 1;
+}
+
+void destroyUploadManager(UploadManager& uploadManager)
+{
+    waitForTimelineValue(uploadManager.device, uploadManager.timeline, uploadManager.nextTimelineValue - 1);
+
+    destroyBuffer(uploadManager.device, uploadManager.stagingBuffer);
+    vkDestroySemaphore(uploadManager.device, uploadManager.timeline, nullptr);
+    vkDestroyCommandPool(uploadManager.device, uploadManager.commandPool, nullptr);
+
+    uploadManager.submissions.clear();
+    uploadManager.freeCommandBuffers.clear();
+    uploadManager.pendingCopies.clear();
+    uploadManager.releases.clear();
+}
+
+uint64_t uploadBuffer(UploadManager& uploadManager, VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+    // Large uploads are streamed through the ring in chunks so they never need more than half of it at once
+    VkDeviceSize maxChunkSize = uploadManager.stagingBuffer.size / 2;
+    const uint8_t* src = (const uint8_t*)data;
+    uint64_t timelineValue{};
+
+    std::unique_lock<std::mutex> lock(uploadManager.mutex);
+
+    while (size)
+    {
+        VkDeviceSize chunkSize = std::min(size, maxChunkSize);
+        VkDeviceSize srcOffset{};
+
+        while (!allocateStaging(uploadManager, chunkSize, srcOffset))
+        {
+            retireSubmissions(uploadManager);
+
+            if (allocateStaging(uploadManager, chunkSize, srcOffset))
+            {
+                break;
+            }
+
+            if (!uploadManager.submissions.empty())
+            {
+                uint64_t waitValue = uploadManager.submissions.front().timelineValue;
+                lock.unlock();
+                waitForTimelineValue(uploadManager.device, uploadManager.timeline, waitValue);
+                lock.lock();
+            }
+            else if (std::this_thread::get_id() == uploadManager.ownerThread)
+            {
+                submitPendingCopies(uploadManager);
+            }
+            else
+            {
+                // Only the owning thread may submit; wait for it to flush the copies that are filling the ring
+                uploadManager.flushed.wait(lock);
+            }
+        }
+
+        memcpy((uint8_t*)uploadManager.stagingBuffer.mappedMemory + srcOffset, src, size_t(chunkSize));
+
+        UploadManager::PendingCopy copy{};
+        copy.dstBuffer = dstBuffer;
+        copy.region.srcOffset = srcOffset;
+        copy.region.dstOffset = dstOffset;
+        copy.region.size = chunkSize;
+        uploadManager.pendingCopies.push_back(copy);
+
+        timelineValue = uploadManager.nextTimelineValue;
+        src += chunkSize;
+        dstOffset += chunkSize;
+        size -= chunkSize;
+    }
+
+    return timelineValue;
+}
+
+uint64_t flushUploads(UploadManager& uploadManager)
+{
+    GS_ASSERT(std::this_thread::get_id() == uploadManager.ownerThread);
+    std::lock_guard<std::mutex> lock(uploadManager.mutex);
+
+    if (uploadManager.pendingCopies.empty())
+    {
+        retireSubmissions(uploadManager);
+        return uploadManager.nextTimelineValue - 1;
+    }
+
+    return submitPendingCopies(uploadManager);
+}
+
+uint64_t acquireUploads(UploadManager& uploadManager, VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+{
+    GS_ASSERT(std::this_thread::get_id() == uploadManager.ownerThread);
+    std::lock_guard<std::mutex> lock(uploadManager.mutex);
+
+    uint64_t completedValue{};
+    VK_CHECK_RESULT(vkGetSemaphoreCounterValue(uploadManager.device, uploadManager.timeline, &completedValue));
+
+    // Only completed uploads are acquired, so the acquiring submission never waits for the transfer queue
+    QueueOwnershipTransfer transfer = uploadOwnershipTransfer(uploadManager, dstStageMask, dstAccessMask);
+    uint64_t waitValue = 0;
+    size_t kept = 0;
+
+    for (const UploadManager::OwnershipRelease& release : uploadManager.releases)
+    {
+        if (release.timelineValue <= completedValue)
+        {
+            acquireBufferOwnership(commandBuffer, transfer, release.buffer, release.offset, release.size);
+            waitValue = std::max(waitValue, release.timelineValue);
+        }
+        else
+        {
+            uploadManager.releases[kept++] = release;
+        }
+    }
+
+    uploadManager.releases.resize(kept);
+    return waitValue;
+}
+
+bool isUploadComplete(UploadManager& uploadManager, uint64_t timelineValue)
+{
+    uint64_t completedValue{};
+    VK_CHECK_RESULT(vkGetSemaphoreCounterValue(uploadManager.device, uploadManager.timeline, &completedValue));
+    return completedValue >= timelineValue;
+}
+
+void waitForUpload(UploadManager& uploadManager, uint64_t timelineValue)
+{
+    waitForTimelineValue(uploadManager.device, uploadManager.timeline, timelineValue);
+}
+
+} // namespace Vulkan
+} // namespace GameSmith
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "gsvulkan.h"
+
+#include "buffer.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace gs
+{
+namespace vk
+{
+
+// Streams data into device local memory through a host visible staging ring buffer. Uploads may be queued from any thread; they are
+// batched and submitted to the transfer queue by flushUploads(), which must be called from the thread that owns the queue (once per
+// frame is the expected pattern). Completion is tracked with a timeline semaphore: each upload returns the semaphore value that will
+// be signalled once its data is resident.
+//
+// Destination buffers are created with exclusive sharing by the queue family that consumes them. When uploads run on a different
+// family, each submission releases the regions it wrote to that family, and acquireUploads() records the matching acquires.
+struct UploadManager
+{
+    struct PendingCopy
+    {
+        VkBuffer dstBuffer;
+        VkBufferCopy region;
+    };
+
+    struct OwnershipRelease
+    {
+        VkBuffer buffer;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        uint64_t timelineValue;
+    };
+
+    struct Submission
+    {
+        VkCommandBuffer commandBuffer;
+        uint64_t timelineValue;
+        VkDeviceSize ringBytes;
+    };
+
+    VkDevice device;
+    VkQueue queue;
+    uint32_t queueFamilyIndex;
+    uint32_t dstQueueFamilyIndex; // Family the destination buffers belong to
+    VkCommandPool commandPool;
+    VkSemaphore timeline;
+
+    Buffer stagingBuffer;
+    VkDeviceSize ringHead;
+    VkDeviceSize ringUsed;
+    VkDeviceSize pendingBytes;
+
+    uint64_t nextTimelineValue;
+    std::vector<PendingCopy> pendingCopies;
+    std::deque<Submission> submissions;
+    std::vector<OwnershipRelease> releases; // Regions released to dstQueueFamilyIndex and not yet acquired
+    std::vector<VkCommandBuffer> freeCommandBuffers;
+
+    std::thread::id ownerThread;
+    std::mutex mutex;
+    std::condition_variable flushed;
+};
+
+void createUploadManager(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, uint32_t dstQueueFamilyIndex,
+                         VkDeviceSize stagingSize, UploadManager& uploadManager);
+void destroyUploadManager(UploadManager& uploadManager);
+
+// Copies size bytes from data into the staging ring and queues a copy to dstBuffer at dstOffset. Blocks if the ring is full until
+// enough previous uploads have retired. Returns the timeline value signalled when the copy has completed.
+uint64_t uploadBuffer(UploadManager& uploadManager, VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+// Records all pending copies into one command buffer and submits them. Returns the timeline value of the submission, or the last
+// submitted value if there was nothing to do.
+uint64_t flushUploads(UploadManager& uploadManager);
+
+// Records the acquire of every region whose upload has completed into commandBuffer, which must be submitted to a queue of
+// dstQueueFamilyIndex, for the given first uses of the data. The submission must wait on the timeline for the returned value, which is
+// already signalled; it is 0 when there was nothing to acquire. Only the thread that owns the upload queue may call this, and every
+// upload must be acquired before its data is used.
+uint64_t acquireUploads(UploadManager& uploadManager, VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask);
+
+bool isUploadComplete(UploadManager& uploadManager, uint64_t timelineValue);
+void waitForUpload(UploadManager& uploadManager, uint64_t timelineValue);
+
+} // namespace Vulkan
+} // namespace GameSmith
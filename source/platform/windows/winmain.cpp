@@ -2,52 +2,77 @@
 
 #include "gamesmith/core/core.h"
 #include "gamesmith/core/debug.h"
+#include "gamesmith/core/file_watcher.h"
+#include "gamesmith/core/frame_limiter.h"
 #include "gamesmith/core/log.h"
+#include "gamesmith/core/thread_pool.h"
 #include "gamesmith/core/window.h"
 #include "gamesmith/math/math.h"
 #include "gamesmith/math/mat44.h"
 #include "gamesmith/math/vec3.h"
 #include "gamesmith/renderer/obj_loader.h"
 #include "platform/vulkan/gsvulkan.h"
+#include "platform/vulkan/bindless_heap.h"
+#include "platform/vulkan/buffer.h"
+#include "platform/vulkan/deletion_queue.h"
 #include "platform/vulkan/device.h"
+#include "platform/vulkan/frame.h"
+#include "platform/vulkan/frame_allocator.h"
+#include "platform/vulkan/gpu_culling.h"
+#include "platform/vulkan/gpu_profiler.h"
+#include "platform/vulkan/gpu_scene.h"
+#include "platform/vulkan/pipeline_cache.h"
+#include "platform/vulkan/pipeline_layout.h"
+#include "platform/vulkan/pipeline_statistics.h"
+#include "platform/vulkan/pipeline_variants.h"
+#include "platform/vulkan/present_latency.h"
+#include "platform/vulkan/render_graph.h"
 #include "platform/vulkan/shader_module.h"
 #include "platform/vulkan/swapchain.h"
+#include "platform/vulkan/upload_manager.h"
 
+#include <cerrno>
+#include <chrono>
+#include <cmath>
 #include <filesystem>
 #include <fstream>
+#include <future>
+#include <thread>
 #include <imgui.h>
 #include <backends/imgui_impl_win32.h>
 #include <backends/imgui_impl_vulkan.h>
 
 #define ORTHO 0
 
-struct ComHelper
-{
-    ComHelper() { CoInitializeEx(0, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE); }
-    ~ComHelper() { CoUninitialize(); }
-};
+static const char* kPipelineCachePath = "pipeline_cache.bin";
+static const char* kPipelineManifestPath = "pipeline_variants.txt";
 
-struct Buffer
-{
-    VkBuffer buffer;
-    VkDeviceMemory gpuMemory;
-    VkDeviceSize size;
-    void* mappedMemory;
-};
+#if GS_ENABLE_HOT_RELOAD
+// Run from the working directory, where the build writes the SPIR-V the engine loads, see project/build_shaders.py
+static const char* kShaderSourceDirectory = "../../source/platform/vulkan/shaders";
+#if defined(GS_DEBUG)
+static const wchar_t* kShaderBuildCommand = L"python ../build_shaders.py --config Debug --output . --cache _builds/shader_cache "
+                                            L"../../source/platform/vulkan/shaders";
+#else
+static const wchar_t* kShaderBuildCommand = L"python ../build_shaders.py --config Development --output . --cache _builds/shader_cache "
+                                            L"../../source/platform/vulkan/shaders";
+#endif
+#endif
 
-struct Image
-{
-    VkImage image;
-    VkDeviceMemory gpuMemory;
-};
+// Without indirect drawing, below this many draws a pass isn't worth splitting across recording threads
+static const uint32_t kMinDrawsPerJob = 256;
+
+// Draws surviving GPU culling per frame; meshlet culling emits one draw per visible meshlet
+static const uint32_t kMaxCulledDraws = 512 * 1024;
+
+// Accepted range of --frames-in-flight. Beyond a few frames the CPU only runs further ahead, adding latency, while every frame costs
+// command pools, query pools, bindless ranges, allocator pages and deletion queue slots.
+static const uint32_t kMaxFramesInFlight = 4;
 
-struct Framebuffer
+struct ComHelper
 {
-    Image colorBuffer;
-    Image depthBuffer;
-    VkImageView colorBufferView;
-    VkImageView depthBufferView;
-    VkFramebuffer framebuffer;
+    ComHelper() { CoInitializeEx(0, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE); }
+    ~ComHelper() { CoUninitialize(); }
 };
 
 struct MeshVertex
@@ -56,18 +81,13 @@ struct MeshVertex
     float nx, ny, nz;
 };
 
-struct Mesh
-{
-    uint32_t vertexCount;
-    Buffer vertexBuffer;
-    uint32_t indexCount;
-    Buffer indexBuffer;
-};
-
 struct alignas(16) ShaderGlobals
 {
     gs::mat44 proj;
     gs::mat44 view;
+    gs::vk::GpuDrawConstants draw; // Per-draw copies set drawUniforms and carry the draw's constants
+    uint32_t objectBuffer;
+    uint32_t drawUniforms;
 };
 
 VkDebugUtilsMessengerEXT debugMessenger{};
@@ -166,181 +186,6 @@ VkSurfaceFormatKHR chooseSurfaceFormat(VkPhysicalDevice physicalDevice, VkSurfac
     return surfaceFormat;
 }
 
-void createFrameResources(VkDevice device, gs::vk::Swapchain& swapchain, VkCommandPool commandPool, std::vector<VkCommandBuffer>& commandBuffers,
-                          std::vector<VkFence>& fences)
-{
-    uint32_t swapchainImageCount = uint32_t(swapchain.images.size());
-
-    commandBuffers.resize(swapchainImageCount);
-
-    VkCommandBufferAllocateInfo allocInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
-    allocInfo.commandPool = commandPool;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = swapchainImageCount;
-    VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()));
-
-    fences.resize(swapchainImageCount);
-
-    for (uint32_t i = 0; i < swapchainImageCount; ++i)
-    {
-        VkFenceCreateInfo createInfo{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
-        createInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-        VK_CHECK_RESULT(vkCreateFence(device, &createInfo, nullptr, &fences[i]));
-    }
-}
-
-void destroyFrameResources(VkDevice device, VkCommandPool commandPool, std::vector<VkCommandBuffer>& commandBuffers, std::vector<VkFence>& fences)
-{
-    for (VkFence& fence : fences)
-    {
-        vkDestroyFence(device, fence, nullptr);
-    }
-
-    fences.clear();
-
-    vkFreeCommandBuffers(device, commandPool, uint32_t(commandBuffers.size()), commandBuffers.data());
-    commandBuffers.clear();
-}
-
-VkRenderPass createRenderPass(VkDevice device, VkFormat colorFormat, VkFormat depthFormat)
-{
-    VkAttachmentDescription attachments[2]{};
-    attachments[0].format = colorFormat;
-    attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
-    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    attachments[1].format = depthFormat;
-    attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
-    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentReference colorAttachments[1]{};
-    colorAttachments[0].attachment = 0;
-    colorAttachments[0].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentReference depthStencilAttachment{};
-    depthStencilAttachment.attachment = 1;
-    depthStencilAttachment.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    VkSubpassDescription subpasses[1]{};
-    subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpasses[0].colorAttachmentCount = GS_ARRAY_COUNT(colorAttachments);
-    subpasses[0].pColorAttachments = colorAttachments;
-    subpasses[0].pDepthStencilAttachment = &depthStencilAttachment;
-
-    VkRenderPassCreateInfo createInfo{ VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
-    createInfo.attachmentCount = GS_ARRAY_COUNT(attachments);
-    createInfo.pAttachments = attachments;
-    createInfo.subpassCount = GS_ARRAY_COUNT(subpasses);
-    createInfo.pSubpasses = subpasses;
-
-    VkRenderPass renderPass{};
-    VK_CHECK_RESULT(vkCreateRenderPass(device, &createInfo, nullptr, &renderPass));
-    return renderPass;
-}
-
-VkCommandPool createCommandPool(VkDevice device, uint32_t queueFamilyIndex)
-{
-    VkCommandPoolCreateInfo createInfo{ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
-    createInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-    createInfo.queueFamilyIndex = queueFamilyIndex;
-
-    VkCommandPool commandPool{};
-    VK_CHECK_RESULT(vkCreateCommandPool(device, &createInfo, nullptr, &commandPool));
-    return commandPool;
-}
-
-using ShaderList = std::initializer_list<gs::vk::ShaderModule>;
-
-VkPipeline createGraphicsPipeline(VkDevice device, VkRenderPass renderPass, VkPipelineLayout layout, ShaderList shaders)
-{
-    std::vector<VkPipelineShaderStageCreateInfo> stages{};
-
-    for (auto& shader : shaders)
-    {
-        VkPipelineShaderStageCreateInfo createInfo{ VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
-        createInfo.stage = shader.stage;
-        createInfo.module = shader.shader;
-        createInfo.pName = shader.entryPoint.c_str();
-        stages.push_back(createInfo);
-    }
-
-    VkVertexInputBindingDescription vertexBindingDescriptions[1] = { { 0, sizeof(MeshVertex), VK_VERTEX_INPUT_RATE_VERTEX } };
-    VkVertexInputAttributeDescription vertexAttributeDescriptions[2] = { { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 },
-                                                                         { 1, 0, VK_FORMAT_R32G32B32_SFLOAT, 12 } };
-
-    VkPipelineVertexInputStateCreateInfo vertexInputState{ VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
-    vertexInputState.vertexBindingDescriptionCount = GS_ARRAY_COUNT(vertexBindingDescriptions);
-    vertexInputState.pVertexBindingDescriptions = vertexBindingDescriptions;
-    vertexInputState.vertexAttributeDescriptionCount = GS_ARRAY_COUNT(vertexAttributeDescriptions);
-    vertexInputState.pVertexAttributeDescriptions = vertexAttributeDescriptions;
-
-    VkPipelineInputAssemblyStateCreateInfo inputAssemblyState{ VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
-    inputAssemblyState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-
-    VkPipelineViewportStateCreateInfo viewportState{ VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
-    viewportState.viewportCount = 1;
-    viewportState.scissorCount = 1;
-
-    VkPipelineRasterizationStateCreateInfo rasterizationState{ VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
-    rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizationState.cullMode = VK_CULL_MODE_NONE; //VK_CULL_MODE_BACK_BIT;
-    rasterizationState.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-    rasterizationState.lineWidth = 1.0f;
-
-    VkPipelineMultisampleStateCreateInfo multisampleState{ VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
-    multisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-    VkPipelineDepthStencilStateCreateInfo depthStencilState{ VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
-    depthStencilState.depthTestEnable = VK_TRUE;
-    depthStencilState.depthWriteEnable = VK_TRUE;
-    depthStencilState.depthCompareOp = VK_COMPARE_OP_GREATER;
-
-    VkPipelineColorBlendAttachmentState colorBlendStateAttachements[1]{};
-    colorBlendStateAttachements[0].colorWriteMask =
-            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-
-    VkPipelineColorBlendStateCreateInfo colorBlendState{ VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
-    colorBlendState.attachmentCount = GS_ARRAY_COUNT(colorBlendStateAttachements);
-    colorBlendState.pAttachments = colorBlendStateAttachements;
-
-    VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
-    VkPipelineDynamicStateCreateInfo dynamicState{ VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
-    dynamicState.dynamicStateCount = GS_ARRAY_COUNT(dynamicStates);
-    dynamicState.pDynamicStates = dynamicStates;
-
-    VkGraphicsPipelineCreateInfo createInfo{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
-    createInfo.stageCount = uint32_t(stages.size());
-    createInfo.pStages = stages.data();
-    createInfo.pVertexInputState = &vertexInputState;
-    createInfo.pInputAssemblyState = &inputAssemblyState;
-    createInfo.pViewportState = &viewportState;
-    createInfo.pRasterizationState = &rasterizationState;
-    createInfo.pMultisampleState = &multisampleState;
-    createInfo.pDepthStencilState = &depthStencilState;
-    createInfo.pColorBlendState = &colorBlendState;
-    createInfo.pDynamicState = &dynamicState;
-    createInfo.layout = layout;
-    createInfo.renderPass = renderPass;
-
-    VkPipeline pipeline{};
-    VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &pipeline));
-    return pipeline;
-}
-
-VkSemaphore gsCreateSemaphore(VkDevice device)
-{
-    VkSemaphoreCreateInfo createInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
-    VkSemaphore semaphore{};
-    VK_CHECK_RESULT(vkCreateSemaphore(device, &createInfo, nullptr, &semaphore));
-    return semaphore;
-}
-
 std::string gsWcharToUtf8(const wchar_t* wstring)
 {
     int utf8_len = WideCharToMultiByte(CP_UTF8, 0, wstring, -1, NULL, 0, NULL, NULL);
@@ -350,93 +195,6 @@ std::string gsWcharToUtf8(const wchar_t* wstring)
     return utf8;
 }
 
-uint32_t getMemoryTypeIndex(VkPhysicalDevice physicalDevice, VkMemoryRequirements& memoryRequirements, VkMemoryPropertyFlags requiredProperties)
-{
-    VkPhysicalDeviceMemoryProperties memoryProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
-
-    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
-    {
-        VkMemoryType& memoryType = memoryProperties.memoryTypes[i];
-
-        if ((memoryRequirements.memoryTypeBits & (1 << i)) && (memoryType.propertyFlags & requiredProperties) == requiredProperties)
-        {
-            return i;
-        }
-    }
-
-    return UINT32_MAX;
-}
-
-using QueueFamilyIndices = std::initializer_list<uint32_t>;
-
-Buffer createBuffer(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t size, VkBufferUsageFlags usage, QueueFamilyIndices queues)
-{
-    Buffer buffer{};
-
-    std::vector<uint32_t> queueFamilyIndices{};
-
-    for (auto& queueIndex : queues)
-    {
-        queueFamilyIndices.push_back(queueIndex);
-    }
-
-    VkBufferCreateInfo createInfo{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
-    createInfo.size = size;
-    createInfo.usage = usage;
-    createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    createInfo.queueFamilyIndexCount = uint32_t(queueFamilyIndices.size());
-    createInfo.pQueueFamilyIndices = queueFamilyIndices.data();
-
-    VK_CHECK_RESULT(vkCreateBuffer(device, &createInfo, nullptr, &buffer.buffer));
-
-    VkMemoryRequirements memoryRequirements;
-    vkGetBufferMemoryRequirements(device, buffer.buffer, &memoryRequirements);
-    buffer.size = memoryRequirements.size;
-
-    VkMemoryAllocateInfo allocateInfo{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
-    allocateInfo.allocationSize = memoryRequirements.size;
-    allocateInfo.memoryTypeIndex =
-            getMemoryTypeIndex(physicalDevice, memoryRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    GS_ASSERT(allocateInfo.memoryTypeIndex != UINT32_MAX);
-    VK_CHECK_RESULT(vkAllocateMemory(device, &allocateInfo, nullptr, &buffer.gpuMemory));
-    VK_CHECK_RESULT(vkBindBufferMemory(device, buffer.buffer, buffer.gpuMemory, 0));
-    VK_CHECK_RESULT(vkMapMemory(device, buffer.gpuMemory, 0, buffer.size, 0, &buffer.mappedMemory));
-
-    return buffer;
-}
-
-void destroyBuffer(VkDevice device, Buffer& buffer)
-{
-    vkDestroyBuffer(device, buffer.buffer, nullptr);
-    vkUnmapMemory(device, buffer.gpuMemory);
-    vkFreeMemory(device, buffer.gpuMemory, nullptr);
-    buffer = Buffer{};
-}
-
-void createImage(VkPhysicalDevice physicalDevice, VkDevice device, VkImageCreateInfo& createInfo, Image& image)
-{
-    VK_CHECK_RESULT(vkCreateImage(device, &createInfo, nullptr, &image.image));
-
-    VkMemoryRequirements memoryRequirements;
-    vkGetImageMemoryRequirements(device, image.image, &memoryRequirements);
-
-    VkMemoryAllocateInfo allocateInfo{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
-    allocateInfo.allocationSize = memoryRequirements.size;
-    allocateInfo.memoryTypeIndex = getMemoryTypeIndex(physicalDevice, memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    GS_ASSERT(allocateInfo.memoryTypeIndex != UINT32_MAX);
-
-    VK_CHECK_RESULT(vkAllocateMemory(device, &allocateInfo, nullptr, &image.gpuMemory));
-    VK_CHECK_RESULT(vkBindImageMemory(device, image.image, image.gpuMemory, 0));
-}
-
-void destroyImage(VkDevice device, Image& image)
-{
-    vkDestroyImage(device, image.image, nullptr);
-    vkFreeMemory(device, image.gpuMemory, nullptr);
-    image = Image{};
-}
-
 struct MeshVertexHasher
 {
     static uint64_t floatbits(float f, uint8_t numbits)
@@ -464,7 +222,8 @@ struct MeshVertexComparer
     bool operator()(const MeshVertex& lhs, const MeshVertex& rhs) const { return memcmp(&lhs, &rhs, sizeof(MeshVertex)) == 0; }
 };
 
-Mesh loadObjFile(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t graphicsQueueFamilyIndex, const std::string& path)
+// Safe to call from a worker thread; the returned mesh must not be drawn until its upload has completed.
+uint32_t loadObjFile(gs::vk::GpuScene& scene, gs::vk::UploadManager& uploadManager, const std::string& path)
 {
     gs::ObjFile objFile{};
     objFile.load(path);
@@ -507,102 +266,76 @@ Mesh loadObjFile(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t grap
         }
     }
 
-    Mesh mesh{};
+    return gs::vk::addGpuMesh(scene, uploadManager, vbdata.data(), uint32_t(vbdata.size()), ibdata.data(), uint32_t(ibdata.size()));
+}
 
-    mesh.vertexCount = uint32_t(vbdata.size());
-    mesh.vertexBuffer = createBuffer(physicalDevice, device, mesh.vertexCount * sizeof(MeshVertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                                     { graphicsQueueFamilyIndex });
-    memcpy(mesh.vertexBuffer.mappedMemory, vbdata.data(), vbdata.size() * sizeof(MeshVertex));
+// Command line values are parsed without exceptions; a malformed value leaves value untouched so the caller can keep its default
+bool parseUnsigned(const std::string& text, uint32_t& value)
+{
+    if (text.empty() || !isdigit((unsigned char)text[0]))
+    {
+        return false;
+    }
 
-    mesh.indexCount = uint32_t(ibdata.size());
-    mesh.indexBuffer =
-            createBuffer(physicalDevice, device, mesh.indexCount * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, { graphicsQueueFamilyIndex });
-    memcpy(mesh.indexBuffer.mappedMemory, ibdata.data(), ibdata.size() * sizeof(uint32_t));
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long parsed = strtoull(text.c_str(), &end, 10);
 
-    return mesh;
-}
+    if (errno == ERANGE || *end != '\0' || parsed > UINT32_MAX)
+    {
+        return false;
+    }
 
-void destroyMesh(VkDevice device, Mesh& mesh)
-{
-    destroyBuffer(device, mesh.vertexBuffer);
-    destroyBuffer(device, mesh.indexBuffer);
+    value = uint32_t(parsed);
+    return true;
 }
 
-void createFramebuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkExtent2D extent, VkRenderPass renderPass, VkFormat colorFormat,
-                       VkFormat depthFormat, Framebuffer& framebuffer)
+bool parseFloat(const std::string& text, float& value)
 {
-    VkImageCreateInfo colorBufferImageCreateInfo{ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
-    colorBufferImageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-    colorBufferImageCreateInfo.format = colorFormat;
-    colorBufferImageCreateInfo.extent = { extent.width, extent.height, 1 };
-    colorBufferImageCreateInfo.mipLevels = 1;
-    colorBufferImageCreateInfo.arrayLayers = 1;
-    colorBufferImageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorBufferImageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    colorBufferImageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-    colorBufferImageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    colorBufferImageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    createImage(physicalDevice, device, colorBufferImageCreateInfo, framebuffer.colorBuffer);
-
-    VkImageViewCreateInfo colorBufferImageViewCreateInfo{ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
-    colorBufferImageViewCreateInfo.image = framebuffer.colorBuffer.image;
-    colorBufferImageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    colorBufferImageViewCreateInfo.format = colorFormat;
-    colorBufferImageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    colorBufferImageViewCreateInfo.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
-    colorBufferImageViewCreateInfo.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
-    VK_CHECK_RESULT(vkCreateImageView(device, &colorBufferImageViewCreateInfo, nullptr, &framebuffer.colorBufferView));
-
-    VkImageCreateInfo depthBufferImageCreateInfo{ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
-    depthBufferImageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-    depthBufferImageCreateInfo.format = depthFormat;
-    depthBufferImageCreateInfo.extent = { extent.width, extent.height, 1 };
-    depthBufferImageCreateInfo.mipLevels = 1;
-    depthBufferImageCreateInfo.arrayLayers = 1;
-    depthBufferImageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-    depthBufferImageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    depthBufferImageCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-    depthBufferImageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    depthBufferImageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    createImage(physicalDevice, device, depthBufferImageCreateInfo, framebuffer.depthBuffer);
-
-    VkImageViewCreateInfo depthBufferImageViewCreateInfo{ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
-    depthBufferImageViewCreateInfo.image = framebuffer.depthBuffer.image;
-    depthBufferImageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    depthBufferImageViewCreateInfo.format = VK_FORMAT_D32_SFLOAT;
-    depthBufferImageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-    depthBufferImageViewCreateInfo.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
-    depthBufferImageViewCreateInfo.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
-    VK_CHECK_RESULT(vkCreateImageView(device, &depthBufferImageViewCreateInfo, nullptr, &framebuffer.depthBufferView));
-
-    VkImageView framebufferImageViews[2] = { framebuffer.colorBufferView, framebuffer.depthBufferView };
-    VkFramebufferCreateInfo framebufferCreateInfo{ VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
-    framebufferCreateInfo.renderPass = renderPass;
-    framebufferCreateInfo.attachmentCount = 2;
-    framebufferCreateInfo.pAttachments = framebufferImageViews;
-    framebufferCreateInfo.width = extent.width;
-    framebufferCreateInfo.height = extent.height;
-    framebufferCreateInfo.layers = 1;
-    VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &framebuffer.framebuffer));
+    if (text.empty() || isspace((unsigned char)text[0]))
+    {
+        return false;
+    }
+
+    char* end = nullptr;
+    errno = 0;
+    float parsed = strtof(text.c_str(), &end);
+
+    if (errno == ERANGE || *end != '\0' || !std::isfinite(parsed))
+    {
+        return false;
+    }
+
+    value = parsed;
+    return true;
 }
 
-void destroyFramebuffer(VkDevice device, Framebuffer& framebuffer)
+bool parsePresentMode(const std::string& name, VkPresentModeKHR& presentMode)
 {
-    vkDestroyFramebuffer(device, framebuffer.framebuffer, nullptr);
-    vkDestroyImageView(device, framebuffer.depthBufferView, nullptr);
-    vkDestroyImageView(device, framebuffer.colorBufferView, nullptr);
-    destroyImage(device, framebuffer.depthBuffer);
-    destroyImage(device, framebuffer.colorBuffer);
+    static const std::pair<const char*, VkPresentModeKHR> presentModes[] = { { "fifo", VK_PRESENT_MODE_FIFO_KHR },
+                                                                             { "fifo-relaxed", VK_PRESENT_MODE_FIFO_RELAXED_KHR },
+                                                                             { "mailbox", VK_PRESENT_MODE_MAILBOX_KHR },
+                                                                             { "immediate", VK_PRESENT_MODE_IMMEDIATE_KHR } };
+
+    for (const auto& mode : presentModes)
+    {
+        if (name == mode.first)
+        {
+            presentMode = mode.second;
+            return true;
+        }
+    }
+
+    return false;
 }
 
 struct ImguiData
 {
     VkDescriptorPool descriptorPool;
-    VkRenderPass renderPass;
 };
 
 ImguiData initImgui(gs::Window* window, VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, VkQueue queue,
-                    VkFormat colorBufferFormat, VkFormat depthBufferFormat, VkCommandBuffer commandBuffer)
+                    VkPipelineCache pipelineCache, VkRenderPass renderPass, uint32_t framesInFlight, VkCommandBuffer commandBuffer)
 {
     ImguiData result{};
 
@@ -621,58 +354,22 @@ ImguiData initImgui(gs::Window* window, VkInstance instance, VkPhysicalDevice ph
     descriptorPoolCreateInfo.pPoolSizes = poolSizes;
     VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &result.descriptorPool));
 
-    VkAttachmentDescription attachments[2]{};
-    attachments[0].format = colorBufferFormat;
-    attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
-    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
-    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    attachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    attachments[1].format = depthBufferFormat;
-    attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
-    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentReference colorAttachments[1]{};
-    colorAttachments[0].attachment = 0;
-    colorAttachments[0].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentReference depthStencilAttachment{};
-    depthStencilAttachment.attachment = 1;
-    depthStencilAttachment.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    VkSubpassDescription subpasses[1]{};
-    subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpasses[0].colorAttachmentCount = GS_ARRAY_COUNT(colorAttachments);
-    subpasses[0].pColorAttachments = colorAttachments;
-    subpasses[0].pDepthStencilAttachment = &depthStencilAttachment;
-
-    VkRenderPassCreateInfo renderPassCreateInfo{ VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
-    renderPassCreateInfo.attachmentCount = GS_ARRAY_COUNT(attachments);
-    renderPassCreateInfo.pAttachments = attachments;
-    renderPassCreateInfo.subpassCount = GS_ARRAY_COUNT(subpasses);
-    renderPassCreateInfo.pSubpasses = subpasses;
-    VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &result.renderPass));
-
     ImGui_ImplVulkan_InitInfo initInfo{};
     initInfo.Instance = instance;
     initInfo.PhysicalDevice = physicalDevice;
     initInfo.Device = device;
     initInfo.QueueFamily = queueFamily;
     initInfo.Queue = queue;
-    //initInfo.PipelineCache;
+    initInfo.PipelineCache = pipelineCache;
     initInfo.DescriptorPool = result.descriptorPool;
     initInfo.Subpass = 0;
     initInfo.MinImageCount = 2; // TODO: swapchain dependent?
-    initInfo.ImageCount = 2;    // TODO:
+    initInfo.ImageCount = std::max(2u, framesInFlight); // ImGui keeps vertex/index buffers per image, must cover all frames in flight
     initInfo.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
     //initInfo.Allocator;
     //initInfo.err;
 
-    ImGui_ImplVulkan_Init(&initInfo, result.renderPass);
+    ImGui_ImplVulkan_Init(&initInfo, renderPass);
 
     // Upload font
     VkCommandBufferBeginInfo beginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
@@ -695,19 +392,141 @@ ImguiData initImgui(gs::Window* window, VkInstance instance, VkPhysicalDevice ph
 void destroyImgui(VkDevice device, ImguiData& data)
 {
     ImGui_ImplVulkan_Shutdown();
-    vkDestroyRenderPass(device, data.renderPass, nullptr);
     vkDestroyDescriptorPool(device, data.descriptorPool, nullptr);
     ImGui_ImplWin32_Shutdown();
     ImGui::DestroyContext();
 }
 
+#if GS_ENABLE_HOT_RELOAD
+// Runs the shader build without a console window. It only recompiles the shaders whose sources or includes changed, and the SPIR-V
+// it rewrites is then picked up by the shader watcher.
+static void buildShaders()
+{
+    SECURITY_ATTRIBUTES security{ sizeof(security), nullptr, TRUE };
+    HANDLE outputRead{};
+    HANDLE outputWrite{};
+
+    if (!CreatePipe(&outputRead, &outputWrite, &security, 0))
+    {
+        GS_ERROR("Failed to create the shader build output pipe.");
+        return;
+    }
+
+    SetHandleInformation(outputRead, HANDLE_FLAG_INHERIT, 0);
+
+    STARTUPINFOW startupInfo{ sizeof(startupInfo) };
+    startupInfo.dwFlags = STARTF_USESTDHANDLES;
+    startupInfo.hStdOutput = outputWrite;
+    startupInfo.hStdError = outputWrite;
+
+    // CreateProcessW may write to the command line
+    std::wstring commandLine = kShaderBuildCommand;
+    PROCESS_INFORMATION process{};
+    BOOL started = CreateProcessW(nullptr, commandLine.data(), nullptr, nullptr, TRUE, CREATE_NO_WINDOW, nullptr, nullptr, &startupInfo, &process);
+    CloseHandle(outputWrite);
+
+    std::string output;
+    char buffer[4096];
+    DWORD bytesRead{};
+
+    while (started && ReadFile(outputRead, buffer, sizeof(buffer), &bytesRead, nullptr) && bytesRead)
+    {
+        output.append(buffer, bytesRead);
+    }
+
+    CloseHandle(outputRead);
+
+    if (!started)
+    {
+        GS_ERROR("Failed to run the shader build, is Python on the PATH?");
+        return;
+    }
+
+    DWORD exitCode{};
+    WaitForSingleObject(process.hProcess, INFINITE);
+    GetExitCodeProcess(process.hProcess, &exitCode);
+    CloseHandle(process.hProcess);
+    CloseHandle(process.hThread);
+
+    if (exitCode != 0)
+    {
+        GS_ERROR("Shader build failed:\n%s", output.c_str());
+    }
+    else
+    {
+        GS_INFO("Shader build:\n%s", output.c_str());
+    }
+}
+#endif
+
 int wWinMainInternal(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine, int nCmdShow)
 {
     ComHelper comHelper;
+    auto startupBegin = std::chrono::steady_clock::now();
 
     int argc;
     LPWSTR* argv = CommandLineToArgvW(pCmdLine, &argc);
-    std::string objToLoad = gsWcharToUtf8(argv[1]);
+    std::string objToLoad{};
+    uint32_t framesInFlight = GS_VULKAN_FRAMES_IN_FLIGHT;
+    bool allowDynamicRendering = true;
+    gs::vk::SwapchainConfig swapchainConfig{ VK_PRESENT_MODE_FIFO_KHR, 0 };
+    float fpsLimit = 0.f;
+    std::string deviceOverride{};
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = gsWcharToUtf8(argv[i]);
+
+        if (arg.rfind("--frames-in-flight=", 0) == 0)
+        {
+            if (!parseUnsigned(arg.substr(arg.find('=') + 1), framesInFlight))
+            {
+                GS_WARN("Invalid value in %s, expected an integer.", arg.c_str());
+            }
+
+            uint32_t clampedFramesInFlight = std::clamp(framesInFlight, 1u, kMaxFramesInFlight);
+
+            if (clampedFramesInFlight != framesInFlight)
+            {
+                GS_WARN("%s is out of range, using %u frames in flight (1 to %u).", arg.c_str(), clampedFramesInFlight, kMaxFramesInFlight);
+                framesInFlight = clampedFramesInFlight;
+            }
+        }
+        else if (arg == "--no-dynamic-rendering")
+        {
+            allowDynamicRendering = false;
+        }
+        else if (arg.rfind("--present-mode=", 0) == 0)
+        {
+            if (!parsePresentMode(arg.substr(arg.find('=') + 1), swapchainConfig.presentMode))
+            {
+                GS_WARN("Unknown present mode in %s, expected fifo, fifo-relaxed, mailbox or immediate.", arg.c_str());
+            }
+        }
+        else if (arg.rfind("--swapchain-images=", 0) == 0)
+        {
+            if (!parseUnsigned(arg.substr(arg.find('=') + 1), swapchainConfig.imageCount))
+            {
+                GS_WARN("Invalid value in %s, expected an integer.", arg.c_str());
+            }
+        }
+        else if (arg.rfind("--fps-limit=", 0) == 0)
+        {
+            if (!parseFloat(arg.substr(arg.find('=') + 1), fpsLimit))
+            {
+                GS_WARN("Invalid value in %s, expected a number.", arg.c_str());
+            }
+        }
+        else if (arg.rfind("--device=", 0) == 0)
+        {
+            deviceOverride = arg.substr(arg.find('=') + 1);
+        }
+        else
+        {
+            objToLoad = arg;
+        }
+    }
+
     LocalFree(argv);
 
     gs::Window* applicationWindow = gs::Window::createApplicationWindow("GameSmith Application", 1024, 1024);
@@ -726,114 +545,183 @@ int wWinMainInternal(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLin
 
     VkPhysicalDevice physicalDevice{};
     uint32_t graphicsQueueIndex{};
-    gs::vk::choosePhysicalDevice(instance, surface, physicalDevice, graphicsQueueIndex);
+    gs::vk::choosePhysicalDevice(instance, surface, deviceOverride, physicalDevice, graphicsQueueIndex);
     GS_ASSERT(physicalDevice);
 
-    VkDevice device = gs::vk::createDevice(physicalDevice, graphicsQueueIndex);
+    // Uploads and async compute get queues of their own where the device has dedicated families for them, so they can overlap the
+    // graphics work; otherwise they share the graphics queue
+    uint32_t computeQueueIndex = gs::vk::chooseComputeQueueFamily(physicalDevice, graphicsQueueIndex);
+    uint32_t transferQueueIndex = gs::vk::chooseTransferQueueFamily(physicalDevice, graphicsQueueIndex);
+
+    VkDevice device = gs::vk::createDevice(physicalDevice, graphicsQueueIndex, computeQueueIndex, transferQueueIndex);
     GS_ASSERT(device);
 
     VkQueue graphicsQueue{};
     vkGetDeviceQueue(device, graphicsQueueIndex, 0, &graphicsQueue);
     GS_ASSERT(graphicsQueue);
 
-    VkSemaphore acquireCompleteSemaphore = gsCreateSemaphore(device);
-    GS_ASSERT(acquireCompleteSemaphore);
+    VkQueue computeQueue{};
+    vkGetDeviceQueue(device, computeQueueIndex, 0, &computeQueue);
+    GS_ASSERT(computeQueue);
 
-    VkSemaphore renderingCompleteSemaphore = gsCreateSemaphore(device);
-    GS_ASSERT(renderingCompleteSemaphore);
+    VkPipelineCache pipelineCache = gs::vk::loadPipelineCache(physicalDevice, device, kPipelineCachePath);
+    GS_ASSERT(pipelineCache);
 
     VkSurfaceFormatKHR surfaceFormat = chooseSurfaceFormat(physicalDevice, surface);
     GS_ASSERT(surfaceFormat.format != VK_FORMAT_UNDEFINED);
 
-    VkRenderPass renderPass = createRenderPass(device, surfaceFormat.format, VK_FORMAT_D32_SFLOAT);
-    GS_ASSERT(renderPass);
+    // Objects replaced mid-frame, such as swapchains and render graph attachments, are destroyed once the frames using them complete
+    gs::vk::DeletionQueue deletionQueue{};
+    gs::vk::createDeletionQueue(device, framesInFlight, deletionQueue);
 
-    VkCommandPool commandPool = createCommandPool(device, graphicsQueueIndex);
-    GS_ASSERT(commandPool);
+    // Passes, barriers and transient attachments are declared every frame; the graph owns the render passes and framebuffers
+    gs::vk::RenderGraph renderGraph{};
+    gs::vk::createRenderGraph(physicalDevice, device, deletionQueue, allowDynamicRendering, renderGraph);
+
+    VkSurfaceCapabilitiesKHR surfaceCaps{};
+    VK_CHECK_RESULT(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &surfaceCaps));
 
     gs::vk::Swapchain swapchain{};
-    gs::vk::createSwapchain(physicalDevice, device, surface, surfaceFormat, swapchain);
+    gs::vk::createSwapchain(physicalDevice, device, surface, surfaceFormat, surfaceCaps, swapchainConfig, swapchain);
     GS_ASSERT(swapchain.swapchain);
 
+    // Swapchains are recreated without draining the GPU
+    bool swapchainOutOfDate = false;
+
     gs::vk::ShaderModule vertexShader = gs::vk::loadShaderModule(device, "triangle.vert.spv");
     gs::vk::ShaderModule fragmentShader = gs::vk::loadShaderModule(device, "triangle.frag.spv");
+    GS_ASSERT(vertexShader.shader && fragmentShader.shader);
 
-    VkDescriptorSetLayoutBinding descriptorSetLayoutBindings[] = { { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_ALL,
-                                                                     nullptr } };
+    gs::vk::PipelineLayoutCache pipelineLayoutCache{};
+    gs::vk::createPipelineLayoutCache(device, pipelineLayoutCache);
 
-    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
-    descriptorSetLayoutCreateInfo.bindingCount = GS_ARRAY_COUNT(descriptorSetLayoutBindings);
-    descriptorSetLayoutCreateInfo.pBindings = descriptorSetLayoutBindings;
+    // Buffers and textures are reached through one global set, bound once per command buffer
+    gs::vk::BindlessHeap bindlessHeap{};
+    gs::vk::createBindlessHeap(physicalDevice, device, framesInFlight, { 64 * 1024, 64 * 1024, 1024 }, bindlessHeap);
+    gs::vk::reservePipelineLayoutSet(pipelineLayoutCache, gs::vk::kBindlessSet, bindlessHeap.setLayout);
 
-    VkDescriptorSetLayout descriptorSetLayout{};
-    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayout));
+    // Constants are sub-allocated from per-frame pages, so uniform buffers are bound with dynamic offsets
+    const gs::vk::PipelineLayout& pipelineLayout = gs::vk::getPipelineLayout(pipelineLayoutCache, { vertexShader, fragmentShader }, true);
+    VkDescriptorSetLayout descriptorSetLayout = pipelineLayout.setLayouts[0];
+    GS_ASSERT(gs::vk::getVertexInputLayout(vertexShader).binding.stride == sizeof(MeshVertex));
 
-    VkPipelineLayoutCreateInfo pipelineLayoutCrateInfo{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
-    pipelineLayoutCrateInfo.setLayoutCount = 1;
-    pipelineLayoutCrateInfo.pSetLayouts = &descriptorSetLayout;
+    // Draw recording is spread over the pool's threads; each thread records into its own command pool per frame
+    gs::ThreadPool threadPool;
 
-    VkPipelineLayout pipelineLayout{};
-    VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCrateInfo, nullptr, &pipelineLayout));
+    // Pipelines first needed mid-session compile on their own threads so they never hold up the draw recording jobs
+    gs::ThreadPool pipelineCompileThreads(2);
 
-    VkPipeline pipeline = createGraphicsPipeline(device, renderPass, pipelineLayout, { vertexShader, fragmentShader });
-    GS_ASSERT(pipeline);
+    // Variants used by the last run are created up front on the thread pool, then the unlit scene variant, which is the fallback
+    // while the lit one compiles in the background the first time lighting is turned on. Switching variants at draw time is a
+    // lookup of their precomputed hash.
+    gs::vk::PipelineVariantCache pipelineVariants{};
+    gs::vk::createPipelineVariantCache(device, pipelineCache, renderGraph, pipelineLayoutCache, deletionQueue, pipelineVariants);
+    gs::vk::prewarmPipelineVariants(pipelineVariants, threadPool, kPipelineManifestPath);
 
-    std::vector<VkCommandBuffer> commandBuffers;
-    std::vector<VkFence> fences;
-    createFrameResources(device, swapchain, commandPool, commandBuffers, fences);
+    std::vector<gs::vk::PipelineVariantDesc> sceneVariants(2);
 
-    Mesh mesh = loadObjFile(physicalDevice, device, graphicsQueueIndex, objToLoad);
+    for (uint32_t lighting = 0; lighting < 2; ++lighting)
+    {
+        gs::vk::PipelineVariantDesc& desc = sceneVariants[lighting];
+        desc.shaders = { vertexShader, fragmentShader };
+        desc.dynamicUniformBuffers = true;
+        desc.specialization = { { 0, lighting } };
+        desc.state = gs::vk::getDefaultGraphicsPipelineState(surfaceFormat.format, VK_FORMAT_D32_SFLOAT);
+    }
 
-    // Create off-screen buffer for rendering
-    Framebuffer framebuffer{};
-    createFramebuffer(physicalDevice, device, swapchain.extent, renderPass, surfaceFormat.format, VK_FORMAT_D32_SFLOAT, framebuffer);
-    GS_ASSERT(framebuffer.framebuffer);
+    auto pipelineCreationBegin = std::chrono::steady_clock::now();
+    uint64_t unlitPipelineHash = gs::vk::createPipelineVariants(pipelineVariants, threadPool, { sceneVariants[0] })[0];
+    GS_INFO("Pipeline creation took %.3f ms.",
+            std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - pipelineCreationBegin).count());
+    uint64_t litPipelineHash = gs::vk::hashPipelineVariant(sceneVariants[1]);
+    bool lightingEnabled = false;
+
+#if GS_ENABLE_HOT_RELOAD
+    // Saved shader sources are rebuilt in the background and the pipelines using them recompiled and swapped in, without a restart
+    // or waiting for the device to idle
+    gs::FileWatcher shaderWatcher;
+    shaderWatcher.watchDirectory(kShaderSourceDirectory, ".glsl");
+    shaderWatcher.watchDirectory(".", ".spv");
+    std::future<void> shaderBuild;
+    bool shaderBuildRequested = false;
+#endif
 
-    // Create descriptor pool
-    VkDescriptorPoolSize poolSizes[] = { { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 32 } };
+    std::vector<VkCommandBuffer> secondaryCommandBuffers;
 
-    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
-    descriptorPoolCreateInfo.maxSets = 32;
-    descriptorPoolCreateInfo.poolSizeCount = GS_ARRAY_COUNT(poolSizes);
-    descriptorPoolCreateInfo.pPoolSizes = poolSizes;
+    std::vector<gs::vk::Frame> frames;
+    gs::vk::createFrames(device, graphicsQueueIndex, framesInFlight, threadPool.getThreadCount(), frames);
+    uint32_t frameIndex = 0;
+    uint64_t frameNumber = 0;
+
+    gs::vk::GpuProfiler gpuProfiler{};
+    gs::vk::createGpuProfiler(physicalDevice, device, graphicsQueueIndex, framesInFlight, 32, gpuProfiler);
+
+    gs::vk::PipelineStatisticsQueries pipelineStatistics{};
+    gs::vk::createPipelineStatisticsQueries(physicalDevice, device, framesInFlight, 16, pipelineStatistics);
+
+    gs::vk::PresentLatency presentLatency{};
+    gs::vk::createPresentLatency(instance, physicalDevice, device, graphicsQueueIndex, framesInFlight, presentLatency);
 
-    VkDescriptorPool descriptorPool{};
-    VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &descriptorPool));
+    gs::vk::UploadManager uploadManager{};
+    gs::vk::createUploadManager(physicalDevice, device, transferQueueIndex, graphicsQueueIndex, 16 * 1024 * 1024, uploadManager);
 
-    // Create globals UBO
-    // TODO: dynamic UBO, needs to be at least swapchain image count * sizeof(ShaderGlobals), assume
-    // swapchain image count is always <= 4 for now because dealing with resizing is gross at the moment
-    Buffer globalsBuffer =
-            createBuffer(physicalDevice, device, sizeof(ShaderGlobals) * 4, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, { graphicsQueueIndex });
-    GS_ASSERT(globalsBuffer.buffer);
+    // All meshes share the scene's geometry buffers and every object is drawn by one indirect draw
+    uint32_t maxSceneIndices = 16 * 1024 * 1024;
+    uint32_t maxSceneMeshlets = maxSceneIndices / (3 * gs::vk::kGpuMeshletTriangleCount);
+    gs::vk::GpuSceneLimits sceneLimits{ sizeof(MeshVertex), 4 * 1024 * 1024, maxSceneIndices, 4096, maxSceneMeshlets, 64 * 1024 };
+    gs::vk::GpuScene gpuScene{};
+    gs::vk::createGpuScene(physicalDevice, device, { graphicsQueueIndex }, framesInFlight, sceneLimits,
+                           bindlessHeap, gpuScene);
+    int objectGridSize = 1;
 
-    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
-    descriptorSetAllocateInfo.descriptorPool = descriptorPool;
-    descriptorSetAllocateInfo.descriptorSetCount = 1;
-    descriptorSetAllocateInfo.pSetLayouts = &descriptorSetLayout;
+    // Objects and meshlets are culled on the GPU against the frustum and the previous frame's depth, and the survivors drawn with an
+    // indirect draw count
+    gs::vk::GpuCulling gpuCulling{};
+    gs::vk::createGpuCulling(physicalDevice, device, graphicsQueueIndex, deletionQueue, pipelineLayoutCache, pipelineCache, framesInFlight,
+                             kMaxCulledDraws, gpuCulling);
+    bool gpuCullingEnabled = gpuCulling.supported;
 
-    VkDescriptorSet descriptorSet{};
-    VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &descriptorSet));
+    // Load the mesh in the background; it is drawn once its upload to device local memory has completed
+    uint32_t meshIndex = ~0u;
+    std::future<uint32_t> pendingMesh = std::async(std::launch::async, loadObjFile, std::ref(gpuScene), std::ref(uploadManager), objToLoad);
 
-    VkDescriptorBufferInfo descriptorBufferInfo{};
-    descriptorBufferInfo.buffer = globalsBuffer.buffer;
-    descriptorBufferInfo.offset = 0;
-    descriptorBufferInfo.range = sizeof(ShaderGlobals);
+    // Render straight into the swapchain images unless post-processing needs the off-screen color buffer
+    bool renderOffscreen = false;
 
-    VkWriteDescriptorSet writeDescriptorSet{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
-    writeDescriptorSet.dstSet = descriptorSet;
-    writeDescriptorSet.dstBinding = 0;
-    writeDescriptorSet.descriptorCount = 1;
-    writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-    writeDescriptorSet.pBufferInfo = &descriptorBufferInfo;
-    vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+    auto lastFrameTime = std::chrono::steady_clock::now();
+    float averageFrameTimeMs = 0.f;
 
-    ImguiData imguiData = initImgui(applicationWindow, instance, physicalDevice, device, graphicsQueueIndex, graphicsQueue, surfaceFormat.format,
-                                    VK_FORMAT_D32_SFLOAT, commandBuffers[0]);
+    gs::FrameLimiter frameLimiter;
+    frameLimiter.setTargetFps(fpsLimit);
+
+    // CPU time of recording the main pass draws, to compare the ways of passing per-draw constants
+    float averageDrawRecordingUs = 0.f;
+    std::vector<gs::vk::FrameAllocation> drawUniforms;
+
+    // Per-frame constants; every page of the allocator comes with a descriptor set, so allocations are bound by dynamic offset without
+    // descriptor updates
+    gs::vk::FrameAllocator uniformAllocator{};
+    gs::vk::createFrameAllocator(physicalDevice, device, graphicsQueueIndex, framesInFlight, 64 * 1024, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                 descriptorSetLayout, sizeof(ShaderGlobals), uniformAllocator);
+
+    ImguiData imguiData = initImgui(applicationWindow, instance, physicalDevice, device, graphicsQueueIndex, graphicsQueue, pipelineCache,
+                                    gs::vk::getCompatibleRenderPass(renderGraph, { surfaceFormat.format }, VK_FORMAT_UNDEFINED),
+                                    framesInFlight, frames[0].commandBuffer);
+
+    GS_INFO("Startup took %.3f ms.", std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startupBegin).count());
 
     while (applicationWindow->isValid())
     {
+        // Wait for the frame limit and for the GPU to release this frame's resources before sampling input rather than after, so
+        // neither wait adds to the latency. The CPU only ever runs framesInFlight frames ahead.
+        frameLimiter.wait();
+        gs::vk::Frame& frame = frames[frameIndex];
+        gs::vk::waitForFrame(device, frame);
+        gs::vk::beginDeletionQueueFrame(deletionQueue, frameNumber);
+        gs::vk::beginBindlessHeapFrame(bindlessHeap, frameNumber);
+
         applicationWindow->pumpMessages();
+        auto inputTime = std::chrono::steady_clock::now();
 
         // IMGUI HACKING
         POINT cursor_pos;
@@ -852,186 +740,575 @@ int wWinMainInternal(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLin
         ImGui::Begin("Another Window");
         ImGui::End();
 
+        auto frameTime = std::chrono::steady_clock::now();
+        float frameTimeMs = std::chrono::duration<float, std::milli>(frameTime - lastFrameTime).count();
+        averageFrameTimeMs = gs::lerp(averageFrameTimeMs, frameTimeMs, 0.05f);
+        lastFrameTime = frameTime;
+
+        ImGui::Begin("Renderer");
+        ImGui::Text("Frame time: %.3f ms (%.1f fps)", averageFrameTimeMs, 1000.f / averageFrameTimeMs);
+        ImGui::Text("Resolution: %u x %u", swapchain.extent.width, swapchain.extent.height);
+        ImGui::Text("Queue families: graphics %u, compute %u, transfer %u", graphicsQueueIndex, computeQueueIndex, transferQueueIndex);
+        // The copy needs swapchain images that can be transfer destinations, which surfaces don't have to support
+        if (swapchain.imageUsage & VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+        {
+            ImGui::Checkbox("Render off-screen and copy to swapchain", &renderOffscreen);
+        }
+        else
+        {
+            renderOffscreen = false;
+        }
+
+        ImGui::SliderInt("Object grid", &objectGridSize, 1, 128);
+        ImGui::Checkbox("Instancing", &gpuScene.instancing);
+        ImGui::Checkbox("Lighting (specialization constant)", &lightingEnabled);
+        ImGui::Text("Pipeline variants: %zu ready, %zu compiling", pipelineVariants.pipelines.size(), pipelineVariants.compiling.size());
+        ImGui::Text("Objects: %zu in %zu draws, %s", gpuScene.objects.size(), gpuScene.drawCommands.size(),
+                    gpuScene.indirectDraws ? "multi-draw indirect" : "direct draws");
+
+        const char* perDrawDataNames[] = { "First instance", "Push constants", "Dynamic uniform buffer" };
+        int perDrawData = int(gpuScene.perDrawData);
+
+        if (ImGui::Combo("Per-draw data", &perDrawData, perDrawDataNames, IM_ARRAYSIZE(perDrawDataNames)))
+        {
+            gpuScene.perDrawData = gs::vk::GpuScenePerDrawData(perDrawData);
+        }
+
+        ImGui::Text("Draw recording: %.1f us (%.0f ns per draw)", averageDrawRecordingUs,
+                    gpuScene.drawCommands.empty() ? 0.f : averageDrawRecordingUs * 1000.f / float(gpuScene.drawCommands.size()));
+
+        if (gpuCulling.supported)
+        {
+            ImGui::Checkbox("GPU culling", &gpuCullingEnabled);
+            ImGui::Checkbox("Frustum culling", &gpuCulling.settings.frustumCulling);
+            ImGui::Checkbox("Occlusion culling", &gpuCulling.settings.occlusionCulling);
+            ImGui::Checkbox("Meshlet culling", &gpuCulling.settings.meshletCulling);
+            ImGui::Text("Visible draws: %u (max %u)", gpuCulling.visibleDrawCount, gpuCulling.maxDraws);
+        }
+
+        ImGui::End();
+
+        ImGui::Begin("Presentation");
+        ImGui::Text("Present mode: %s, %zu images", gs::vk::presentModeName(swapchain.presentMode), swapchain.images.size());
+        switch (presentLatency.source)
+        {
+            case gs::vk::PresentLatencySource::PresentWait:
+            {
+                ImGui::Text("Input to present: %.3f ms", gs::vk::getPresentLatencyMilliseconds(presentLatency));
+                break;
+            }
+            case gs::vk::PresentLatencySource::GpuCompletion:
+            {
+                ImGui::Text("Input to GPU completion: %.3f ms", gs::vk::getPresentLatencyMilliseconds(presentLatency));
+                break;
+            }
+            default:
+            {
+                ImGui::Text("Input latency: not measured on this device");
+                break;
+            }
+        }
+
+        // Changing the presentation policy recreates the swapchain on the next frame
+        static const VkPresentModeKHR presentModes[] = { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_MAILBOX_KHR,
+                                                         VK_PRESENT_MODE_IMMEDIATE_KHR };
+
+        if (ImGui::BeginCombo("Requested mode", gs::vk::presentModeName(swapchainConfig.presentMode)))
+        {
+            for (VkPresentModeKHR presentMode : presentModes)
+            {
+                if (ImGui::Selectable(gs::vk::presentModeName(presentMode), presentMode == swapchainConfig.presentMode))
+                {
+                    swapchainOutOfDate |= presentMode != swapchainConfig.presentMode;
+                    swapchainConfig.presentMode = presentMode;
+                }
+            }
+
+            ImGui::EndCombo();
+        }
+
+        int imageCount = int(swapchainConfig.imageCount);
+
+        if (ImGui::SliderInt("Images (0 = default)", &imageCount, 0, 8))
+        {
+            swapchainConfig.imageCount = uint32_t(imageCount);
+            swapchainOutOfDate = true;
+        }
+
+        if (ImGui::SliderFloat("FPS limit (0 = off)", &fpsLimit, 0.f, 480.f, "%.0f"))
+        {
+            frameLimiter.setTargetFps(fpsLimit);
+        }
+
+        ImGui::End();
+
+        ImGui::Begin("GPU Profiler");
+
+        for (const gs::vk::GpuScopeTiming& scope : gpuProfiler.latest)
+        {
+            ImGui::Text("%*s%-24s %7.3f ms (avg %7.3f ms)", int(scope.depth * 2), "", scope.name.c_str(), scope.milliseconds,
+                        scope.averageMilliseconds);
+        }
+
+        if (ImGui::Button("Dump CSV"))
+        {
+            gs::vk::writeGpuProfilerHistory(gpuProfiler, "gpu_profile.csv");
+        }
+
+        ImGui::SameLine();
+
+        if (ImGui::Button("Dump JSON"))
+        {
+            gs::vk::writeGpuProfilerHistory(gpuProfiler, "gpu_profile.json");
+        }
+
+        ImGui::End();
+
+        ImGui::Begin("Pipeline Statistics");
+
+        if (pipelineStatistics.supported)
+        {
+            ImGui::Checkbox("Enabled", &pipelineStatistics.enabled);
+
+            auto showPassStatistics = [](const gs::vk::PassStatistics& pass) {
+                if (ImGui::TreeNodeEx(pass.name.c_str(), ImGuiTreeNodeFlags_DefaultOpen))
+                {
+                    for (uint32_t s = 0; s < gs::vk::kPipelineStatisticCount; ++s)
+                    {
+                        ImGui::Text("%-22s %12llu (avg %12.0f)", gs::vk::pipelineStatisticName(gs::vk::PipelineStatistic(s)),
+                                    (unsigned long long)pass.values[s], pass.averageValues[s]);
+                    }
+
+                    ImGui::Text("%-22s %12llu (avg %12.0f)", "Samples passed", (unsigned long long)pass.samplesPassed, pass.averageSamplesPassed);
+                    ImGui::TreePop();
+                }
+            };
+
+            if (pipelineStatistics.enabled)
+            {
+                showPassStatistics(pipelineStatistics.frameTotal);
+
+                for (const gs::vk::PassStatistics& pass : pipelineStatistics.latest)
+                {
+                    showPassStatistics(pass);
+                }
+            }
+        }
+        else
+        {
+            ImGui::Text("Not supported by this device.");
+        }
+
+        ImGui::End();
+
         ImGui::Render();
         ////////////////
 
-        VkSurfaceCapabilitiesKHR surfaceCaps{};
         VK_CHECK_RESULT(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &surfaceCaps));
 
-        if (memcmp(&swapchain.extent, &surfaceCaps.currentExtent, sizeof(VkExtent2D)) != 0)
+        // A minimized window has nothing to present to
+        if (surfaceCaps.currentExtent.width == 0 || surfaceCaps.currentExtent.height == 0)
         {
-            VK_CHECK_RESULT(vkDeviceWaitIdle(device));
-            destroySwapchain(device, swapchain);
-            destroyFrameResources(device, commandPool, commandBuffers, fences);
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
 
-            createSwapchain(physicalDevice, device, surface, surfaceFormat, swapchain);
-            GS_ASSERT(swapchain.swapchain);
-            createFrameResources(device, swapchain, commandPool, commandBuffers, fences);
+        bool extentChanged = memcmp(&swapchain.extent, &surfaceCaps.currentExtent, sizeof(VkExtent2D)) != 0;
 
-            destroyFramebuffer(device, framebuffer);
-            createFramebuffer(physicalDevice, device, swapchain.extent, renderPass, surfaceFormat.format, VK_FORMAT_D32_SFLOAT, framebuffer);
+        // Transient attachments follow the swapchain extent through the render graph; only the swapchain itself is recreated here
+        if (extentChanged || swapchainOutOfDate)
+        {
+            // The retired swapchain can't be acquired from any more, so the frame is skipped until recreation succeeds
+            if (!gs::vk::recreateSwapchain(physicalDevice, device, surface, surfaceFormat, surfaceCaps, swapchainConfig, swapchain))
+            {
+                swapchainOutOfDate = true;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+
+            swapchainOutOfDate = false;
         }
 
+        if (pendingMesh.valid() && pendingMesh.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            meshIndex = pendingMesh.get();
+        }
+
+        // Submit all uploads queued since the last frame as a single batch
+        gs::vk::flushUploads(uploadManager);
+        gs::vk::GpuMesh mesh = meshIndex != ~0u ? gs::vk::getGpuMesh(gpuScene, meshIndex) : gs::vk::GpuMesh{};
+        bool meshReady = meshIndex != ~0u && gs::vk::isUploadComplete(uploadManager, mesh.uploadTimelineValue);
+
         uint32_t imageIndex{};
-        VkResult aniresult = vkAcquireNextImageKHR(device, swapchain.swapchain, UINT64_MAX, acquireCompleteSemaphore, VK_NULL_HANDLE, &imageIndex);
-        VK_CHECK_RESULT(aniresult);
-        VK_CHECK_RESULT(vkWaitForFences(device, 1, &fences[imageIndex], VK_TRUE, UINT64_MAX));
-        VK_CHECK_RESULT(vkResetFences(device, 1, &fences[imageIndex]));
+        VkResult acquireResult =
+                vkAcquireNextImageKHR(device, swapchain.swapchain, UINT64_MAX, frame.acquireCompleteSemaphore, VK_NULL_HANDLE, &imageIndex);
 
-        VkCommandBuffer commandBuffer = commandBuffers[imageIndex];
-        VkCommandBufferBeginInfo commandBufferBeginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-        commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-        VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
+        if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR)
+        {
+            // Nothing was acquired and the frame hasn't been reset, so it can simply be retried with a new swapchain
+            swapchainOutOfDate = true;
+            continue;
+        }
+
+        GS_ASSERT(acquireResult == VK_SUCCESS || acquireResult == VK_SUBOPTIMAL_KHR);
+        swapchainOutOfDate = acquireResult == VK_SUBOPTIMAL_KHR;
+        gs::vk::resetFrame(device, frame);
+        gs::vk::beginRenderGraph(renderGraph);
 
-        uint32_t dynamicOffset = imageIndex * sizeof(ShaderGlobals);
+        gs::vk::beginGpuCullingFrame(gpuCulling, frameIndex, swapchain.extent);
+
+#if GS_ENABLE_HOT_RELOAD
+        for (const std::string& path : shaderWatcher.takeChanges())
+        {
+            if (std::filesystem::path(path).extension() == ".glsl")
+            {
+                shaderBuildRequested = true;
+            }
+            else if (!gs::vk::reloadPipelineVariantShader(pipelineVariants, pipelineCompileThreads, path))
+            {
+                GS_INFO("'%s' changed but no pipeline variant was recompiled for it.", path.c_str());
+            }
+        }
+
+        // Sources saved during a build are built again once it finishes
+        if (shaderBuildRequested && (!shaderBuild.valid() || shaderBuild.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
+        {
+            shaderBuildRequested = false;
+            shaderBuild = pipelineCompileThreads.submit(buildShaders);
+        }
+#endif
+
+        // Until the requested variant has compiled the scene is drawn unlit. Reloaded variants are swapped in here too, at the frame
+        // boundary, and the pipelines they replace retired through the deletion queue.
+        gs::vk::updatePipelineVariants(pipelineVariants);
+
+        if (lightingEnabled && !gs::vk::getPipelineVariant(pipelineVariants, litPipelineHash) && !pipelineVariants.compiling.count(litPipelineHash))
+        {
+            gs::vk::requestPipelineVariant(pipelineVariants, pipelineCompileThreads, sceneVariants[1]);
+        }
+
+        uint64_t scenePipelineHash = lightingEnabled ? litPipelineHash : unlitPipelineHash;
+        VkPipeline pipeline = gs::vk::getPipelineVariant(pipelineVariants, scenePipelineHash, unlitPipelineHash);
+        GS_ASSERT(pipeline);
+
+        gs::vk::beginFrameAllocator(uniformAllocator, frameIndex);
+        gs::vk::FrameAllocation globalsAllocation{};
+        ShaderGlobals* globals = gs::vk::allocateFrameData<ShaderGlobals>(uniformAllocator, globalsAllocation);
         float viewWidth = float(swapchain.extent.width);
         float viewHeight = float(swapchain.extent.height);
         float viewAspect = viewWidth / viewHeight;
 
 #if ORTHO
-        ((ShaderGlobals*)globalsBuffer.mappedMemory)[imageIndex].proj = gs::orthographic(-viewAspect, -1.f, viewAspect, 1.f, -1.f, 1.f);
-        ((ShaderGlobals*)globalsBuffer.mappedMemory)[imageIndex].view = gs::mat44();
+        gs::mat44 proj = gs::orthographic(-viewAspect, -1.f, viewAspect, 1.f, -1.f, 1.f);
+        gs::mat44 view = gs::mat44();
 #else
-        ((ShaderGlobals*)globalsBuffer.mappedMemory)[imageIndex].proj = gs::perspective(gs::degToRad(60.f), viewAspect, 0.1f, 100.f);
-        ((ShaderGlobals*)globalsBuffer.mappedMemory)[imageIndex].view = gs::lookAt({ -1.f, 0.5f, 1.f }, { 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f });
+        gs::mat44 proj = gs::perspective(gs::degToRad(60.f), viewAspect, 0.1f, 100.f);
+        gs::mat44 view = gs::lookAt({ -1.f, 0.5f, 1.f }, { 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f });
 #endif
 
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 1, &dynamicOffset);
-
-        VkClearValue clearValues[2]{};
-        clearValues[0].color = { 43.0f / 255.0f, 53.0f / 255.0f, 51.0f / 255.0f, 1.0f };
-        clearValues[1].depthStencil = { 0.0f, 0 };
-
-        VkRenderPassBeginInfo renderPassBeginInfo{ VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
-        renderPassBeginInfo.renderPass = renderPass;
-        renderPassBeginInfo.framebuffer = framebuffer.framebuffer;
-        renderPassBeginInfo.renderArea.extent = swapchain.extent;
-        renderPassBeginInfo.clearValueCount = GS_ARRAY_COUNT(clearValues);
-        renderPassBeginInfo.pClearValues = clearValues;
-
-        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-
-        VkViewport viewport{ 0.f, (float)swapchain.extent.height, (float)swapchain.extent.width, -(float)swapchain.extent.height, 1.f, 0.f };
-        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-
-        VkRect2D scissor{};
-        scissor.extent = swapchain.extent;
-        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-        VkDeviceSize offsets{};
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &mesh.vertexBuffer.buffer, &offsets);
-        vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-        vkCmdDrawIndexed(commandBuffer, mesh.indexCount, 1, 0, 0, 0);
-
-        vkCmdEndRenderPass(commandBuffer);
-
-        renderPassBeginInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
-        renderPassBeginInfo.renderPass = imguiData.renderPass;
-        renderPassBeginInfo.framebuffer = framebuffer.framebuffer;
-        renderPassBeginInfo.renderArea.extent = swapchain.extent;
-        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-        ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
-        vkCmdEndRenderPass(commandBuffer);
-
-        VkImageMemoryBarrier copyBarriers[2]{};
-        copyBarriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        copyBarriers[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-        copyBarriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        copyBarriers[0].oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-        copyBarriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        copyBarriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        copyBarriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        copyBarriers[0].image = framebuffer.colorBuffer.image;
-        copyBarriers[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        copyBarriers[0].subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
-        copyBarriers[0].subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
-
-        copyBarriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        copyBarriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        copyBarriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        copyBarriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        copyBarriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        copyBarriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        copyBarriers[1].image = swapchain.images[imageIndex];
-        copyBarriers[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        copyBarriers[1].subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
-        copyBarriers[1].subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
-
-        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                             VK_DEPENDENCY_BY_REGION_BIT, 0, nullptr, 0, nullptr, GS_ARRAY_COUNT(copyBarriers), copyBarriers);
-
-        VkImageCopy copyRegion{};
-        copyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        copyRegion.srcSubresource.mipLevel = 0;
-        copyRegion.srcSubresource.baseArrayLayer = 0;
-        copyRegion.srcSubresource.layerCount = 1;
-        copyRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        copyRegion.dstSubresource.mipLevel = 0;
-        copyRegion.dstSubresource.baseArrayLayer = 0;
-        copyRegion.dstSubresource.layerCount = 1;
-        copyRegion.extent = { swapchain.extent.width, swapchain.extent.height, 1 };
-
-        vkCmdCopyImage(commandBuffer, framebuffer.colorBuffer.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapchain.images[imageIndex],
-                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
-
-        VkImageMemoryBarrier presentBarrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
-        presentBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        presentBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        presentBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-        presentBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        presentBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        presentBarrier.image = swapchain.images[imageIndex];
-        presentBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        presentBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
-        presentBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
-
-        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0,
-                             nullptr, 0, nullptr, 1, &presentBarrier);
+        globals->proj = proj;
+        globals->view = view;
 
+        // The swapchain image's previous contents are discarded; its availability is waited on at its first use in the graph
+        gs::vk::RenderGraphResource backbuffer = gs::vk::importRenderGraphImage(
+                renderGraph, "Backbuffer", swapchain.images[imageIndex], swapchain.imageViews[imageIndex], surfaceFormat.format, swapchain.extent,
+                swapchain.imageUsage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0);
+        gs::vk::RenderGraphResource depthBuffer = gs::vk::createRenderGraphImage(renderGraph, "Depth", VK_FORMAT_D32_SFLOAT, swapchain.extent);
+        gs::vk::RenderGraphResource colorTarget = backbuffer;
+
+        if (renderOffscreen)
+        {
+            colorTarget = gs::vk::createRenderGraphImage(renderGraph, "Scene color", surfaceFormat.format, swapchain.extent);
+        }
+
+        // Lay the mesh out on a grid in the unit cube, scaled to fit its cell. The copies share a mesh and pipeline, so they are drawn as
+        // instances of a single draw.
+        gs::vk::beginGpuSceneFrame(gpuScene, frameIndex);
+        globals->objectBuffer = gs::vk::getGpuSceneObjectBuffer(gpuScene);
+
+        if (meshReady)
+        {
+            float cellSize = 2.f / float(objectGridSize);
+            float objectScale = 0.4f * cellSize / std::max(mesh.boundingSphere[3], 1e-6f);
+            gs::mat44 centerMesh = gs::translate({ -mesh.boundingSphere[0], -mesh.boundingSphere[1], -mesh.boundingSphere[2], 1.f });
+
+            for (int z = 0; z < objectGridSize; ++z)
+            {
+                for (int x = 0; x < objectGridSize; ++x)
+                {
+                    gs::Vec4 position{ cellSize * (float(x) + 0.5f) - 1.f, 0.f, cellSize * (float(z) + 0.5f) - 1.f, 1.f };
+                    gs::vk::addGpuObject(gpuScene, meshIndex, gs::translate(position) * gs::scale(objectScale) * centerMesh);
+                }
+            }
+        }
+
+        gs::vk::buildGpuSceneDraws(gpuScene);
+
+        // Culling runs ahead of the main pass and reads the depth pyramid the previous frame built after its main pass
+        gs::vk::RenderGraphResource depthPyramid = gs::vk::kInvalidRenderGraphResource;
+
+        if (gpuCullingEnabled)
+        {
+            gs::vk::setGpuCullingView(gpuCulling, gpuScene, proj, view);
+            depthPyramid = gs::vk::importDepthPyramid(gpuCulling, renderGraph);
+
+            uint32_t cullingPass = gs::vk::addRenderGraphPass(
+                    renderGraph, "Culling", gs::vk::RenderGraphPassType::Compute,
+                    [&](VkCommandBuffer commandBuffer, const gs::vk::RenderGraphPassContext&) {
+                        gs::vk::recordGpuCulling(gpuCulling, gpuScene, commandBuffer);
+                    });
+            gs::vk::readRenderGraphImage(renderGraph, cullingPass, depthPyramid, gs::vk::RenderGraphAccess::ComputeShaderRead);
+            gs::vk::setSideEffects(renderGraph, cullingPass); // Its draws are buffers, which the graph doesn't track
+        }
+
+        // Indirect draws submit the whole scene with one call. Otherwise the draws are split into jobs recorded into secondary
+        // command buffers on the thread pool, then executed in job order so the result matches recording on one thread.
+        uint32_t drawCount = uint32_t(gpuScene.drawCommands.size());
+        bool singleDrawJob = gpuCullingEnabled || (gpuScene.indirectDraws && gpuScene.perDrawData == gs::vk::GpuScenePerDrawData::FirstInstance);
+        uint32_t drawJobCount = singleDrawJob ? std::min(drawCount, 1u)
+                                        : std::min(threadPool.getThreadCount(), (drawCount + kMinDrawsPerJob - 1) / kMinDrawsPerJob);
+        uint32_t drawsPerJob = drawJobCount ? (drawCount + drawJobCount - 1) / drawJobCount : 0;
+        secondaryCommandBuffers.resize(drawJobCount);
+
+        uint32_t mainPass = gs::vk::addRenderGraphPass(
+                renderGraph, "Main pass", gs::vk::RenderGraphPassType::Graphics,
+                [&](VkCommandBuffer commandBuffer, const gs::vk::RenderGraphPassContext& context) {
+                    auto recordingBegin = std::chrono::steady_clock::now();
+
+                    // The allocator isn't thread safe, so per-draw uniforms are written up front, a copy of the globals per draw
+                    drawUniforms.clear();
+
+                    if (!gpuCullingEnabled && gpuScene.perDrawData == gs::vk::GpuScenePerDrawData::DynamicUniforms)
+                    {
+                        drawUniforms.resize(drawCount);
+
+                        for (uint32_t d = 0; d < drawCount; ++d)
+                        {
+                            ShaderGlobals* drawGlobals = gs::vk::allocateFrameData<ShaderGlobals>(uniformAllocator, drawUniforms[d]);
+                            drawGlobals->proj = proj;
+                            drawGlobals->view = view;
+                            drawGlobals->objectBuffer = gs::vk::getGpuSceneObjectBuffer(gpuScene);
+                            drawGlobals->draw = gpuScene.drawConstants[d];
+                            drawGlobals->drawUniforms = 1;
+                        }
+                    }
+
+                    // The graph has begun the pipeline statistics queries the secondary command buffers inherit
+                    threadPool.parallelFor(drawJobCount, [&](uint32_t jobIndex, uint32_t threadIndex) {
+                        VkCommandBuffer secondaryCommandBuffer = gs::vk::getSecondaryCommandBuffer(device, frame, threadIndex);
+
+                        VkCommandBufferInheritanceInfo inheritanceInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+                        VkCommandBufferInheritanceRenderingInfoKHR inheritanceRenderingInfo{};
+                        gs::vk::setRenderGraphInheritance(context, &pipelineStatistics, inheritanceInfo, inheritanceRenderingInfo);
+
+                        VkCommandBufferBeginInfo beginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+                        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+                        beginInfo.pInheritanceInfo = &inheritanceInfo;
+                        VK_CHECK_RESULT(vkBeginCommandBuffer(secondaryCommandBuffer, &beginInfo));
+
+                        // Secondary command buffers inherit no state from the primary
+                        vkCmdBindPipeline(secondaryCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+                        vkCmdBindDescriptorSets(secondaryCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout.layout, 0, 1,
+                                                &globalsAllocation.descriptorSet, 1, &globalsAllocation.offset);
+                        gs::vk::bindBindlessHeap(bindlessHeap, secondaryCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout.layout);
+
+                        VkExtent2D extent = context.extent;
+                        VkViewport viewport{ 0.f, (float)extent.height, (float)extent.width, -(float)extent.height, 1.f, 0.f };
+                        vkCmdSetViewport(secondaryCommandBuffer, 0, 1, &viewport);
+
+                        VkRect2D scissor{};
+                        scissor.extent = extent;
+                        vkCmdSetScissor(secondaryCommandBuffer, 0, 1, &scissor);
+
+                        if (gpuCullingEnabled)
+                        {
+                            gs::vk::recordGpuCulledDraws(gpuCulling, gpuScene, secondaryCommandBuffer, pipelineLayout);
+                        }
+                        else
+                        {
+                            uint32_t firstDraw = jobIndex * drawsPerJob;
+                            uint32_t jobDrawCount = std::min(drawsPerJob, drawCount - firstDraw);
+                            gs::vk::recordGpuSceneDraws(gpuScene, secondaryCommandBuffer, pipelineLayout, firstDraw, jobDrawCount,
+                                                        drawUniforms.empty() ? nullptr : &drawUniforms[firstDraw]);
+                        }
+
+                        VK_CHECK_RESULT(vkEndCommandBuffer(secondaryCommandBuffer));
+                        secondaryCommandBuffers[jobIndex] = secondaryCommandBuffer;
+                    });
+
+                    if (drawJobCount)
+                    {
+                        vkCmdExecuteCommands(commandBuffer, drawJobCount, secondaryCommandBuffers.data());
+                    }
+
+                    float recordingUs = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - recordingBegin).count();
+                    averageDrawRecordingUs = gs::lerp(averageDrawRecordingUs, recordingUs, 0.05f);
+                });
+        gs::vk::addColorAttachment(renderGraph, mainPass, colorTarget, VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                   { 43.0f / 255.0f, 53.0f / 255.0f, 51.0f / 255.0f, 1.0f });
+        gs::vk::setDepthAttachment(renderGraph, mainPass, depthBuffer, VK_ATTACHMENT_LOAD_OP_CLEAR, { 0.0f, 0 });
+        gs::vk::setSecondaryCommandBuffers(renderGraph, mainPass);
+
+        if (gpuCullingEnabled)
+        {
+            // Reduce this frame's depth for the next frame's occlusion tests
+            uint32_t pyramidPass = gs::vk::addRenderGraphPass(
+                    renderGraph, "Depth pyramid", gs::vk::RenderGraphPassType::Compute,
+                    [&, depthBuffer](VkCommandBuffer commandBuffer, const gs::vk::RenderGraphPassContext& context) {
+                        gs::vk::recordDepthPyramid(gpuCulling, commandBuffer, gs::vk::getRenderGraphImageView(*context.graph, depthBuffer));
+                    });
+            gs::vk::readRenderGraphImage(renderGraph, pyramidPass, depthBuffer, gs::vk::RenderGraphAccess::ComputeShaderRead);
+            gs::vk::writeRenderGraphImage(renderGraph, pyramidPass, depthPyramid, gs::vk::RenderGraphAccess::ComputeShaderWrite);
+            gs::vk::setSideEffects(renderGraph, pyramidPass);
+        }
+
+        uint32_t imguiPass = gs::vk::addRenderGraphPass(
+                renderGraph, "ImGui pass", gs::vk::RenderGraphPassType::Graphics,
+                [](VkCommandBuffer commandBuffer, const gs::vk::RenderGraphPassContext&) {
+                    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
+                });
+        gs::vk::addColorAttachment(renderGraph, imguiPass, colorTarget, VK_ATTACHMENT_LOAD_OP_LOAD);
+        gs::vk::setRenderPassRequired(renderGraph, imguiPass); // The ImGui backend only supports render passes
+
+        if (renderOffscreen)
+        {
+            VkExtent2D copyExtent = swapchain.extent;
+            uint32_t copyPass = gs::vk::addRenderGraphPass(
+                    renderGraph, "Copy to swapchain", gs::vk::RenderGraphPassType::Transfer,
+                    [=](VkCommandBuffer commandBuffer, const gs::vk::RenderGraphPassContext& context) {
+                        VkImageCopy copyRegion{};
+                        copyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                        copyRegion.srcSubresource.layerCount = 1;
+                        copyRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                        copyRegion.dstSubresource.layerCount = 1;
+                        copyRegion.extent = { copyExtent.width, copyExtent.height, 1 };
+
+                        vkCmdCopyImage(commandBuffer, gs::vk::getRenderGraphImage(*context.graph, colorTarget), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                       gs::vk::getRenderGraphImage(*context.graph, backbuffer), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+                    });
+            gs::vk::readRenderGraphImage(renderGraph, copyPass, colorTarget, gs::vk::RenderGraphAccess::TransferRead);
+            gs::vk::writeRenderGraphImage(renderGraph, copyPass, backbuffer, gs::vk::RenderGraphAccess::TransferWrite);
+        }
+
+        gs::vk::compileRenderGraph(renderGraph);
+
+        VkCommandBuffer commandBuffer = frame.commandBuffer;
+        VkCommandBufferBeginInfo commandBufferBeginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+        commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
+
+        // Geometry is read by culling and drawing; on a dedicated transfer queue its ownership is handed over to this queue first
+        VkPipelineStageFlags uploadConsumerStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        VkAccessFlags uploadConsumerAccess = VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+        uint64_t acquiredUploadValue = gs::vk::acquireUploads(uploadManager, commandBuffer, uploadConsumerStages, uploadConsumerAccess);
+
+        gs::vk::beginGpuProfilerFrame(gpuProfiler, commandBuffer, frameIndex);
+        gs::vk::beginPipelineStatisticsFrame(pipelineStatistics, commandBuffer, frameIndex);
+        gs::vk::beginPresentLatencyFrame(presentLatency, commandBuffer, frameIndex);
+        gs::vk::beginGpuScope(gpuProfiler, commandBuffer, "Frame");
+        gs::vk::executeRenderGraph(renderGraph, commandBuffer, &gpuProfiler, &pipelineStatistics);
+        gs::vk::endGpuScope(gpuProfiler, commandBuffer);
+        gs::vk::endPresentLatencyFrame(presentLatency, commandBuffer, frameIndex, inputTime);
         vkEndCommandBuffer(commandBuffer);
 
-        VkPipelineStageFlags waitDstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        // The upload timeline wait is already satisfied when the mesh is drawn but provides the memory dependency on the transfer queue,
+        // for culling as well as drawing, and orders the acquires after their releases
+        VkSemaphore waitSemaphores[2] = { frame.acquireCompleteSemaphore, uploadManager.timeline };
+        VkPipelineStageFlags acquireWaitStage = gs::vk::getRenderGraphFirstUseStage(renderGraph, backbuffer);
+        VkPipelineStageFlags waitDstStageMasks[2] = { acquireWaitStage, uploadConsumerStages };
+        uint64_t waitValues[2] = { 0, std::max(meshReady ? mesh.uploadTimelineValue : 0, acquiredUploadValue) };
+
+        VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{ VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+        timelineSubmitInfo.waitSemaphoreValueCount = GS_ARRAY_COUNT(waitValues);
+        timelineSubmitInfo.pWaitSemaphoreValues = waitValues;
+
         VkSubmitInfo submitInfo{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = &acquireCompleteSemaphore;
-        submitInfo.pWaitDstStageMask = &waitDstStageMask;
+        submitInfo.pNext = &timelineSubmitInfo;
+        submitInfo.waitSemaphoreCount = GS_ARRAY_COUNT(waitSemaphores);
+        submitInfo.pWaitSemaphores = waitSemaphores;
+        submitInfo.pWaitDstStageMask = waitDstStageMasks;
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &commandBuffer;
         submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = &renderingCompleteSemaphore;
-        VK_CHECK_RESULT(vkQueueSubmit(graphicsQueue, 1, &submitInfo, fences[imageIndex]));
+        submitInfo.pSignalSemaphores = &swapchain.presentSemaphores[imageIndex];
+        VK_CHECK_RESULT(vkQueueSubmit(graphicsQueue, 1, &submitInfo, frame.fence));
+
+        uint64_t presentId = gs::vk::nextPresentLatencyId(presentLatency);
+        VkPresentIdKHR presentIdInfo{ VK_STRUCTURE_TYPE_PRESENT_ID_KHR };
+        presentIdInfo.swapchainCount = 1;
+        presentIdInfo.pPresentIds = &presentId;
 
         VkPresentInfoKHR presentInfo{ VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
+        presentInfo.pNext = presentId ? &presentIdInfo : nullptr;
         presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores = &renderingCompleteSemaphore;
+        presentInfo.pWaitSemaphores = &swapchain.presentSemaphores[imageIndex];
         presentInfo.swapchainCount = 1;
         presentInfo.pSwapchains = &swapchain.swapchain;
         presentInfo.pImageIndices = &imageIndex;
-        VK_CHECK_RESULT(vkQueuePresentKHR(graphicsQueue, &presentInfo));
+        VkResult presentResult = vkQueuePresentKHR(graphicsQueue, &presentInfo);
+
+        if (presentResult == VK_SUCCESS || presentResult == VK_SUBOPTIMAL_KHR)
+        {
+            gs::vk::trackPresentLatency(presentLatency, swapchain.swapchain, presentId, inputTime);
+
+            if (!swapchain.retired.empty())
+            {
+                gs::vk::forgetPresentLatencySwapchains(presentLatency, swapchain.swapchain);
+                gs::vk::releaseRetiredSwapchains(swapchain, deletionQueue);
+            }
+        }
+
+        if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR)
+        {
+            swapchainOutOfDate = true;
+        }
+        else
+        {
+            VK_CHECK_RESULT(presentResult);
+        }
+
+        frameIndex = (frameIndex + 1) % framesInFlight;
+        ++frameNumber;
+    }
+
+    // The loader may be blocked on staging space that only this thread's flushes can free
+    while (pendingMesh.valid() && pendingMesh.wait_for(std::chrono::milliseconds(1)) != std::future_status::ready)
+    {
+        gs::vk::flushUploads(uploadManager);
     }
 
+    if (pendingMesh.valid())
+    {
+        pendingMesh.get();
+    }
+
+    gs::vk::flushUploads(uploadManager);
     VK_CHECK_RESULT(vkDeviceWaitIdle(device));
 
     destroyImgui(device, imguiData);
 
-    destroyMesh(device, mesh);
+    gs::vk::destroyGpuCulling(gpuCulling);
+    gs::vk::destroyGpuScene(gpuScene);
+    gs::vk::destroyUploadManager(uploadManager);
+
+    gs::vk::destroyFrameAllocator(uniformAllocator);
 
-    destroyBuffer(device, globalsBuffer);
-    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    gs::vk::destroyRenderGraph(renderGraph);
+    gs::vk::destroyPipelineStatisticsQueries(pipelineStatistics);
+    gs::vk::destroyGpuProfiler(gpuProfiler);
+    gs::vk::destroyPresentLatency(presentLatency);
+    gs::vk::destroyFrames(device, frames);
 
-    destroyFramebuffer(device, framebuffer);
-    destroyFrameResources(device, commandPool, commandBuffers, fences);
+    gs::vk::destroyDeletionQueue(deletionQueue);
     destroySwapchain(device, swapchain);
-    vkDestroyPipeline(device, pipeline, nullptr);
-    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+    gs::vk::savePipelineVariantManifest(pipelineVariants, kPipelineManifestPath);
+    gs::vk::destroyPipelineVariantCache(pipelineVariants);
+    gs::vk::savePipelineCache(device, pipelineCache, kPipelineCachePath);
+    vkDestroyPipelineCache(device, pipelineCache, nullptr);
+    gs::vk::destroyPipelineLayoutCache(pipelineLayoutCache);
+    gs::vk::destroyBindlessHeap(bindlessHeap);
     vkDestroyShaderModule(device, fragmentShader.shader, nullptr);
     vkDestroyShaderModule(device, vertexShader.shader, nullptr);
-    vkDestroyCommandPool(device, commandPool, nullptr);
-    vkDestroyRenderPass(device, renderPass, nullptr);
-    vkDestroySemaphore(device, renderingCompleteSemaphore, nullptr);
-    vkDestroySemaphore(device, acquireCompleteSemaphore, nullptr);
     vkDestroyDevice(device, nullptr);
     vkDestroySurfaceKHR(instance, surface, nullptr);
 